@@ -0,0 +1,323 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <stdint.h>
+#include <algorithm>
+#include <chrono>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "EventScheduler.hpp"
+#include "SunriseCalculator.hpp"
+
+// NOTES
+//
+// Benchmarks of the hot paths of the scheduler and the sunrise calculator. Every benchmark is run a number of times
+// (repetitions), and the median, minimum and maximum time per operation of those runs is reported, so that a single
+// slow run (another process, a page fault) does not move the result. The results are written as JSON, to stdout or
+// to the file given with --output, and as a table to stderr.
+//
+//     event_scheduler_bench [--output results.json] [--repetitions 15]
+//
+// Build with -DCMAKE_BUILD_TYPE=Release to get meaningful numbers. The schedulers use a simulated clock, so the
+// results do not depend on the time of day the benchmark is run.
+
+typedef CEventSchedulerT<64, CEventSchedulerGrowableStorage> CBenchScheduler;
+
+struct CBenchResult {
+    std::string name;
+    std::string parameters;         // JSON object
+    int         operationsPerRun;
+    double      medianNanosecondsPerOperation;
+    double      minimumNanosecondsPerOperation;
+    double      maximumNanosecondsPerOperation;
+};
+
+static const double latitude = 52.303713;       // Netherlands
+static const double longitude = 5.259310;
+static const time_t secondsFromGMT = 3600;
+static const time_t startOfYearGMT = 1767222000;  // 2026-01-01 00:00 local time
+
+static time_t simulatedTime = startOfYearGMT;
+static int numberOfRepetitions = 15;
+static std::vector<CBenchResult> results;
+
+// Keeps the compiler from optimizing away the work of a benchmark.
+static volatile uint64_t resultSink;
+
+static uint64_t nanosecondsSince(std::chrono::steady_clock::time_point start) {
+    return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+}
+
+static CEventSchedulerItem randomItem(std::mt19937 &generator) {
+    CEventSchedulerItem item;
+    item.weekDay = static_cast<CEventSchedulerWeekDay>(generator() % 7 + 1);
+    item.eventType = static_cast<CEventSchedulerItemType>(generator() % 3 + CEventSchedulerItemType_Time);
+    item.timeOffset = (item.eventType == CEventSchedulerItemType_Time) ? generator() % 1440 : 0;
+    item.randomOffsetMinus = generator() % 61;
+    item.randomOffsetPlus = generator() % 61;
+    item.userDefined = generator() % 16;
+    return item;
+}
+
+static void fillScheduler(CEventSchedulerBase &scheduler, int numberOfItems, std::mt19937 &generator) {
+    scheduler.beginUpdate();
+    for (int index = 0; index < numberOfItems; index++) {
+        scheduler.addItem(randomItem(generator));
+    }
+    scheduler.commitUpdate();
+}
+
+// Run the benchmark numberOfRepetitions times, after one run to warm up the caches. The function does
+// operationsPerRun operations, and returns how many nanoseconds they took, so that it can leave out its own setup.
+template <typename Function>
+static void runBenchmark(const char *name, const std::string &parameters, int operationsPerRun, Function function) {
+    std::vector<double> nanosecondsPerOperation;
+
+    function();
+    for (int repetition = 0; repetition < numberOfRepetitions; repetition++) {
+        nanosecondsPerOperation.push_back((double)function() / operationsPerRun);
+    }
+    std::sort(nanosecondsPerOperation.begin(), nanosecondsPerOperation.end());
+
+    CBenchResult result;
+    result.name = name;
+    result.parameters = parameters;
+    result.operationsPerRun = operationsPerRun;
+    result.medianNanosecondsPerOperation = nanosecondsPerOperation[nanosecondsPerOperation.size() / 2];
+    result.minimumNanosecondsPerOperation = nanosecondsPerOperation.front();
+    result.maximumNanosecondsPerOperation = nanosecondsPerOperation.back();
+    results.push_back(result);
+
+    fprintf(stderr, "%-32s %-40s %12.1f ns/op  (min %.1f, max %.1f)\n", name, parameters.c_str(),
+            result.medianNanosecondsPerOperation, result.minimumNanosecondsPerOperation, result.maximumNanosecondsPerOperation);
+}
+
+// Adding and removing items, with the scheduler already holding fillLevel items. Each run adds a batch of items and
+// then removes them again, so the fill level stays the same.
+static void benchmarkAddAndRemove(void) {
+    const int batchSize = 64;
+
+    for (int fillLevel : {0, 64, 512, 4096}) {
+        std::mt19937 generator(1);
+        CBenchScheduler scheduler(latitude, longitude, secondsFromGMT, [](){ return simulatedTime; });
+        fillScheduler(scheduler, fillLevel, generator);
+
+        CEventSchedulerItem batch[batchSize];
+        CEventSchedulerItemHandle handles[batchSize];
+        for (CEventSchedulerItem &item : batch) {
+            item = randomItem(generator);
+        }
+
+        std::string parameters = "{\"fillLevel\":" + std::to_string(fillLevel) + "}";
+
+        runBenchmark("addItem", parameters, batchSize, [&]() {
+            auto start = std::chrono::steady_clock::now();
+            for (int index = 0; index < batchSize; index++) {
+                handles[index] = scheduler.addItem(batch[index]);
+            }
+            uint64_t elapsed = nanosecondsSince(start);
+
+            for (int index = 0; index < batchSize; index++) {
+                scheduler.removeItem(handles[index]);
+            }
+            return elapsed;
+        });
+
+        runBenchmark("removeItem", parameters, batchSize, [&]() {
+            for (int index = 0; index < batchSize; index++) {
+                handles[index] = scheduler.addItem(batch[index]);
+            }
+
+            auto start = std::chrono::steady_clock::now();
+            for (int index = 0; index < batchSize; index++) {
+                scheduler.removeItem(handles[index]);
+            }
+            return nanosecondsSince(start);
+        });
+    }
+}
+
+// Lookups while the simulated clock runs through a year, in steps of 10 minutes, like a device that polls.
+static void benchmarkLookupsOverYear(void) {
+    const int stepSeconds = 600;
+    const int numberOfSteps = 365 * 24 * 6;
+
+    for (int numberOfItems : {14, 70, 1000}) {
+        std::mt19937 generator(2);
+        CBenchScheduler scheduler(latitude, longitude, secondsFromGMT, [](){ return simulatedTime; });
+        fillScheduler(scheduler, numberOfItems, generator);
+
+        std::string parameters = "{\"items\":" + std::to_string(numberOfItems) + ",\"stepSeconds\":" + std::to_string(stepSeconds) + ",\"days\":365}";
+
+        runBenchmark("getActiveItem", parameters, numberOfSteps, [&]() {
+            uint64_t checksum = 0;
+            auto start = std::chrono::steady_clock::now();
+            for (int step = 0; step < numberOfSteps; step++) {
+                simulatedTime = startOfYearGMT + (time_t)step * stepSeconds;
+                checksum += scheduler.getActiveItem().activeTimeOffset;
+            }
+            uint64_t elapsed = nanosecondsSince(start);
+            resultSink = checksum;
+            return elapsed;
+        });
+
+        runBenchmark("getNextActiveItem", parameters, numberOfSteps, [&]() {
+            uint64_t checksum = 0;
+            auto start = std::chrono::steady_clock::now();
+            for (int step = 0; step < numberOfSteps; step++) {
+                simulatedTime = startOfYearGMT + (time_t)step * stepSeconds;
+                checksum += scheduler.getNextActiveItem().activeTimeOffset;
+            }
+            uint64_t elapsed = nanosecondsSince(start);
+            resultSink = checksum;
+            return elapsed;
+        });
+    }
+
+    simulatedTime = startOfYearGMT;
+}
+
+// recalculateAllActivationTimes() is private, setSecondsFromGMT() runs it for all items. The time moves a week further
+// on every run, so the sunrise, sunset and random offsets are calculated again.
+static void benchmarkRecalculation(void) {
+    const int recalculationsPerRun = 16;
+
+    for (int numberOfItems : {14, 70, 1000}) {
+        std::mt19937 generator(3);
+        CBenchScheduler scheduler(latitude, longitude, secondsFromGMT, [](){ return simulatedTime; });
+        fillScheduler(scheduler, numberOfItems, generator);
+
+        std::string parameters = "{\"items\":" + std::to_string(numberOfItems) + "}";
+
+        runBenchmark("recalculateAllActivationTimes", parameters, recalculationsPerRun, [&]() {
+            auto start = std::chrono::steady_clock::now();
+            for (int recalculation = 0; recalculation < recalculationsPerRun; recalculation++) {
+                simulatedTime += 7 * 24 * 3600;
+                scheduler.setSecondsFromGMT(secondsFromGMT);
+            }
+            return nanosecondsSince(start);
+        });
+    }
+
+    simulatedTime = startOfYearGMT;
+}
+
+// One sunrise/sunset calculation per day of the year, in both modes, and in a batch.
+static void benchmarkSunriseCalculator(void) {
+    const int numberOfDays = 365;
+
+    std::vector<time_t> days(numberOfDays);
+    std::vector<time_t> sunRises(numberOfDays);
+    std::vector<time_t> sunSets(numberOfDays);
+    for (int day = 0; day < numberOfDays; day++) {
+        days[day] = startOfYearGMT + (time_t)day * 24 * 3600;
+    }
+
+    for (CSunriseCalculatorMode mode : {CSunriseCalculatorMode_Exact, CSunriseCalculatorMode_Fast}) {
+        CSunriseCalculator calculator(latitude, longitude, mode);
+        std::string parameters = std::string("{\"mode\":\"") + ((mode == CSunriseCalculatorMode_Exact) ? "exact" : "fast") + "\"}";
+
+        runBenchmark("sunRiseAndSetForTimestamp", parameters, numberOfDays, [&]() {
+            uint64_t checksum = 0;
+            auto start = std::chrono::steady_clock::now();
+            for (int day = 0; day < numberOfDays; day++) {
+                time_t sunRise, sunSet;
+                calculator.sunRiseAndSetForTimestamp(days[day], 0, sunRise, sunSet);
+                checksum += sunRise + sunSet;
+            }
+            uint64_t elapsed = nanosecondsSince(start);
+            resultSink = checksum;
+            return elapsed;
+        });
+
+        runBenchmark("sunRiseAndSetForDays", parameters, numberOfDays, [&]() {
+            auto start = std::chrono::steady_clock::now();
+            calculator.sunRiseAndSetForDays(days.data(), numberOfDays, sunRises.data(), sunSets.data());
+            uint64_t elapsed = nanosecondsSince(start);
+            resultSink = sunRises[numberOfDays - 1];
+            return elapsed;
+        });
+    }
+}
+
+static std::string resultsAsJSON(void) {
+    char text[512];
+    time_t now = time(nullptr);
+    char date[32];
+    strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%SZ", gmtime(&now));
+
+#ifdef NDEBUG
+    const char *buildType = "release";
+#else
+    const char *buildType = "debug";
+#endif
+#ifdef EVENT_SCHEDULER_METRICS
+    const char *metrics = "true";
+#else
+    const char *metrics = "false";
+#endif
+#ifdef __VERSION__
+    const char *compiler = __VERSION__;
+#else
+    const char *compiler = "unknown";
+#endif
+
+    snprintf(text, sizeof(text), "{\n  \"benchmark\": \"event_scheduler_bench\",\n  \"date\": \"%s\",\n  \"compiler\": \"%s\",\n"
+             "  \"build\": \"%s\",\n  \"metrics\": %s,\n  \"hardwareThreads\": %u,\n  \"repetitions\": %d,\n  \"results\": [\n",
+             date, compiler, buildType, metrics, std::thread::hardware_concurrency(), numberOfRepetitions);
+    std::string json = text;
+
+    for (size_t index = 0; index < results.size(); index++) {
+        const CBenchResult &result = results[index];
+        snprintf(text, sizeof(text), "    {\"name\": \"%s\", \"parameters\": %s, \"operationsPerRun\": %d, "
+                 "\"nsPerOperation\": %.2f, \"minNsPerOperation\": %.2f, \"maxNsPerOperation\": %.2f}%s\n",
+                 result.name.c_str(), result.parameters.c_str(), result.operationsPerRun,
+                 result.medianNanosecondsPerOperation, result.minimumNanosecondsPerOperation, result.maximumNanosecondsPerOperation,
+                 (index + 1 < results.size()) ? "," : "");
+        json += text;
+    }
+
+    json += "  ]\n}\n";
+    return json;
+}
+
+int main(int argc, char *argv[]) {
+    const char *outputPath = nullptr;
+
+    for (int argument = 1; argument < argc; argument++) {
+        if (strcmp(argv[argument], "--output") == 0 && argument + 1 < argc) {
+            outputPath = argv[++argument];
+        } else if (strcmp(argv[argument], "--repetitions") == 0 && argument + 1 < argc) {
+            numberOfRepetitions = std::max(1, atoi(argv[++argument]));
+        } else {
+            fprintf(stderr, "Usage: %s [--output results.json] [--repetitions N]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    benchmarkAddAndRemove();
+    benchmarkLookupsOverYear();
+    benchmarkRecalculation();
+    benchmarkSunriseCalculator();
+
+    std::string json = resultsAsJSON();
+
+    if (outputPath == nullptr) {
+        fputs(json.c_str(), stdout);
+        return 0;
+    }
+
+    FILE *file = fopen(outputPath, "w");
+    if (file == nullptr) {
+        fprintf(stderr, "Can not write %s\n", outputPath);
+        return 1;
+    }
+    fputs(json.c_str(), file);
+    fclose(file);
+
+    return 0;
+}
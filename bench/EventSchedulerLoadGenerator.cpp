@@ -0,0 +1,438 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <stdint.h>
+#include <math.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <new>
+#include <random>
+#include <string>
+#include <vector>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/resource.h>
+#endif
+
+#include "EventScheduler.hpp"
+#include "EventSchedulerCoordinator.hpp"
+#include "EventSchedulerMetrics.hpp"
+#include "SolarTableCache.hpp"
+
+// NOTES
+//
+// Load generator and soak harness. It creates a fleet of schedulers with randomized, but realistic schedules (lights
+// on at sunset and off late in the evening, some also in the morning, on all days or only on work days, with random
+// offsets), puts them all in a CEventSchedulerCoordinator, and drives them through years of virtual time. The clock
+// is simulated through the timeProvider of the schedulers, and jumps from one activation to the next, so a year
+// takes as long as the work that is done in it, not a year.
+//
+// While the time runs, the schedules are edited (churn): items are added, removed and replaced, and the random
+// offsets are recalculated, as the users of a fleet of devices would. Between the activations, random schedulers
+// are asked for their active item.
+//
+// It reports the throughput (activations per second of wall clock time), the latencies of processDue() and of every
+// kind of edit and lookup (as percentiles, from a log-linear histogram), the peak RSS, and the number of allocations
+// and bytes of operator new and of the item storage of the schedulers. The report is JSON, on stdout or in the file
+// given with --output.
+//
+//     event_scheduler_loadgen [--schedulers 1000000] [--days 1095] [--churn 0.01] [--lookups 10000]
+//                             [--solar-cache 0] [--seed 1] [--output report.json]
+//
+// Every scheduler takes about 1.2 kB (the scheduler object, and the storage of its items, which starts out with room
+// for 8), so 1M schedulers need about 1.2 GB. The report has the figures of the run, see residentBytesPerScheduler.
+
+// Counts the allocations of the whole program, through operator new, and of the item storage of the schedulers,
+// through the allocation functions of their storage.
+static std::atomic<uint64_t> numberOfNewCalls(0);
+static std::atomic<uint64_t> numberOfNewBytes(0);
+static std::atomic<uint64_t> numberOfStorageAllocations(0);
+static std::atomic<uint64_t> numberOfStorageBytes(0);
+
+// All forms of operator new and delete are replaced together, and kept out of line. GCC would otherwise inline free()
+// into the delete expressions, and warn that it frees memory that came from a new expression.
+#if defined(__GNUC__)
+#define LOADGEN_NOINLINE __attribute__((noinline))
+#else
+#define LOADGEN_NOINLINE
+#endif
+
+LOADGEN_NOINLINE void *operator new(size_t size) {
+    numberOfNewCalls.fetch_add(1, std::memory_order_relaxed);
+    numberOfNewBytes.fetch_add(size, std::memory_order_relaxed);
+    void *memory = malloc(size > 0 ? size : 1);
+    if (memory == nullptr) {
+        throw std::bad_alloc();
+    }
+    return memory;
+}
+
+LOADGEN_NOINLINE void *operator new[](size_t size) {
+    return ::operator new(size);
+}
+
+LOADGEN_NOINLINE void operator delete(void *memory) noexcept {
+    free(memory);
+}
+
+LOADGEN_NOINLINE void operator delete[](void *memory) noexcept {
+    ::operator delete(memory);
+}
+
+LOADGEN_NOINLINE void operator delete(void *memory, size_t /* size */) noexcept {
+    ::operator delete(memory);
+}
+
+LOADGEN_NOINLINE void operator delete[](void *memory, size_t /* size */) noexcept {
+    ::operator delete(memory);
+}
+
+static void *countingAllocate(size_t size) {
+    numberOfStorageAllocations.fetch_add(1, std::memory_order_relaxed);
+    numberOfStorageBytes.fetch_add(size, std::memory_order_relaxed);
+    return malloc(size);
+}
+
+// Growable storage with the counting allocation functions. Schedulers start with room for 8 items, and grow.
+class CCountingStorage : public CEventSchedulerGrowableStorage {
+public:
+    explicit CCountingStorage(int initialCapacity) :
+    CEventSchedulerGrowableStorage(initialCapacity, countingAllocate, free) {
+    }
+};
+
+typedef CEventSchedulerT<8, CCountingStorage> CLoadScheduler;
+
+// A histogram of latencies, with the buckets of CEventSchedulerLatencySnapshot. Single threaded.
+struct CLoadLatency {
+    const char                      *name;
+    CEventSchedulerLatencySnapshot  snapshot;
+
+    explicit CLoadLatency(const char *name) : name(name) {
+        memset(&snapshot, 0, sizeof(snapshot));
+    }
+
+    void record(uint64_t nanoseconds) {
+        snapshot.count++;
+        snapshot.sumNanoseconds += nanoseconds;
+        snapshot.maximumNanoseconds = std::max(snapshot.maximumNanoseconds, nanoseconds);
+        snapshot.buckets[CEventSchedulerLatencySnapshot::bucketForValue(nanoseconds)]++;
+    }
+};
+
+struct CLoadConfiguration {
+    int         numberOfSchedulers = 100000;
+    int         numberOfDays = 3 * 365;
+    double      churnPerDay = 0.01;         // Fraction of the schedulers that is edited every virtual day
+    int         lookupsPerDay = 10000;
+    int         solarCacheEntries = 0;      // 0 is no shared solar table cache
+    uint32_t    seed = 1;
+    const char  *outputPath = nullptr;
+};
+
+static const time_t startTimeGMT = 1767222000;     // 2026-01-01 00:00 CET
+static const time_t secondsInDay = 24 * 3600;
+
+static time_t simulatedTime = startTimeGMT;
+static uint64_t numberOfActivations = 0;
+
+static uint64_t nanosecondsSince(std::chrono::steady_clock::time_point start) {
+    return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+}
+
+static double secondsSince(std::chrono::steady_clock::time_point start) {
+    return (double)nanosecondsSince(start) / 1e9;
+}
+
+static long peakResidentKilobytes(void) {
+#if defined(__unix__) || defined(__APPLE__)
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+#if defined(__APPLE__)
+    return usage.ru_maxrss / 1024;     // Bytes on macOS
+#else
+    return usage.ru_maxrss;
+#endif
+#else
+    return -1;
+#endif
+}
+
+static CEventSchedulerItem makeItem(CEventSchedulerWeekDay weekDay, CEventSchedulerItemType eventType, int timeOffset, int randomOffset, int userDefined) {
+    CEventSchedulerItem item;
+    item.weekDay = weekDay;
+    item.eventType = eventType;
+    item.timeOffset = timeOffset;
+    item.randomOffsetMinus = randomOffset;
+    item.randomOffsetPlus = randomOffset;
+    item.userDefined = userDefined;
+    return item;
+}
+
+// A schedule like the ones in Dusklight: on at sunset, off between 22:00 and midnight, on every day or on work days,
+// and for some also on early in the morning and off at sunrise. Returns the number of items.
+static int makeSchedule(std::mt19937 &generator, CEventSchedulerItem *items) {
+    int numberOfItems = 0;
+    int dayPattern = generator() % 10;                  // 7 every day, 2 work days, 1 random days
+    bool hasMorning = (generator() % 10) < 3;
+    int eveningOffset = 10 + generator() % 21;
+    int offTime = 22 * 60 + generator() % 120;
+    int morningTime = 6 * 60 + generator() % 90;
+
+    for (int day = CEventSchedulerDayNumber_Sunday; day <= CEventSchedulerDayNumber_Saturday; day++) {
+        bool isActive = (dayPattern < 7) ||
+                        (dayPattern < 9 && day != CEventSchedulerDayNumber_Sunday && day != CEventSchedulerDayNumber_Saturday) ||
+                        (dayPattern == 9 && (generator() % 2) == 0);
+        if (!isActive) {
+            continue;
+        }
+
+        CEventSchedulerWeekDay weekDay = static_cast<CEventSchedulerWeekDay>(day);
+        items[numberOfItems++] = makeItem(weekDay, CEventSchedulerItemType_Sunset, 0, eveningOffset, 1);
+        items[numberOfItems++] = makeItem(weekDay, CEventSchedulerItemType_Time, offTime, 30, 0);
+        if (hasMorning) {
+            items[numberOfItems++] = makeItem(weekDay, CEventSchedulerItemType_Time, morningTime, 15, 1);
+            items[numberOfItems++] = makeItem(weekDay, CEventSchedulerItemType_Sunrise, 0, 15, 0);
+        }
+    }
+
+    return numberOfItems;
+}
+
+static CEventSchedulerItem randomItem(std::mt19937 &generator) {
+    CEventSchedulerItemType eventType = static_cast<CEventSchedulerItemType>(CEventSchedulerItemType_Time + generator() % 3);
+    return makeItem(static_cast<CEventSchedulerWeekDay>(generator() % 7 + 1), eventType,
+                    (eventType == CEventSchedulerItemType_Time) ? generator() % 1440 : 0, generator() % 31, generator() % 2);
+}
+
+static void transition(CEventSchedulerBase & /* scheduler */, const CEventSchedulerItem & /* activeItem */, const CEventSchedulerItem & /* nextActiveItem */, time_t /* timestampGMT */, void * /* context */) {
+    numberOfActivations++;
+}
+
+static std::string latencyAsJSON(const CLoadLatency &latency) {
+    char text[512];
+    const CEventSchedulerLatencySnapshot &snapshot = latency.snapshot;
+    snprintf(text, sizeof(text), "\"%s\": {\"count\": %llu, \"meanNs\": %.1f, \"p50Ns\": %llu, \"p99Ns\": %llu, \"p999Ns\": %llu, \"maxNs\": %llu}",
+             latency.name, (unsigned long long)snapshot.count, (snapshot.count > 0) ? (double)snapshot.sumNanoseconds / snapshot.count : 0.0,
+             (unsigned long long)snapshot.percentile(0.5), (unsigned long long)snapshot.percentile(0.99),
+             (unsigned long long)snapshot.percentile(0.999), (unsigned long long)snapshot.maximumNanoseconds);
+    return text;
+}
+
+static bool parseArguments(int argc, char *argv[], CLoadConfiguration &configuration) {
+    for (int argument = 1; argument < argc; argument++) {
+        const char *value = (argument + 1 < argc) ? argv[argument + 1] : nullptr;
+        if (value == nullptr) {
+            return false;
+        }
+
+        if (strcmp(argv[argument], "--schedulers") == 0) {
+            configuration.numberOfSchedulers = std::max(1, atoi(value));
+        } else if (strcmp(argv[argument], "--days") == 0) {
+            configuration.numberOfDays = std::max(1, atoi(value));
+        } else if (strcmp(argv[argument], "--churn") == 0) {
+            configuration.churnPerDay = std::max(0.0, atof(value));
+        } else if (strcmp(argv[argument], "--lookups") == 0) {
+            configuration.lookupsPerDay = std::max(0, atoi(value));
+        } else if (strcmp(argv[argument], "--solar-cache") == 0) {
+            configuration.solarCacheEntries = std::max(0, atoi(value));
+        } else if (strcmp(argv[argument], "--seed") == 0) {
+            configuration.seed = (uint32_t)strtoul(value, nullptr, 10);
+        } else if (strcmp(argv[argument], "--output") == 0) {
+            configuration.outputPath = value;
+        } else {
+            return false;
+        }
+        argument++;
+    }
+    return true;
+}
+
+int main(int argc, char *argv[]) {
+    CLoadConfiguration configuration;
+    if (!parseArguments(argc, argv, configuration)) {
+        fprintf(stderr, "Usage: %s [--schedulers N] [--days N] [--churn fraction] [--lookups N] [--solar-cache entries] [--seed N] [--output report.json]\n", argv[0]);
+        return 1;
+    }
+
+    std::mt19937 generator(configuration.seed);
+    std::uniform_real_distribution<double> latitudes(36.0, 60.0);     // Europe
+    std::uniform_real_distribution<double> longitudes(-10.0, 30.0);
+
+    CLoadLatency processDueLatency("processDue");
+    CLoadLatency addItemLatency("addItem");
+    CLoadLatency removeItemLatency("removeItem");
+    CLoadLatency replaceAllItemsLatency("replaceAllItems");
+    CLoadLatency recalculationLatency("recalculateAllActivationTimes");
+    CLoadLatency lookupLatency("getActiveItem");
+
+    CSolarTableCache *solarTableCache = (configuration.solarCacheEntries > 0) ? new CSolarTableCache(configuration.solarCacheEntries) : nullptr;
+    CEventSchedulerCoordinator *coordinator = new CEventSchedulerCoordinator(transition);
+    std::vector<CLoadScheduler *> schedulers;
+    schedulers.reserve(configuration.numberOfSchedulers);
+
+    // Build the fleet
+    long residentKilobytesBefore = peakResidentKilobytes();
+    uint64_t numberOfItems = 0;
+    CEventSchedulerItem items[28];
+
+    auto buildStart = std::chrono::steady_clock::now();
+    for (int index = 0; index < configuration.numberOfSchedulers; index++) {
+        CLoadScheduler *scheduler = new CLoadScheduler(latitudes(generator), longitudes(generator), 3600, [](){ return simulatedTime; });
+        if (solarTableCache != nullptr) {
+            scheduler->setSolarTableCache(solarTableCache);
+        }
+        int numberOfScheduleItems = makeSchedule(generator, items);
+        scheduler->replaceAllItems(items, numberOfScheduleItems);
+        numberOfItems += numberOfScheduleItems;
+
+        coordinator->addScheduler(*scheduler);
+        schedulers.push_back(scheduler);
+    }
+    coordinator->processDue(simulatedTime);
+    double buildSeconds = secondsSince(buildStart);
+    long residentKilobytesAfterBuild = peakResidentKilobytes();
+    uint64_t initialActivations = numberOfActivations;
+
+    fprintf(stderr, "Built %d schedulers with %llu items in %.2f s\n", configuration.numberOfSchedulers, (unsigned long long)numberOfItems, buildSeconds);
+
+    // Run through the virtual time. The clock jumps to the first of: the next activation, the next edit, the next
+    // lookup. Edits and lookups are spread evenly over the day.
+    const time_t endTimeGMT = startTimeGMT + (time_t)configuration.numberOfDays * secondsInDay;
+    const double editInterval = (configuration.churnPerDay > 0.0) ? secondsInDay / (configuration.churnPerDay * configuration.numberOfSchedulers) : 0.0;
+    const double lookupInterval = (configuration.lookupsPerDay > 0) ? (double)secondsInDay / configuration.lookupsPerDay : 0.0;
+    double nextEditTime = (editInterval > 0.0) ? startTimeGMT + editInterval : endTimeGMT;
+    double nextLookupTime = (lookupInterval > 0.0) ? startTimeGMT + lookupInterval : endTimeGMT;
+    uint64_t numberOfRounds = 0;
+    uint64_t numberOfEdits = 0;
+    uint64_t lookupChecksum = 0;
+    int reportedYear = 0;
+
+    uint64_t newCallsBeforeRun = numberOfNewCalls;
+    uint64_t storageAllocationsBeforeRun = numberOfStorageAllocations;
+
+    auto runStart = std::chrono::steady_clock::now();
+    while (simulatedTime < endTimeGMT) {
+        time_t nextActivationTime = coordinator->getNextActivationTime();
+        time_t nextTime = endTimeGMT;
+        if (nextActivationTime >= 0 && nextActivationTime < nextTime) {
+            nextTime = nextActivationTime;
+        }
+        nextTime = std::min(nextTime, (time_t)ceil(std::min(nextEditTime, nextLookupTime)));
+        simulatedTime = std::max(nextTime, simulatedTime);
+
+        auto start = std::chrono::steady_clock::now();
+        coordinator->processDue(simulatedTime);
+        processDueLatency.record(nanosecondsSince(start));
+        numberOfRounds++;
+
+        while (nextEditTime <= simulatedTime) {
+            CLoadScheduler *scheduler = schedulers[generator() % schedulers.size()];
+            int numberOfSchedulerItems = scheduler->getNumberOfItems();
+
+            switch (generator() % 4) {
+                case 0:
+                    if (numberOfSchedulerItems < 60) {
+                        CEventSchedulerItem item = randomItem(generator);
+                        start = std::chrono::steady_clock::now();
+                        scheduler->addItem(item);
+                        addItemLatency.record(nanosecondsSince(start));
+                        break;
+                    }
+                    // Full enough, remove one instead
+                    [[fallthrough]];
+                case 1:
+                    if (numberOfSchedulerItems > 0) {
+                        CEventSchedulerItem item = scheduler->getItem(generator() % numberOfSchedulerItems);
+                        start = std::chrono::steady_clock::now();
+                        scheduler->removeItem(item);
+                        removeItemLatency.record(nanosecondsSince(start));
+                    }
+                    break;
+                case 2: {
+                    int numberOfScheduleItems = makeSchedule(generator, items);
+                    start = std::chrono::steady_clock::now();
+                    scheduler->replaceAllItems(items, numberOfScheduleItems);
+                    replaceAllItemsLatency.record(nanosecondsSince(start));
+                    break;
+                }
+                default:
+                    // The activation times are calculated for the current week, e.g. by a device every week.
+                    start = std::chrono::steady_clock::now();
+                    scheduler->setSecondsFromGMT(3600);
+                    recalculationLatency.record(nanosecondsSince(start));
+                    break;
+            }
+
+            numberOfEdits++;
+            nextEditTime += editInterval;
+        }
+
+        while (nextLookupTime <= simulatedTime) {
+            CLoadScheduler *scheduler = schedulers[generator() % schedulers.size()];
+            start = std::chrono::steady_clock::now();
+            lookupChecksum += scheduler->getActiveItem(simulatedTime).userDefined;
+            lookupLatency.record(nanosecondsSince(start));
+            nextLookupTime += lookupInterval;
+        }
+
+        int year = (int)((simulatedTime - startTimeGMT) / (365 * secondsInDay));
+        if (year > reportedYear) {
+            reportedYear = year;
+            fprintf(stderr, "Year %d: %llu activations, %.2f s\n", year, (unsigned long long)(numberOfActivations - initialActivations), secondsSince(runStart));
+        }
+    }
+    double runSeconds = secondsSince(runStart);
+    uint64_t runActivations = numberOfActivations - initialActivations;
+
+    // Report
+    char text[1024];
+    snprintf(text, sizeof(text),
+             "{\n  \"loadGenerator\": \"event_scheduler_loadgen\",\n"
+             "  \"configuration\": {\"schedulers\": %d, \"days\": %d, \"churnPerDay\": %g, \"lookupsPerDay\": %d, \"solarCacheEntries\": %d, \"seed\": %u},\n"
+             "  \"build\": {\"seconds\": %.3f, \"items\": %llu, \"residentBytesPerScheduler\": %.0f, \"schedulerObjectBytes\": %zu},\n"
+             "  \"run\": {\"seconds\": %.3f, \"activations\": %llu, \"activationsPerSecond\": %.0f, \"rounds\": %llu, \"edits\": %llu, \"lookupChecksum\": %llu},\n",
+             configuration.numberOfSchedulers, configuration.numberOfDays, configuration.churnPerDay, configuration.lookupsPerDay,
+             configuration.solarCacheEntries, configuration.seed,
+             buildSeconds, (unsigned long long)numberOfItems,
+             (double)(residentKilobytesAfterBuild - residentKilobytesBefore) * 1024.0 / configuration.numberOfSchedulers, sizeof(CLoadScheduler),
+             runSeconds, (unsigned long long)runActivations, (runSeconds > 0.0) ? runActivations / runSeconds : 0.0,
+             (unsigned long long)numberOfRounds, (unsigned long long)numberOfEdits, (unsigned long long)lookupChecksum);
+    std::string report = text;
+
+    report += "  \"latencies\": {\n    " + latencyAsJSON(processDueLatency) + ",\n    " + latencyAsJSON(addItemLatency) + ",\n    " +
+              latencyAsJSON(removeItemLatency) + ",\n    " + latencyAsJSON(replaceAllItemsLatency) + ",\n    " +
+              latencyAsJSON(recalculationLatency) + ",\n    " + latencyAsJSON(lookupLatency) + "\n  },\n";
+
+    snprintf(text, sizeof(text),
+             "  \"memory\": {\"peakResidentBytes\": %lld, \"operatorNewCalls\": %llu, \"operatorNewBytes\": %llu, "
+             "\"storageAllocations\": %llu, \"storageBytes\": %llu, \"operatorNewCallsDuringRun\": %llu, \"storageAllocationsDuringRun\": %llu}\n}\n",
+             (long long)peakResidentKilobytes() * 1024,
+             (unsigned long long)numberOfNewCalls, (unsigned long long)numberOfNewBytes,
+             (unsigned long long)numberOfStorageAllocations, (unsigned long long)numberOfStorageBytes,
+             (unsigned long long)(numberOfNewCalls - newCallsBeforeRun), (unsigned long long)(numberOfStorageAllocations - storageAllocationsBeforeRun));
+    report += text;
+
+    if (configuration.outputPath != nullptr) {
+        FILE *file = fopen(configuration.outputPath, "w");
+        if (file == nullptr) {
+            fprintf(stderr, "Can not write %s\n", configuration.outputPath);
+            return 1;
+        }
+        fputs(report.c_str(), file);
+        fclose(file);
+    } else {
+        fputs(report.c_str(), stdout);
+    }
+
+    // The coordinator lets go of the schedulers before they are deleted.
+    delete coordinator;
+    for (CLoadScheduler *scheduler : schedulers) {
+        delete scheduler;
+    }
+    delete solarTableCache;
+
+    return 0;
+}
@@ -18,9 +18,10 @@ public:
         }
     }
 
+    // An empty item has type 0 (OneShot) too, use CEventSchedulerItem::eventTypeAsString() to tell them apart.
     static const char * const toString(CEventSchedulerItemType type) {
         switch (type) {
-            case CEventSchedulerItemType_Spare: return "Spare";
+            case CEventSchedulerItemType_OneShot: return "OneShot";
             case CEventSchedulerItemType_Time: return "Time";
             case CEventSchedulerItemType_Sunrise: return "Sunrise";
             case CEventSchedulerItemType_Sunset: return "Sunset";
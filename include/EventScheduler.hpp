@@ -3,10 +3,16 @@
 #include <stdio.h>
 #include <iostream>
 #include <iomanip>
-#include <random>
+#include <iterator>
 
 #include "EventSchedulerItem.hpp"
+#include "EventSchedulerMetrics.hpp"
+#include "EventSchedulerStorage.hpp"
 #include "SunriseCalculator.hpp"
+#include "SolarTableCache.hpp"
+#include "EventSchedulerTimingWheel.hpp"
+#include "EventSchedulerConcurrentReader.hpp"
+#include "EventSchedulerTimeZone.hpp"
 
 // NOTES
 //
@@ -31,43 +37,249 @@
 //
 // Same here, we pass the GMT timestamp of the day, and the returned timestamp will be in GMT too. Add the seconds from GMT to
 // get local time.
+//
+// A fixed secondsFromGMT does not follow daylight saving time. Set a CEventSchedulerTimeZone with setTimeZone() to have
+// the offset follow the rules of the zone instead: the items stay at the same local time, and nothing has to be
+// recalculated (or drawn again) when the clock moves. Only the conversions between GMT and local time change, see
+// EventSchedulerTimeZone.hpp for what happens to the hour that is skipped or repeated.
+//
+// Next to the weekly items, there are one-shot items, that activate once at an absolute time (e.g. "turn off in 45
+// minutes", or a vacation override). They are kept in a timing wheel, and leave the scheduler when they activate. An
+// activated one-shot item is the active item until the next weekly item activates. The timing wheel follows the clock
+// of the timeProvider, so asking for the active item at a time in the future does not take the one-shot items before
+// that time into account.
+//
+// The random offset of an item is calculated from the seed of the scheduler, the item and the week, and from nothing
+// else. The activation times of any week, past or future, can be calculated at any time (see activations()), in any
+// order, and come out the same every time. The slot of the item is part of the key, so items that are equal get offsets
+// of their own. A snapshot puts the items back into their slots, and a journal replays them into their slots.
+//
+// The compiled schedule holds the activation times of one week. The first lookup in another week (including the first
+// lookup after the week rolled over) compiles it for that week, and tells the listeners, so the lookups always agree
+// with activations(). Looking up times in different weeks one after the other compiles the schedule every time.
+
+// Handle to an item in the scheduler, as returned by addItem(). Negative values are invalid handles.
+typedef int32_t CEventSchedulerItemHandle;
+
+class CEventSchedulerBase;
+
+// Called after the items or their activation times have changed, e.g. to wake up a CEventSchedulerRunner.
+typedef void (*CEventSchedulerChangeListener)(CEventSchedulerBase &scheduler, void *context);
+
+// Sunrise and sunset times for one local day.
+struct CEventSchedulerSolarDay {
+    time_t  beginningOfDayGMT;
+    time_t  sunRise;
+    time_t  sunSet;
+    bool    isValid = false;
+};
+
+// One activation of an item, at an absolute time. The item has the activeWeekDay and activeTimeOffset (and for
+// sunrise/sunset items, the timeOffset) of this activation.
+struct CEventSchedulerActivation {
+    time_t                      timestampGMT;
+    CEventSchedulerItem         item;
+    CEventSchedulerItemHandle   handle;
+};
+
+// The activations in a time range, in order of time, as returned by CEventSchedulerBase::activations(). They are
+// calculated one at a time while iterating, so a range can be as long as needed. A range is only valid until the items
+// of the scheduler change.
+//
+//     for (const CEventSchedulerActivation &activation : scheduler.activations(fromGMT, toGMT)) { ... }
+class CEventSchedulerActivationRange {
+public:
+    class Iterator {
+    public:
+        typedef std::input_iterator_tag         iterator_category;
+        typedef CEventSchedulerActivation       value_type;
+        typedef ptrdiff_t                       difference_type;
+        typedef const CEventSchedulerActivation *pointer;
+        typedef const CEventSchedulerActivation &reference;
+
+        reference operator*() const { return activation; }
+        pointer operator->() const { return &activation; }
+
+        Iterator &operator++();
+        Iterator operator++(int) { Iterator previous = *this; ++(*this); return previous; }
+
+        // Only the end iterator compares different, an input range is only iterated once.
+        bool operator==(const Iterator &other) const { return scheduler == other.scheduler; }
+        bool operator!=(const Iterator &other) const { return scheduler != other.scheduler; }
+
+    private:
+        friend class CEventSchedulerActivationRange;
+
+        CEventSchedulerBase         *scheduler = nullptr;       // nullptr at the end
+        time_t                      toGMT = 0;
+        int                         slot = -1;
+        CEventSchedulerActivation   activation = {};
+    };
+
+    Iterator begin(void);
+    Iterator end(void) { return Iterator(); }
 
-class CEventScheduler {
 private:
-    typedef std::mt19937    RandomMT19937Generator;
+    friend class CEventSchedulerBase;
 
-    static const int        numberOfSchedulerItems = 70;        // We hold storage for on average 10 events per day, 70 events per week max.
+    CEventSchedulerActivationRange(CEventSchedulerBase *scheduler, time_t fromGMT, time_t toGMT) : scheduler(scheduler), fromGMT(fromGMT), toGMT(toGMT) {}
+
+    CEventSchedulerBase     *scheduler;
+    time_t                  fromGMT;
+    time_t                  toGMT;
+};
+
+// Counter-based random numbers, with the finalizer of SplitMix64 as the mixing function. A number is a pure function of
+// the seed, a key and a counter, so the seed is all the state there is, and the numbers can be calculated in any order
+// and again at any time. The scheduler uses the item as the key and the week as the counter.
+class CEventSchedulerRandomGenerator {
+public:
+    void seed(uint32_t newSeed) { seedValue = newSeed; }
+    uint32_t getSeed(void) const { return seedValue; }
+
+    uint64_t operator()(uint64_t key, int64_t counter) const {
+        return mix(mix(mix(seedValue) ^ key) ^ (uint64_t)counter);
+    }
+
+    // Uniform in minimum..maximum, both included.
+    int uniform(uint64_t key, int64_t counter, int minimum, int maximum) const {
+        uint64_t range = (uint64_t)(maximum - minimum) + 1;
+        return minimum + (int)((((*this)(key, counter) >> 32) * range) >> 32);
+    }
+
+    static uint64_t mix(uint64_t value) {
+        value += 0x9e3779b97f4a7c15ULL;
+        value = (value ^ (value >> 30)) * 0xbf58476d1ce4e5b9ULL;
+        value = (value ^ (value >> 27)) * 0x94d049bb133111ebULL;
+        return value ^ (value >> 31);
+    }
+
+private:
+    uint32_t                seedValue = 0;
+};
+
+// The scheduler itself. It works on storage that is provided by a derived class, use CEventSchedulerT (or
+// CEventScheduler) to get a scheduler with storage.
+class CEventSchedulerBase {
+private:
+    static const int        maximumSlotGeneration = 0x7fff;     // Keeps handles positive
 
     static const int        minutesInDay = 60 * 24;
     static const int        secondsInDay = 60 * minutesInDay;
     static const int        daysInWeek = 7;
     static const CEventSchedulerWeekDay epochWeekDay = CEventSchedulerDayNumber_Thursday;
 
-    CEventSchedulerItem     items[numberOfSchedulerItems];
+    // Items are stored in slots, which do not move for as long as the item is stored. A slot map (generation
+    // per slot, plus a stack of free slots) turns handles into slots. All arrays are owned by the storage policy.
+    int                     numberOfSchedulerItems;             // Capacity of the storage
+    CEventSchedulerItem     *items;
+    CEventSchedulerSlotState *slotStates;
+    uint16_t                *slotGenerations;
+    uint16_t                *freeSlots;
+    int                     numberOfFreeSlots = 0;
     int                     numberOfStoredItems = 0;
 
+    int                     contentIndexSize;                   // Power of two, at least 1.5 times numberOfSchedulerItems
+    uint16_t                *contentIndex;                      // Hash index on item contents, for lookups by value
+
+    CEventSchedulerScheduleEntry *schedule;                     // Rebuilt only when items or activation times change
+
+    // The random offsets, sunrise and sunset differ per week, so the compiled schedule holds the activation times of
+    // one week, the local week that starts at scheduleLocalBeginningOfWeek. The first lookup in another week compiles
+    // the schedule for that week. The last activation of the week before and the first of the week after are only
+    // calculated when a lookup needs them.
+    time_t                  scheduleLocalBeginningOfWeek = 0;
+    bool                    areAdjacentActivationsValid = false;
+    CEventSchedulerActivation lastActivationOfPreviousWeek = {};
+    CEventSchedulerActivation firstActivationOfNextWeek = {};
+
+    // Bulk updates. Items added or removed during an update only change their slot state. Nothing of this is
+    // visible through the schedule until the update is committed.
+    bool                    updateInProgress = false;
+
     CSunriseCalculator      sunriseCalculator;
-    RandomMT19937Generator  randomGenerator;
+
+    // Sunrise and sunset of the last calculated day for each week day, so that the items on the same day, and
+    // repeated recalculations, do not redo the calculation. Optionally backed by a cache shared between schedulers.
+    CEventSchedulerSolarDay solarDays[7];
+    CSolarTableCache        *solarTableCache = nullptr;
+    CEventSchedulerRandomGenerator randomGenerator;
 
     time_t                  secondsFromGMT;
     time_t                  (*timeProvider)(void);
 
+    // When set, the offset from GMT follows the time zone instead of secondsFromGMT. The span of the last lookup
+    // answers the next ones until the next transition.
+    const CEventSchedulerTimeZone *timeZone = nullptr;
+    CEventSchedulerTimeZoneSpan timeZoneSpan;
+
+    // One-shot items. The timing wheel is only created when the first one is added.
+    CEventSchedulerTimingWheel *oneShotItems = nullptr;
+    time_t                  lastOneShotTime = -1;               // The last one-shot item that activated
+    CEventSchedulerItem     lastOneShotItem;
+
+    uint32_t                changeCounter = 0;
+    CEventSchedulerChangeListener changeListener = nullptr;
+    void                    *changeListenerContext = nullptr;
+
+    // Lock-free readers, see EventSchedulerConcurrentReader.hpp. Only created by enableConcurrentReads().
+    CEventSchedulerConcurrentReader *concurrentReader = nullptr;
+
+    // Counters and latencies, see EventSchedulerMetrics.hpp. Only recorded with EVENT_SCHEDULER_METRICS.
+    CEventSchedulerMetrics  *metrics = nullptr;
+
+protected:
+    CEventSchedulerBase(const CEventSchedulerStorage &storage, double latitude, double longitude, time_t secondsFromGMT, time_t (*timeProvider)(void));
+
+    // Implemented by the storage policy. Returns false if the storage can not grow.
+    virtual bool resizeStorage(CEventSchedulerStorage &storage, int newCapacity) = 0;
+
 public:
-    CEventScheduler(double latitude, double longitude, time_t secondsFromGMT, time_t (*timeProvider)(void));
-    ~CEventScheduler();
+    virtual ~CEventSchedulerBase();
+
+    // The arrays point into the storage of the scheduler, and the timing wheel and the reader are owned by it, so a
+    // copy would share them.
+    CEventSchedulerBase(const CEventSchedulerBase &) = delete;
+    CEventSchedulerBase &operator=(const CEventSchedulerBase &) = delete;
+
+    int getCapacity(void);
 
     time_t getSecondsFromGMT(void);
     void setSecondsFromGMT(time_t secondsFromGMT);
 
+    // Follow the offset of a time zone, which can be shared between schedulers and must outlive them. Pass nullptr,
+    // or call setSecondsFromGMT(), to go back to a fixed offset.
+    void setTimeZone(const CEventSchedulerTimeZone *timeZone);
+    const CEventSchedulerTimeZone *getTimeZone(void);
+
+    // The random offsets follow from the seed, see calculateRandomOffset(). The seed starts out from the time the
+    // scheduler was created. Set it to get the same activation times again, e.g. to replay a problem.
+    uint32_t getRandomSeed(void);
+    void setRandomSeed(uint32_t seed);
+
     void resetItems(void);
 
-    int addItem(const CEventSchedulerItem& item);
+    CEventSchedulerItemHandle addItem(const CEventSchedulerItem& item);
     int removeItem(const CEventSchedulerItem& item);
+    int removeItem(CEventSchedulerItemHandle handle);
+    int updateItem(CEventSchedulerItemHandle handle, const CEventSchedulerItem& item);
+
+    int beginUpdate(void);
+    int commitUpdate(void);
+    void cancelUpdate(void);
+
+    int replaceAllItems(const CEventSchedulerItem *newItems, int numberOfNewItems, CEventSchedulerItemHandle *handles = nullptr);
+
+    CEventSchedulerTimerHandle addOneShotItem(time_t timestampGMT, uint8_t userDefined);
+    int cancelOneShotItem(CEventSchedulerTimerHandle handle);
+    int getNumberOfOneShotItems(void);
 
     int getNumberOfItems(void);
 
     CEventSchedulerItem getItem(int index);
     CEventSchedulerItem findItem(const CEventSchedulerItem& itemToFind);
+    CEventSchedulerItem findItem(CEventSchedulerItemHandle handle);
+    CEventSchedulerItemHandle findItemHandle(const CEventSchedulerItem& itemToFind);
 
     CEventSchedulerItem getActiveItem(void);
     CEventSchedulerItem getNextActiveItem(void);
@@ -75,9 +287,30 @@ public:
     CEventSchedulerItem getActiveItem(time_t timestampGMT);
     CEventSchedulerItem getNextActiveItem(time_t timestampGMT);
 
+    int getActiveAndNextItem(CEventSchedulerItem &activeItem, CEventSchedulerItem &nextActiveItem);
+    int getActiveAndNextItem(time_t timestampGMT, CEventSchedulerItem &activeItem, CEventSchedulerItem &nextActiveItem);
+
+    time_t getNextActivationTime(void);
+    time_t getNextActivationTime(time_t timestampGMT);
+
+    time_t getCurrentTime(void);
+
+    CEventSchedulerActivationRange activations(time_t fromGMT, time_t toGMT);
+
+    uint32_t getChangeCounter(void);
+    void setChangeListener(CEventSchedulerChangeListener listener, void *context);
+
+    CEventSchedulerConcurrentReader *enableConcurrentReads(void);
+
     time_t sunrise(time_t timestampGMT);
     time_t sunset(time_t timestampGMT);
 
+    void setSolarTableCache(CSolarTableCache *cache);
+    void setSunriseCalculatorMode(CSunriseCalculatorMode mode);
+
+    void setMetrics(CEventSchedulerMetrics *metrics);
+
+    int calculateMinutesFromBeginningOfWeek(time_t timestampGMT);
     int calculateMinutesFromBeginningOfDay(time_t timestampGMT);
     int calculateSecondsFromBeginningOfDay(time_t timestampGMT);
     int calculateBeginningOfDayInSeconds(time_t timestampGMT);
@@ -88,11 +321,85 @@ public:
     
 private:
 
+    time_t localTimeForGMT(time_t timestampGMT);
+    time_t gmtForLocalTime(time_t localTime);
+    time_t calculateLocalBeginningOfWeek(time_t timestampGMT);
+
+    void compileScheduleForWeekOf(time_t timestampGMT);
+    void calculateAdjacentActivations(void);
     int getActiveItemIndex(time_t timestampGMT);
-    int findItemIndex(const CEventSchedulerItem& itemToFind);
+    time_t calculateActivationTime(int scheduleIndex);
+    time_t getNextWeeklyActivationTime(time_t timestampGMT, CEventSchedulerItem &nextItem);
+    int findItemIndex(const CEventSchedulerItem& itemToFind, bool includePending, bool identicalOnly = false);
+    int removeItemInSlot(int slot);
+
+    void clearItems(void);
+
+    void attachStorage(const CEventSchedulerStorage &storage);
+    bool growStorage(void);
+
+    int allocateSlot(const CEventSchedulerItem& item);
+    void releaseSlot(int slot);
+    bool isVisible(int slot);
+    CEventSchedulerItemHandle makeHandle(int slot);
+    int slotForHandle(CEventSchedulerItemHandle handle);
 
-    void sortItems(void);
+    void insertIntoContentIndex(int slot);
+    void removeFromContentIndex(int slot);
+
+    void compileSchedule(void);
+    void insertIntoSchedule(int itemIndex);
+    void removeFromSchedule(int itemIndex);
+    int findScheduleIndex(int itemIndex);
+    uint16_t calculateMinuteOfWeek(const CEventSchedulerItem &item);
 
     void recalculateAllActivationTimes(void);
-    void recalculateActivationTime(CEventSchedulerItem &item);
-};
\ No newline at end of file
+    void recalculateAllActivationTimes(time_t localBeginningOfWeek);
+    void recalculateActivationTime(int slot);
+    void recalculateActivationTime(int slot, time_t localBeginningOfThisWeek);
+    int calculateRandomOffset(const CEventSchedulerItem &item, int slot, time_t localBeginningOfWeek);
+
+    void sunRiseAndSetForDay(time_t beginningOfDayGMT, time_t &sunRise, time_t &sunSet);
+
+    void notifyChanged(void);
+    void publishSnapshot(void);
+
+    void processOneShotItems(time_t timestampGMT);
+    static void oneShotItemActivated(CEventSchedulerTimerHandle handle, time_t timestampGMT, const CEventSchedulerItem &item, void *context);
+
+    friend class CEventSchedulerJournal;
+    int removeIdenticalItem(const CEventSchedulerItem &item, int preferredSlot = -1);
+    CEventSchedulerItemHandle addItemInSlot(const CEventSchedulerItem &item, int slot);
+
+    friend class CEventSchedulerSnapshotFile;
+    int restoreSchedule(const CEventSchedulerItem *itemsInScheduleOrder, const uint16_t *slotsInScheduleOrder, int numberOfItems, time_t secondsFromGMT, uint32_t randomSeed, time_t localBeginningOfWeek);
+
+    friend class CEventSchedulerActivationRange;
+    bool findNextActivation(time_t toGMT, CEventSchedulerActivation &activation, int &slot);
+    uint16_t calculateMinuteOfWeekInWeek(int slot, time_t localBeginningOfWeek, CEventSchedulerItem &itemInWeek);
+};
+
+// A scheduler with storage for Capacity items. The storage policy decides where the items live, see
+// EventSchedulerStorage.hpp. With CEventSchedulerGrowableStorage, Capacity is the initial capacity.
+template <int Capacity, typename StoragePolicy = CEventSchedulerInlineStorage<Capacity>>
+class CEventSchedulerT : private StoragePolicy, public CEventSchedulerBase {
+public:
+    CEventSchedulerT(double latitude, double longitude, time_t secondsFromGMT, time_t (*timeProvider)(void)) :
+    StoragePolicy(Capacity),
+    CEventSchedulerBase(StoragePolicy::storageView(), latitude, longitude, secondsFromGMT, timeProvider) {
+    }
+
+    // For storage policies that need arguments, e.g. CEventSchedulerExternalStorage.
+    CEventSchedulerT(const StoragePolicy &storagePolicy, double latitude, double longitude, time_t secondsFromGMT, time_t (*timeProvider)(void)) :
+    StoragePolicy(storagePolicy),
+    CEventSchedulerBase(StoragePolicy::storageView(), latitude, longitude, secondsFromGMT, timeProvider) {
+    }
+
+protected:
+    bool resizeStorage(CEventSchedulerStorage &storage, int newCapacity) override {
+        return StoragePolicy::resizeStorage(storage, newCapacity);
+    }
+};
+
+// We hold storage for on average 10 events per day, 70 events per week max.
+typedef CEventSchedulerT<70> CEventScheduler;
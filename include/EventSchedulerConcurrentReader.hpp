@@ -0,0 +1,111 @@
+#pragma once
+
+#include <time.h>
+#include <stdint.h>
+#include <atomic>
+
+#include "EventSchedulerItem.hpp"
+#include "EventSchedulerTimeZone.hpp"
+
+class CEventSchedulerBase;
+
+// NOTES
+//
+// The scheduler is not thread safe. A CEventSchedulerConcurrentReader, as returned by
+// CEventSchedulerBase::enableConcurrentReads(), answers the questions that are asked most (which item is active,
+// which one is next, and when) from any number of threads, without a lock, while the scheduler is being changed.
+//
+// The reader holds two snapshots of the compiled schedule, with copies of the items in it, and of the things that are
+// needed to look up an item (the seconds from GMT, and the first one-shot items). Readers always use the published
+// snapshot. After every change, the scheduler fills the other snapshot and publishes it. Every reader announces itself
+// in a read indicator before it looks at the published snapshot, and leaves it afterwards. Before the scheduler fills a
+// snapshot again, it waits until the readers that may still use it have left (the 'left-right' technique). So a reader
+// never waits and never retries, and only the writer waits, for reads that take a binary search at most. The read
+// indicators are spread over a few cache lines, so that readers on different cores do not fight over one.
+//
+// The scheduler still allows one writer at a time (e.g. the thread of a CEventSchedulerRunner, which holds its
+// mutex). Only the readers can do without.
+//
+// A snapshot knows about the last one-shot item that activated, and the first one that will. The scheduler publishes
+// a new snapshot when a one-shot item activates, which it notices when it is asked for the active item (as the runner
+// does). Until then, readers activate the first one-shot item themselves. A second one-shot item that becomes due
+// before the scheduler gets to it is not seen by the readers.
+//
+// The compiled schedule holds the activation times of one week. A snapshot also knows the last activation of the
+// week before and the first of the week after, so the readers are exact from the last activation of the week before
+// up to the first of the week after. The scheduler compiles the next week at its first lookup in that week (the
+// runner wakes up for the first activation of the week), and publishes it. Times further away repeat the week of the
+// snapshot, without the random offsets, sunrise and sunset of their own week.
+class CEventSchedulerConcurrentReader {
+public:
+    CEventSchedulerItem getActiveItem(void);
+    CEventSchedulerItem getNextActiveItem(void);
+
+    CEventSchedulerItem getActiveItem(time_t timestampGMT);
+    CEventSchedulerItem getNextActiveItem(time_t timestampGMT);
+
+    int getActiveAndNextItem(CEventSchedulerItem &activeItem, CEventSchedulerItem &nextActiveItem);
+    int getActiveAndNextItem(time_t timestampGMT, CEventSchedulerItem &activeItem, CEventSchedulerItem &nextActiveItem);
+
+    time_t getNextActivationTime(void);
+    time_t getNextActivationTime(time_t timestampGMT);
+
+    // The change counter of the scheduler at the time the snapshot was published.
+    uint32_t getChangeCounter(void);
+
+    int getNumberOfItems(void);
+
+private:
+    friend class CEventSchedulerBase;
+
+    static const int        numberOfReadIndicators = 8;
+
+    struct Snapshot {
+        uint16_t            *minutesOfWeek = nullptr;       // Sorted, as in the compiled schedule
+        CEventSchedulerItem *items = nullptr;               // The item of each entry
+        int                 numberOfEntries = 0;
+        int                 capacity = 0;
+
+        time_t              localBeginningOfWeek = 0;       // The week of the compiled schedule, in local time
+        time_t              lastTimeOfPreviousWeek = -1;    // The last activation of the week before
+        CEventSchedulerItem lastItemOfPreviousWeek;
+        time_t              firstTimeOfNextWeek = -1;       // The first activation of the week after
+        CEventSchedulerItem firstItemOfNextWeek;
+
+        time_t              secondsFromGMT = 0;
+        const CEventSchedulerTimeZone *timeZone = nullptr;  // Instead of secondsFromGMT when set
+        time_t              lastOneShotTime = -1;
+        CEventSchedulerItem lastOneShotItem;
+        time_t              nextOneShotTime = -1;
+        CEventSchedulerItem nextOneShotItem;
+        uint32_t            changeCounter = 0;
+    };
+
+    struct alignas(64) ReadIndicator {
+        std::atomic<int>    numberOfReaders{0};
+    };
+
+    Snapshot                snapshots[2];
+    std::atomic<int>        publishedSnapshot{0};
+    std::atomic<int>        readIndicatorVersion{0};
+    ReadIndicator           readIndicators[2][numberOfReadIndicators];
+
+    time_t                  (*timeProvider)(void);
+
+    CEventSchedulerConcurrentReader(time_t (*timeProvider)(void));
+    ~CEventSchedulerConcurrentReader();
+
+    CEventSchedulerConcurrentReader(const CEventSchedulerConcurrentReader &) = delete;
+    CEventSchedulerConcurrentReader &operator=(const CEventSchedulerConcurrentReader &) = delete;
+
+    // Used by the scheduler: fill the snapshot that is not published, then publish it.
+    Snapshot *beginPublish(int numberOfEntries);
+    void endPublish(void);
+
+    const Snapshot &enterRead(int &version, int &readIndicator);
+    void leaveRead(int version, int readIndicator);
+    void waitForReaders(int version);
+    static int readIndicatorForThread(void);
+
+    void lookup(const Snapshot &snapshot, time_t timestampGMT, CEventSchedulerItem &activeItem, CEventSchedulerItem &nextActiveItem, time_t &nextActivationTime);
+};
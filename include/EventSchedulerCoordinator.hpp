@@ -0,0 +1,121 @@
+#pragma once
+
+#include <time.h>
+#include <stdint.h>
+#include <atomic>
+#include <mutex>
+#include <thread>
+
+#include "EventScheduler.hpp"
+#include "EventSchedulerRunner.hpp"
+#include "EventSchedulerWaiter.hpp"
+
+// NOTES
+//
+// The coordinator is a CEventSchedulerRunner for many schedulers at once, on a single thread. It keeps the time of
+// the next activation of every scheduler in a 4-ary min-heap, so it only has to look at the first entry to know how
+// long it can sleep, and only at the schedulers that are due when it wakes up. Each of those costs O(log N) to move
+// to its next activation time, instead of a sweep over all schedulers.
+//
+// The coordinator installs itself as the change listener of every scheduler that is added. A change only puts the
+// scheduler on a list of changed schedulers, and wakes up the coordinator, which then looks at the scheduler again and
+// moves it in the heap. A scheduler can therefore not be in a coordinator and in a runner at the same time.
+//
+// The schedulers are not thread safe. When the coordinator runs on its own thread (start()), all schedulers in it must
+// be changed while holding getSchedulerMutex(), and schedulers must be added and removed while holding it as well.
+// The callback is called with the mutex held, so it can change the schedulers directly, but must not lock the mutex
+// itself.
+//
+// Like the runner, the coordinator sleeps on the system clock, so the schedulers must use the real time as their
+// timeProvider. processDue() can also be called directly, e.g. with a simulated clock, instead of run().
+class CEventSchedulerCoordinator {
+public:
+    CEventSchedulerCoordinator(CEventSchedulerTransitionCallback callback, void *context = nullptr);
+    ~CEventSchedulerCoordinator();
+
+    CEventSchedulerCoordinator(const CEventSchedulerCoordinator &) = delete;
+    CEventSchedulerCoordinator &operator=(const CEventSchedulerCoordinator &) = delete;
+
+    // Returns an id for the scheduler, or -1 if there is no memory left. The callback is called for the scheduler
+    // the next time the coordinator looks at it, with the item that is active at that moment.
+    int addScheduler(CEventSchedulerBase &scheduler);
+    int removeScheduler(int schedulerId);
+    int getNumberOfSchedulers(void);
+
+    // Run on the calling thread, until stop() is called (e.g. from the callback).
+    int run(void);
+
+    // Run on a thread of its own.
+    int start(void);
+    void stop(void);
+
+    void wakeUp(void);
+
+    // Handle the changed schedulers, and the activations up to and including the given time. Returns the time of the
+    // first activation after that, or -1 if there is none.
+    time_t processDue(time_t timestampGMT);
+
+    // The time of the first activation of all schedulers, or -1 if there is none.
+    time_t getNextActivationTime(void);
+
+    std::mutex &getSchedulerMutex(void);
+
+    uint32_t getNumberOfWakeUps(void);
+    uint32_t getNumberOfCallbacks(void);
+
+private:
+    static const int        heapArity = 4;
+    static const int        registrationsPerBlock = 1024;     // Registrations never move, they are listener contexts
+
+    struct Registration {
+        CEventSchedulerBase         *scheduler;     // nullptr when not in use
+        CEventSchedulerCoordinator  *coordinator;
+        int                         id;
+        int                         heapPosition;   // -1 when not in the heap
+        int                         next;           // Next changed registration, or next free one
+        bool                        isChanged;
+        bool                        isFirstActivation;
+        CEventSchedulerItem         previousActiveItem;
+    };
+
+    struct HeapEntry {
+        time_t                      nextActivationTime;
+        int32_t                     registration;
+    };
+
+    CEventSchedulerTransitionCallback callback;
+    void                    *context;
+
+    Registration            **registrationBlocks = nullptr;
+    int                     numberOfRegistrationBlocks = 0;
+    int                     numberOfRegistrations = 0;     // Including the free ones
+    int                     numberOfSchedulers = 0;
+    int                     firstFreeRegistration = -1;
+    int                     firstChangedRegistration = -1;
+
+    HeapEntry               *heap = nullptr;
+    int                     heapSize = 0;
+    int                     heapCapacity = 0;
+
+    std::mutex              schedulerMutex;
+    std::thread             thread;
+    std::atomic<bool>       running;
+    std::atomic<uint32_t>   numberOfWakeUps;
+    uint32_t                numberOfCallbacks = 0;
+
+    CEventSchedulerWaiter   waiter;
+
+    void runLoop(void);
+
+    Registration &registration(int id);
+    void markChanged(Registration &registration);
+    void activate(Registration &registration, time_t timestampGMT, bool activationReached);
+
+    bool setHeapTime(Registration &registration, time_t nextActivationTime);
+    void removeFromHeap(Registration &registration);
+    void siftUp(int position);
+    void siftDown(int position);
+    void placeInHeap(int position, const HeapEntry &entry);
+
+    static void schedulerChanged(CEventSchedulerBase &scheduler, void *context);
+};
@@ -0,0 +1,114 @@
+#pragma once
+
+#include <time.h>
+#include <stdint.h>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+
+#include "EventScheduler.hpp"
+
+// A transition of a scheduler, as passed to the action handlers.
+struct CEventSchedulerTransition {
+    CEventSchedulerBase     *scheduler;
+    CEventSchedulerItem     activeItem;
+    CEventSchedulerItem     nextActiveItem;
+    time_t                  timestampGMT;
+};
+
+// Called on a worker thread of the dispatcher. The scheduler is not thread safe, so the handler must not use the
+// scheduler without the lock that the caller uses for it (e.g. CEventSchedulerRunner::getSchedulerMutex()).
+typedef void (*CEventSchedulerActionHandler)(const CEventSchedulerTransition &transition, void *context);
+
+class CEventSchedulerDispatcher;
+
+// NOTES
+//
+// The dispatcher runs the action handlers of the items on a pool of worker threads, so that the thread that detects
+// the transitions (e.g. a CEventSchedulerRunner) never waits for a handler.
+//
+// Each scheduler gets a strand from the dispatcher. A strand has its own action table, with a handler per userDefined
+// value of the items (so 16 handlers), and its own bounded queue of transitions. The transitions of a strand are
+// handled one at a time and in order, by whichever worker is free. A worker handles a few transitions of a strand and
+// then moves on to the next strand that has work, so a slow handler only holds up its own strand, and other strands
+// keep going on the other workers.
+//
+// When the queue of a strand is full, post() fails and returns -1, so the producer decides what to do: drop the
+// transition, retry later, or slow down. CEventSchedulerDispatcher::runnerCallback() drops it and counts it.
+class CEventSchedulerStrand {
+public:
+    static const int numberOfActions = 16;      // One per userDefined value
+
+    void setAction(uint8_t userDefined, CEventSchedulerActionHandler handler, void *context = nullptr);
+
+    // Queue the transition, to call the action of the active item. Returns -1 if the queue is full.
+    int post(const CEventSchedulerTransition &transition);
+
+    int getNumberOfQueuedTransitions(void);
+    uint32_t getNumberOfRejectedTransitions(void);
+
+private:
+    friend class CEventSchedulerDispatcher;
+
+    struct Action {
+        CEventSchedulerActionHandler    handler = nullptr;
+        void                            *context = nullptr;
+    };
+
+    CEventSchedulerStrand(CEventSchedulerDispatcher &dispatcher, int queueCapacity);
+    ~CEventSchedulerStrand();
+
+    CEventSchedulerDispatcher   &dispatcher;
+    Action                      actions[numberOfActions];
+
+    // Ring buffer of transitions, guarded by the mutex of the dispatcher.
+    CEventSchedulerTransition   *transitions;
+    int                         queueCapacity;
+    int                         firstTransition = 0;
+    int                         numberOfTransitions = 0;
+    uint32_t                    numberOfRejectedTransitions = 0;
+
+    bool                        isScheduled = false;        // In the ready list, or being handled by a worker
+    CEventSchedulerStrand       *nextReady = nullptr;
+    CEventSchedulerStrand       *nextStrand = nullptr;
+};
+
+class CEventSchedulerDispatcher {
+public:
+    CEventSchedulerDispatcher(int numberOfThreads, int queueCapacity = 64);
+    ~CEventSchedulerDispatcher();
+
+    CEventSchedulerDispatcher(const CEventSchedulerDispatcher &) = delete;
+    CEventSchedulerDispatcher &operator=(const CEventSchedulerDispatcher &) = delete;
+
+    // The strand is owned by the dispatcher, and lives as long as the dispatcher.
+    CEventSchedulerStrand *createStrand(void);
+
+    // Wait until all queued transitions have been handled.
+    void waitUntilIdle(void);
+
+    // A CEventSchedulerTransitionCallback for CEventSchedulerRunner, with the strand as context.
+    static void runnerCallback(CEventSchedulerBase &scheduler, const CEventSchedulerItem &activeItem, const CEventSchedulerItem &nextActiveItem, time_t timestampGMT, void *context);
+
+private:
+    friend class CEventSchedulerStrand;
+
+    static const int        transitionsPerTurn = 8;     // Transitions of one strand that a worker handles in one go
+
+    std::mutex              mutex;
+    std::condition_variable workAvailable;
+    std::condition_variable workDone;
+
+    std::thread             *threads;
+    int                     numberOfThreads;
+    int                     queueCapacity;
+    int                     numberOfBusyWorkers = 0;
+    bool                    isStopping = false;
+
+    CEventSchedulerStrand   *firstReady = nullptr;
+    CEventSchedulerStrand   *lastReady = nullptr;
+    CEventSchedulerStrand   *firstStrand = nullptr;
+
+    void makeReady(CEventSchedulerStrand *strand);
+    void workerLoop(void);
+};
@@ -0,0 +1,182 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <deque>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+#include "EventScheduler.hpp"
+
+// NOTES
+//
+// Imports items for many schedulers ('tenants') from large files, one item per line, as CSV:
+//
+//     tenant,weekDay,eventType,timeOffset,randomOffsetMinus,randomOffsetPlus,userDefined
+//     living-room,Monday,Time,23:00,30,90,0
+//     living-room,2,Sunset,,30,30,1
+//
+// or as JSON lines, with the same names:
+//
+//     {"tenant": "living-room", "weekDay": "Monday", "eventType": "Time", "timeOffset": "23:00", "randomOffsetPlus": 90}
+//
+// A week day is 1 (Sunday) .. 7 (Saturday), or its English name (or the first three letters of it). A type is Time,
+// Sunrise or Sunset (or 1..3). A time offset is a number of minutes (0..1439) or hh:mm, and is not needed for sunrise
+// and sunset. The random offsets (0..127) and userDefined (0..15) are 0 when left out. Lines that are empty or start
+// with '#' are skipped, and so is a CSV header line. Strings in JSON can not have escapes, which is never needed here.
+//
+// A file is memory mapped, and parsed in place: nothing is copied, apart from the items. The pages that have been
+// parsed are given back to the system on the way, so the memory that is used does not grow with the size of the
+// file. A stream (e.g. a pipe) is read in chunks of a fixed size instead.
+//
+// The items are collected per tenant, and handed to the scheduler of the tenant in batches, in a single bulk update
+// per batch. Only a limited number of tenants have a batch open at the same time: when another tenant needs one, the
+// batch of the tenant that was used longest ago is handed over first. Rows of one tenant that come together in the
+// file need the fewest updates.
+//
+// Every tenant gets a report of its rows, with the line numbers and reasons of its first errors. The reports are the
+// only thing that grows, with the number of tenants, not with the number of rows.
+enum CEventSchedulerImportFormat_Value {
+    CEventSchedulerImportFormat_Automatic = 0,      // JSON lines if the first line starts with '{', otherwise CSV
+    CEventSchedulerImportFormat_CSV,
+    CEventSchedulerImportFormat_JSONLines
+};
+
+enum CEventSchedulerImportError_Value {
+    CEventSchedulerImportError_Syntax = 0,          // Not a row of the format, or a field is missing
+    CEventSchedulerImportError_WeekDay,
+    CEventSchedulerImportError_EventType,           // Also for one-shot items, which can not be imported
+    CEventSchedulerImportError_TimeOffset,
+    CEventSchedulerImportError_RandomOffset,
+    CEventSchedulerImportError_UserDefined,
+    CEventSchedulerImportError_LineTooLong,         // Longer than the chunk of a stream
+    CEventSchedulerImportError_UnknownTenant,       // There is no scheduler for the tenant
+    CEventSchedulerImportError_Scheduler,           // The scheduler did not take the item, e.g. it is full
+
+    CEventSchedulerImportError_Count
+};
+
+struct CEventSchedulerImportError {
+    uint64_t                            lineNumber;     // From 1
+    CEventSchedulerImportError_Value    error;
+};
+
+struct CEventSchedulerImportReport {
+    static const int                    maximumNumberOfErrors = 8;
+
+    std::string                         tenant;
+    CEventSchedulerBase                 *scheduler;     // nullptr for an unknown tenant
+    uint64_t                            numberOfRows;
+    uint64_t                            numberOfImportedItems;
+    uint64_t                            numberOfErrors;
+    CEventSchedulerImportError          errors[maximumNumberOfErrors];  // The first ones
+
+    int getNumberOfStoredErrors(void) const { return numberOfErrors < maximumNumberOfErrors ? (int)numberOfErrors : maximumNumberOfErrors; }
+};
+
+// Returns the scheduler of the tenant, or nullptr if there is none. Called once per tenant.
+typedef CEventSchedulerBase *(*CEventSchedulerImporterTenantResolver)(const char *tenant, size_t tenantLength, void *context);
+
+class CEventSchedulerImporter {
+public:
+    static const size_t     streamChunkSize = 1024 * 1024;
+
+    CEventSchedulerImporter(CEventSchedulerImporterTenantResolver resolver, void *context, int batchSize = 1024, int maximumOpenBatches = 64);
+    ~CEventSchedulerImporter();
+
+    CEventSchedulerImporter(const CEventSchedulerImporter &) = delete;
+    CEventSchedulerImporter &operator=(const CEventSchedulerImporter &) = delete;
+
+    // When set, the items of a tenant replace all items its scheduler had, instead of being added to them. Tenants
+    // without a single valid row keep their items.
+    void setReplaceItems(bool replaceItems);
+
+    // All return -1 if the input can not be read, and 0 otherwise, also when rows had errors: see the reports.
+    int importFile(const char *path, CEventSchedulerImportFormat_Value format = CEventSchedulerImportFormat_Automatic);
+    int importStream(int fileDescriptor, CEventSchedulerImportFormat_Value format = CEventSchedulerImportFormat_Automatic);
+    int importBuffer(const char *data, size_t size, CEventSchedulerImportFormat_Value format = CEventSchedulerImportFormat_Automatic);
+
+    int getNumberOfReports(void);
+    const CEventSchedulerImportReport &getReport(int index);
+
+    uint64_t getNumberOfRows(void);
+    uint64_t getNumberOfImportedItems(void);
+    uint64_t getNumberOfErrors(void);
+
+    // Forget the reports, e.g. before the next import.
+    void reset(void);
+
+    static const char *errorAsString(CEventSchedulerImportError_Value error);
+
+private:
+    // A part of the input, which is not copied.
+    struct Field {
+        const char  *data;
+        size_t      size;
+    };
+
+    struct Row {
+        Field       tenant;
+        Field       weekDay;
+        Field       eventType;
+        Field       timeOffset;
+        Field       randomOffsetMinus;
+        Field       randomOffsetPlus;
+        Field       userDefined;
+    };
+
+    struct Batch {
+        int                     tenantIndex;            // -1 if not in use
+        int                     numberOfItems;
+        uint64_t                lastUse;
+        CEventSchedulerItem     *items;
+        uint64_t                *lineNumbers;
+    };
+
+    CEventSchedulerImporterTenantResolver resolver;
+    void                    *context;
+    const int               batchSize;
+    const int               maximumOpenBatches;
+    bool                    replaceItems = false;
+
+    struct Tenant {
+        CEventSchedulerImportReport report;
+        int                     batchIndex;             // The open batch, or -1
+        bool                    isReplaced;             // The items of the scheduler have been removed
+    };
+
+    std::deque<Tenant>      tenants;                    // A deque, so that the tenant strings never move
+    std::unordered_map<std::string_view, int> tenantIndexes;
+    int                     lastTenantIndex = -1;       // Rows of a tenant usually come together
+
+    Batch                   *batches;
+    uint64_t                numberOfBatchUses = 0;
+
+    CEventSchedulerImportFormat_Value format = CEventSchedulerImportFormat_Automatic;
+    uint64_t                lineNumber = 0;
+    uint64_t                numberOfRows = 0;
+    uint64_t                numberOfImportedItems = 0;
+    uint64_t                numberOfErrors = 0;
+
+    void beginImport(CEventSchedulerImportFormat_Value format);
+    void endImport(void);
+    size_t importLines(const char *data, size_t size, bool isLast);
+    void importLine(const char *line, size_t size);
+
+    bool splitCSV(const char *line, size_t size, Row &row);
+    bool splitJSON(const char *line, size_t size, Row &row);
+    bool parseItem(const Row &row, CEventSchedulerItem &item, CEventSchedulerImportError_Value &error);
+
+    int tenantForRow(Field tenant);
+    void addError(int tenantIndex, uint64_t lineNumber, CEventSchedulerImportError_Value error);
+    void addToBatch(int tenantIndex, const CEventSchedulerItem &item);
+    void flushBatch(Batch &batch);
+
+    static bool parseNumber(Field field, int &value);
+    static bool parseWeekDay(Field field, CEventSchedulerWeekDay &weekDay);
+    static bool parseEventType(Field field, CEventSchedulerItemType &eventType);
+    static bool parseTimeOffset(Field field, int &timeOffset);
+    static bool equalsIgnoringCase(Field field, const char *text);
+    static Field trim(const char *data, size_t size);
+};
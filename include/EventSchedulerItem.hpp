@@ -2,6 +2,8 @@
 
 #include <stdio.h>
 #include <stdint.h>
+#include <iostream>
+#include <iomanip>
 
 enum CEventSchedulerWeekDay: uint8_t {
     CEventSchedulerDayNumber_Uninitialized = 0,
@@ -14,8 +16,10 @@ enum CEventSchedulerWeekDay: uint8_t {
     CEventSchedulerDayNumber_Saturday
 };
 
+// The type has 2 bits, all in use. An empty item (see CEventSchedulerItem::isValid()) has type 0 too, so check
+// isValid() before looking at the type.
 enum CEventSchedulerItemType: uint8_t {
-    CEventSchedulerItemType_Spare = 0,                  // Unused, you can use it if you can come up with something useful
+    CEventSchedulerItemType_OneShot = 0,                // Once, at an absolute time, see CEventSchedulerBase::addOneShotItem()
     CEventSchedulerItemType_Time,                       // Specific time of day       
     CEventSchedulerItemType_Sunrise,                    // Sunrise 
     CEventSchedulerItemType_Sunset                      // Sunset
@@ -47,7 +51,7 @@ struct CEventSchedulerItem {
         timeOffset(0),
         randomOffsetMinus(0),
         randomOffsetPlus(0),
-        eventType(CEventSchedulerItemType_Spare),
+        eventType(CEventSchedulerItemType_OneShot),
         activeWeekDay(CEventSchedulerDayNumber_Uninitialized),
         activeTimeOffset(0),
         userDefined(0)
@@ -92,8 +96,11 @@ struct CEventSchedulerItem {
     }
 
     const char *eventTypeAsString() const {
+        if (!isValid()) {
+            return "Invalid";
+        }
         switch (eventType) {
-            case CEventSchedulerItemType_Spare: return "Spare";
+            case CEventSchedulerItemType_OneShot: return "OneShot";
             case CEventSchedulerItemType_Time: return "Time";
             case CEventSchedulerItemType_Sunrise: return "Sunrise";
             case CEventSchedulerItemType_Sunset: return "Sunset";
@@ -0,0 +1,180 @@
+#pragma once
+
+#include <time.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "EventScheduler.hpp"
+
+// NOTES
+//
+// Persistence of the items of one scheduler, as a snapshot (see EventSchedulerSnapshot.hpp) and a write-ahead journal
+// of the edits since that snapshot. Make the edits through the journal instead of through the scheduler: it edits
+// the scheduler and appends a small record for the edit to the journal.
+//
+//     CEventSchedulerJournal journal;
+//     journal.open(scheduler, "/data/living-room");     // Recovers the items, if there were any
+//     journal.addItem(item);
+//     journal.sync();                                     // Only when the caller has to know the edit is on disk
+//
+// The records are written and synced to disk by a thread of the journal, in groups: the thread waits at most
+// maximumCommitDelay after the first record of a group, and then writes and syncs all records that came in meanwhile
+// with a single fdatasync(). An edit never waits for the disk, and a crash loses at most the edits of the last
+// maximumCommitDelay. sync() waits until all records so far are on disk, it shares the fdatasync() of the group.
+//
+// When the journal has grown past compactionThreshold, the next edit takes a snapshot of the scheduler in memory,
+// and the journal starts over in a new file. A second thread of the journal writes the snapshot, and then replaces
+// the old journal with the new one. Every journal file names the snapshot that it continues (by its checksum), so
+// recovery knows which journal files to replay, wherever a crash happened. The files are:
+//
+//     <path>.snapshot         the items at the last compaction
+//     <path>.journal          the edits since that snapshot
+//     <path>.journal.new      the edits since a snapshot that is still being written
+//
+// open() replays the journal in a single bulk update of the scheduler, and stops at the first record that is not
+// complete (a crash during the write). After that, it compacts right away, so the journal always starts empty.
+//
+// The journal records what was done, not the outcome. Items that are added again on replay go into the slot they were
+// added in, so they get the same random offsets as before, as those follow from the random seed (which is in the
+// snapshot, and journaled by setRandomSeed()), the item, its slot and the week. A removal records the whole item that
+// was removed and its slot, and removes that item on replay, so handles are not needed. One-shot items are not kept,
+// like in the snapshot.
+//
+// The time zone is not kept either. Like the location, it is part of the setup of the scheduler: set it with
+// CEventSchedulerBase::setTimeZone() before open(). A setSecondsFromGMT() that is replayed goes back to a fixed offset,
+// as it did when it was made.
+//
+// The journal is used from the thread of the scheduler, like the scheduler itself.
+class CEventSchedulerJournal {
+public:
+    CEventSchedulerJournal(int maximumCommitDelayMilliseconds = 10, size_t compactionThreshold = 1024 * 1024);
+    ~CEventSchedulerJournal();
+
+    CEventSchedulerJournal(const CEventSchedulerJournal &) = delete;
+    CEventSchedulerJournal &operator=(const CEventSchedulerJournal &) = delete;
+
+    // Recover the items into the scheduler (which should be empty, with the location of the items), and start
+    // journaling its edits. Returns -1 if the files can not be read or written.
+    int open(CEventSchedulerBase &scheduler, const char *path);
+
+    // Write everything that is still waiting, wait for a compaction that is running, and stop.
+    void close(void);
+
+    // The same as the functions of the scheduler, with a journal record for every change.
+    CEventSchedulerItemHandle addItem(const CEventSchedulerItem &item);
+    int removeItem(const CEventSchedulerItem &item);
+    int removeItem(CEventSchedulerItemHandle handle);
+    int updateItem(CEventSchedulerItemHandle handle, const CEventSchedulerItem &item);
+    int replaceAllItems(const CEventSchedulerItem *newItems, int numberOfNewItems, CEventSchedulerItemHandle *handles = nullptr);
+    void resetItems(void);
+    void setSecondsFromGMT(time_t secondsFromGMT);
+    void setRandomSeed(uint32_t seed);
+
+    // The records of a bulk update are only appended when it is committed.
+    int beginUpdate(void);
+    int commitUpdate(void);
+    void cancelUpdate(void);
+
+    // Wait until all records so far are on disk. Returns -1 if writing failed, the journal stops writing then.
+    int sync(void);
+
+    // Take a snapshot and start a new journal now, instead of when the journal has grown past compactionThreshold.
+    int compact(void);
+
+    size_t getJournalSize(void);
+
+private:
+    enum RecordType : uint8_t {
+        RecordType_AddItem = 1,
+        RecordType_RemoveItem,
+        RecordType_ResetItems,
+        RecordType_SetSecondsFromGMT,
+        RecordType_SetRandomSeed
+    };
+
+    static const size_t     recordSize = 16;
+
+    struct Record {
+        uint32_t            checksum;                   // CRC-32 of the rest of the record
+        uint8_t             type;
+        uint8_t             reserved;
+        uint16_t            slot;                       // Of the item that was added or removed
+        uint8_t             payload[8];                 // Packed item, int64_t secondsFromGMT or uint32_t seed
+    };
+
+    struct FileHeader {
+        char                magic[4];                   // "EVSJ"
+        uint16_t            version;
+        uint16_t            headerSize;
+        uint32_t            byteOrderMark;
+        uint32_t            generation;                 // One more than the journal that it follows
+        uint32_t            snapshotChecksum;           // The snapshot that it continues
+        uint32_t            checksum;                   // CRC-32 of the rest of the header
+    };
+
+    // An add during a bulk update, to find the item of its handle again.
+    struct PendingAdd {
+        CEventSchedulerItemHandle   handle;
+        CEventSchedulerItem         item;
+    };
+
+    const int               maximumCommitDelayMilliseconds;
+    const size_t            compactionThreshold;
+
+    CEventSchedulerBase     *scheduler = nullptr;
+    std::string             snapshotPath;
+    std::string             journalPath;
+    std::string             newJournalPath;
+
+    bool                    updateInProgress = false;
+    std::vector<Record>     updateRecords;
+    std::vector<PendingAdd> pendingAdds;
+
+    // Shared with the threads. Everything below is protected by mutex.
+    std::mutex              mutex;
+    std::condition_variable commitCondition;            // Records or a compaction are waiting, or stop
+    std::condition_variable committedCondition;         // Records were written, or writing failed
+
+    std::vector<Record>     pendingRecords;
+    uint64_t                numberOfAppendedRecords = 0;
+    uint64_t                numberOfCommittedRecords = 0;
+    size_t                  journalSize = 0;                // Written by the commit thread only
+    bool                    isFailed = false;
+    bool                    isStopping = false;
+    bool                    isSyncRequested = false;
+
+    // The compaction that was started: the records before the cut go to the old journal, the rest to a new one. The
+    // snapshot belongs to the compaction thread once it runs.
+    uint8_t                 *compactionSnapshot = nullptr;
+    size_t                  compactionSnapshotSize = 0;
+    uint32_t                compactionSnapshotChecksum = 0;
+    uint64_t                compactionCutRecord = 0;
+    bool                    isCompactionStarted = false;    // Waiting for the commit thread to switch journals
+    bool                    isCompactionRunning = false;    // Until the snapshot is written and the journals renamed
+
+    // Only used by the commit thread, or before it is started and after it has stopped.
+    int                     journalDescriptor = -1;
+    uint32_t                journalGeneration = 0;
+
+    std::thread             commitThread;
+    std::thread             compactionThread;
+
+    void appendItem(RecordType type, const CEventSchedulerItem &item, int slot);
+    void appendRecords(const Record *records, size_t numberOfRecords);
+    CEventSchedulerItem itemForHandle(CEventSchedulerItemHandle handle);
+    static Record makeRecord(RecordType type, const uint8_t *payload, size_t payloadSize, int slot = 0);
+    static bool isValidRecord(const Record &record);
+
+    void commitLoop(void);
+    int writeRecords(const Record *records, size_t numberOfRecords);
+    void compactionLoop(void);
+
+    int createJournal(const char *path, uint32_t generation, uint32_t snapshotChecksum);
+    static int readJournal(const char *path, FileHeader &header, std::vector<Record> &records);
+    static void replay(CEventSchedulerBase &scheduler, const std::vector<Record> &records);
+};
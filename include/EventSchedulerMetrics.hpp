@@ -0,0 +1,150 @@
+#pragma once
+
+#include <stdint.h>
+#include <atomic>
+#include <chrono>
+#include <string>
+
+// NOTES
+//
+// Counters and latency histograms of the schedulers. A CEventSchedulerMetrics is given to one or more schedulers with
+// CEventSchedulerBase::setMetrics(), and the schedulers count into it from whatever thread they run on. Everything is
+// a relaxed atomic, so recording is a few uncontended increments, and never takes a lock.
+//
+// The schedulers only record into the metrics when the library is built with EVENT_SCHEDULER_METRICS (the CMake
+// option of the same name). Without it, the call sites in the scheduler compile to nothing, and the metrics stay
+// empty.
+//
+// The histograms are log-linear, like HdrHistogram: every power of two of nanoseconds is split into 8 buckets, so a
+// recorded latency is off by at most 12.5%, from 1 ns up to the full range of uint64_t, in a fixed number of buckets.
+//
+// A snapshot copies all counters and histograms. It can reset them at the same time, e.g. to export the values of
+// every interval. The copy is not taken atomically as a whole, a latency that is recorded during the snapshot can be
+// in the histogram and not yet in the counters, or the other way round.
+
+enum CEventSchedulerCounter_Value {
+    CEventSchedulerCounter_Lookups = 0,             // Calls of getActiveAndNextItem() and getNextActivationTime()
+    CEventSchedulerCounter_ScheduleSorts,           // Full rebuilds of the compiled schedule
+    CEventSchedulerCounter_SolarCalculations,       // Sunrise/sunset of a day that was not known yet, also when the solar table cache has it
+    CEventSchedulerCounter_RandomDraws,             // Random offsets calculated for items
+
+    CEventSchedulerCounter_Count
+};
+
+enum CEventSchedulerLatency_Value {
+    CEventSchedulerLatency_AddItem = 0,
+    CEventSchedulerLatency_RemoveItem,
+    CEventSchedulerLatency_Lookup,                  // getActiveAndNextItem(), which all getActiveItem() variants use
+    CEventSchedulerLatency_Recalculation,           // recalculateAllActivationTimes()
+
+    CEventSchedulerLatency_Count
+};
+
+enum CEventSchedulerMetricsFormat_Value {
+    CEventSchedulerMetricsFormat_Prometheus = 0,    // Prometheus text exposition format
+    CEventSchedulerMetricsFormat_JSON
+};
+
+struct CEventSchedulerLatencySnapshot {
+    static const int        subBucketBits = 3;
+    static const int        subBucketCount = 1 << subBucketBits;
+    static const int        numberOfBuckets = (64 - subBucketBits + 1) * subBucketCount;
+
+    uint64_t                count;
+    uint64_t                sumNanoseconds;
+    uint64_t                maximumNanoseconds;
+    uint64_t                buckets[numberOfBuckets];
+
+    // The latency below which the given fraction (0.0 .. 1.0) of the recorded latencies are, as the upper bound of
+    // the bucket it is in. 0 if nothing was recorded.
+    uint64_t percentile(double fraction) const;
+
+    static int bucketForValue(uint64_t nanoseconds);
+    static uint64_t bucketLowerBound(int bucket);
+    static uint64_t bucketUpperBound(int bucket);
+};
+
+struct CEventSchedulerMetricsSnapshot {
+    uint64_t                        counters[CEventSchedulerCounter_Count];
+    CEventSchedulerLatencySnapshot  latencies[CEventSchedulerLatency_Count];
+
+    std::string toPrometheus(const char *prefix = "event_scheduler") const;
+    std::string toJSON(void) const;
+};
+
+class CEventSchedulerMetrics {
+public:
+    CEventSchedulerMetrics();
+
+    CEventSchedulerMetrics(const CEventSchedulerMetrics &) = delete;
+    CEventSchedulerMetrics &operator=(const CEventSchedulerMetrics &) = delete;
+
+    void increment(CEventSchedulerCounter_Value counter, uint64_t amount = 1) {
+        counters[counter].fetch_add(amount, std::memory_order_relaxed);
+    }
+
+    void recordLatency(CEventSchedulerLatency_Value latency, uint64_t nanoseconds);
+
+    void snapshot(CEventSchedulerMetricsSnapshot &snapshot, bool reset = false);
+    void reset(void);
+
+    // Write a snapshot to a file. The file is written next to it first, and then renamed, so that a reader (e.g. the
+    // textfile collector of the Prometheus node exporter) never sees half of it.
+    int exportToFile(const char *path, CEventSchedulerMetricsFormat_Value format, bool reset = false);
+
+    // Write a snapshot to a local (Unix domain) stream socket, e.g. of a metrics agent. Not available on all systems.
+    int exportToSocket(const char *socketPath, CEventSchedulerMetricsFormat_Value format, bool reset = false);
+
+    static const char *counterName(CEventSchedulerCounter_Value counter);
+    static const char *latencyName(CEventSchedulerLatency_Value latency);
+
+private:
+    struct Histogram {
+        std::atomic<uint64_t>   count;
+        std::atomic<uint64_t>   sumNanoseconds;
+        std::atomic<uint64_t>   maximumNanoseconds;
+        std::atomic<uint64_t>   buckets[CEventSchedulerLatencySnapshot::numberOfBuckets];
+    };
+
+    std::atomic<uint64_t>   counters[CEventSchedulerCounter_Count];
+    Histogram               latencies[CEventSchedulerLatency_Count];
+
+    std::string exportSnapshot(CEventSchedulerMetricsFormat_Value format, bool reset);
+};
+
+// Records the time between its construction and destruction, if there are metrics.
+class CEventSchedulerLatencyTimer {
+public:
+    CEventSchedulerLatencyTimer(CEventSchedulerMetrics *metrics, CEventSchedulerLatency_Value latency) :
+    metrics(metrics),
+    latency(latency) {
+        if (metrics != nullptr) {
+            start = std::chrono::steady_clock::now();
+        }
+    }
+
+    ~CEventSchedulerLatencyTimer() {
+        if (metrics != nullptr) {
+            metrics->recordLatency(latency, (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count());
+        }
+    }
+
+private:
+    CEventSchedulerMetrics                  *metrics;
+    CEventSchedulerLatency_Value            latency;
+    std::chrono::steady_clock::time_point   start;
+};
+
+// The call sites in the schedulers. One timer per scope.
+#ifdef EVENT_SCHEDULER_METRICS
+#define EVENT_SCHEDULER_METRICS_COUNT(metrics, counter) \
+    do { \
+        if ((metrics) != nullptr) { \
+            (metrics)->increment(counter); \
+        } \
+    } while (0)
+#define EVENT_SCHEDULER_METRICS_TIME(metrics, latency) CEventSchedulerLatencyTimer metricsLatencyTimer((metrics), (latency))
+#else
+#define EVENT_SCHEDULER_METRICS_COUNT(metrics, counter) do { } while (0)
+#define EVENT_SCHEDULER_METRICS_TIME(metrics, latency) do { } while (0)
+#endif
@@ -0,0 +1,123 @@
+#pragma once
+
+#include <time.h>
+#include <stdint.h>
+#include <random>
+
+#include "EventSchedulerItem.hpp"
+
+// NOTES
+//
+// A pool of many small schedulers ('tenants', e.g. one per device), that are looked up all at once. A CEventScheduler
+// per device carries its own sunrise calculator, random generator and item storage, which adds up to a lot of memory
+// for hundreds of thousands of devices, spread all over the heap. The pool keeps the same information in a few large
+// arrays instead:
+//
+//     Per tenant      first entry, number of entries, capacity, location (12 bytes)
+//     Per entry       minute of the week of the activation, item, in order of activation per tenant
+//     Per location    latitude, longitude, seconds from GMT, and the sunrise and sunset of every day of this week
+//
+// Tenants that are at the same location (to 0.01 degrees) and in the same time zone share the location, so the sunrise
+// and sunset are calculated once for all of them, with the batch calculation of CSunriseCalculator. There is one random
+// generator for the whole pool.
+//
+// evaluateAll() finds the active item of every tenant in one pass over these arrays. The minute of the week is
+// calculated once per location, and then each tenant is a binary search in its own entries, which are next to those of
+// the tenant before it. The pass can be split over a number of threads, each taking a range of tenants.
+//
+// The entries of a tenant are kept together. When a tenant runs out of room, its entries move to the end of the arrays
+// with twice the room, which leaves a gap. compact() closes the gaps, and puts the tenants back in order.
+//
+// The activation times are calculated for the week of the timeProvider, like CEventSchedulerBase does. The pool has no
+// one-shot items. It is not thread safe, except for evaluateAll() itself using threads.
+class CEventSchedulerPool {
+public:
+    CEventSchedulerPool(time_t (*timeProvider)(void), int initialNumberOfTenants = 64, int initialNumberOfEntries = 512);
+    ~CEventSchedulerPool();
+
+    CEventSchedulerPool(const CEventSchedulerPool &) = delete;
+    CEventSchedulerPool &operator=(const CEventSchedulerPool &) = delete;
+
+    // Returns the number of the new tenant, or -1 if there is no memory left.
+    int addTenant(double latitude, double longitude, time_t secondsFromGMT);
+    int getNumberOfTenants(void);
+
+    int addItem(int tenant, const CEventSchedulerItem &item);
+    int removeItem(int tenant, const CEventSchedulerItem &item);
+    int replaceAllItems(int tenant, const CEventSchedulerItem *newItems, int numberOfNewItems);
+    void resetItems(int tenant);
+
+    int getNumberOfItems(int tenant);
+    CEventSchedulerItem getItem(int tenant, int index);
+
+    CEventSchedulerItem getActiveItem(int tenant, time_t timestampGMT);
+
+    // Store the active item of every tenant in activeItems[tenant], which must have room for getNumberOfTenants()
+    // items. A tenant without items gets an invalid item.
+    void evaluateAll(time_t timestampGMT, CEventSchedulerItem *activeItems, int numberOfThreads = 1);
+
+    // New random offsets and sunrise/sunset times for all items, e.g. at the start of a new week.
+    void recalculateAllActivationTimes(void);
+
+    void compact(void);
+
+    int getNumberOfLocations(void);
+    size_t getMemoryUsage(void);
+
+private:
+    static const int        minutesInDay = 60 * 24;
+    static const int        secondsInDay = 60 * minutesInDay;
+    static const int        daysInWeek = 7;
+    static const int        maximumEntriesPerTenant = 0xffff;
+
+    struct Location {
+        double              latitude;
+        double              longitude;
+        time_t              secondsFromGMT;
+        time_t              beginningOfWeekGMT;     // The week that sunRises and sunSets are for
+        time_t              sunRises[daysInWeek];
+        time_t              sunSets[daysInWeek];
+    };
+
+    // Tenants
+    int                     numberOfTenants = 0;
+    int                     tenantCapacity = 0;
+    int32_t                 *tenantFirstEntries = nullptr;
+    uint16_t                *tenantNumberOfEntries = nullptr;
+    uint16_t                *tenantEntryCapacities = nullptr;
+    uint32_t                *tenantLocations = nullptr;
+
+    // Entries, in ranges per tenant
+    int                     numberOfEntries = 0;    // In use, including the gaps
+    int                     entryCapacity = 0;
+    uint16_t                *minutesOfWeek = nullptr;
+    CEventSchedulerItem     *items = nullptr;
+
+    // Locations, with a hash index on (latitude, longitude, secondsFromGMT)
+    int                     numberOfLocations = 0;
+    int                     locationCapacity = 0;
+    Location                *locations = nullptr;
+    uint32_t                *locationIndex = nullptr;  // Location + 1, 0 for an empty position
+    int                     locationIndexSize = 0;
+    uint16_t                *locationMinutesOfWeek = nullptr;  // Scratch space for evaluateAll()
+
+    std::mt19937            randomGenerator;
+    time_t                  (*timeProvider)(void);
+
+    int findOrAddLocation(double latitude, double longitude, time_t secondsFromGMT);
+    bool rebuildLocationIndex(int newSize);
+    static uint32_t hashLocation(int32_t latitudeKey, int32_t longitudeKey, time_t secondsFromGMT);
+    static int32_t quantize(double degrees);
+
+    bool reserveEntries(int tenant, int numberOfEntriesNeeded);
+    bool growEntries(int minimumCapacity);
+
+    void calculateSolarDays(int firstLocation, int lastLocation, time_t timestampGMT);
+    void recalculateActivationTime(CEventSchedulerItem &item, const Location &location);
+    void sortTenant(int tenant);
+
+    time_t calculateBeginningOfWeek(time_t timestampGMT, time_t secondsFromGMT);
+    uint16_t calculateMinuteOfWeek(const CEventSchedulerItem &item);
+    int findActiveEntry(int tenant, uint16_t minuteOfWeek);
+    void evaluateTenants(int firstTenant, int lastTenant, CEventSchedulerItem *activeItems);
+};
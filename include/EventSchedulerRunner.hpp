@@ -0,0 +1,67 @@
+#pragma once
+
+#include <time.h>
+#include <stdint.h>
+#include <atomic>
+#include <mutex>
+#include <thread>
+
+#include "EventScheduler.hpp"
+#include "EventSchedulerWaiter.hpp"
+
+// Called by the runner when an item activates, and when the active item changes because the items, the offset from
+// GMT or the clock changed. Also called once when the runner starts, with the item that is active at that moment.
+typedef void (*CEventSchedulerTransitionCallback)(CEventSchedulerBase &scheduler, const CEventSchedulerItem &activeItem, const CEventSchedulerItem &nextActiveItem, time_t timestampGMT, void *context);
+
+// NOTES
+//
+// The runner replaces a polling loop around getActiveItem(). It asks the scheduler for the time of the next activation
+// and sleeps until exactly then, so it wakes up about as often as there are events, and fires on time.
+//
+// The runner sleeps on the system clock (see EventSchedulerWaiter.hpp), so the scheduler must use the real time
+// (time(nullptr)) as its timeProvider.
+//
+// The runner installs itself as the change listener of the scheduler, so it wakes up early when items are added,
+// updated or removed, or the offset from GMT changes.
+//
+// The scheduler itself is not thread safe. When the runner runs on its own thread (start()), changes to the scheduler
+// must be made while holding getSchedulerMutex(). The callback is called with the mutex held, so it can change the
+// scheduler directly, but must not lock the mutex itself.
+class CEventSchedulerRunner {
+public:
+    CEventSchedulerRunner(CEventSchedulerBase &scheduler, CEventSchedulerTransitionCallback callback, void *context = nullptr);
+    ~CEventSchedulerRunner();
+
+    CEventSchedulerRunner(const CEventSchedulerRunner &) = delete;
+    CEventSchedulerRunner &operator=(const CEventSchedulerRunner &) = delete;
+
+    // Run on the calling thread, until stop() is called (e.g. from the callback).
+    int run(void);
+
+    // Run on a thread of its own.
+    int start(void);
+    void stop(void);
+
+    // Look at the scheduler again now, e.g. after changing the scheduler without a change notification.
+    void wakeUp(void);
+
+    std::mutex &getSchedulerMutex(void);
+
+    uint32_t getNumberOfWakeUps(void);
+
+private:
+    CEventSchedulerBase     &scheduler;
+    CEventSchedulerTransitionCallback callback;
+    void                    *context;
+
+    std::mutex              schedulerMutex;
+    std::thread             thread;
+    std::atomic<bool>       running;
+    std::atomic<uint32_t>   numberOfWakeUps;
+
+    CEventSchedulerWaiter   waiter;
+
+    void runLoop(void);
+
+    static void schedulerChanged(CEventSchedulerBase &scheduler, void *context);
+};
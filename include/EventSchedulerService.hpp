@@ -0,0 +1,167 @@
+#pragma once
+
+#include <time.h>
+#include <stdint.h>
+#include <atomic>
+#include <future>
+#include <memory>
+#include <thread>
+#include <utility>
+
+#include "EventScheduler.hpp"
+#include "EventSchedulerCoordinator.hpp"
+#include "EventSchedulerWaiter.hpp"
+
+// Called on the thread of the shard that the scheduler lives on, when its active item changes or activates.
+typedef void (*CEventSchedulerServiceCallback)(int schedulerId, const CEventSchedulerItem &activeItem, const CEventSchedulerItem &nextActiveItem, time_t timestampGMT, void *context);
+
+// NOTES
+//
+// The service runs many schedulers on a number of threads ('shards'), each pinned to a core of its own. Every
+// scheduler lives on one shard, and is only ever touched by that shard's thread, so the schedulers need no locks.
+// Each shard has a CEventSchedulerCoordinator for its schedulers, and sleeps until the first activation of its
+// schedulers, or until a command arrives.
+//
+// Everything that is done with a scheduler is a command that is sent to its shard, through a lock-free queue that
+// many threads can write to, and only the shard reads from (the intrusive MPSC queue of Dmitry Vyukov: a producer
+// does one atomic exchange, the shard never waits for a producer). A producer only wakes up the shard if it was going
+// to sleep. The result comes back through a std::future.
+//
+// New schedulers are spread over the shards in turn. The id of a scheduler tells on which shard it lives. The id of a
+// destroyed scheduler is given to a new scheduler on the same shard later, so it must not be used anymore.
+//
+// Commands that are sent before start() are handled when the shards start. Commands that are still in the queue when
+// the service stops are handled by the destructor, so every future gets its value.
+class CEventSchedulerService {
+private:
+    class Shard;
+
+public:
+    // The schedulers of the service. They start small, and grow when more items are added.
+    typedef CEventSchedulerT<8, CEventSchedulerGrowableStorage> CEventSchedulerServiceSchedulerBase;
+
+    CEventSchedulerService(int numberOfShards, CEventSchedulerServiceCallback callback, void *context = nullptr, bool pinThreads = true);
+    ~CEventSchedulerService();
+
+    CEventSchedulerService(const CEventSchedulerService &) = delete;
+    CEventSchedulerService &operator=(const CEventSchedulerService &) = delete;
+
+    int start(void);
+    void stop(void);
+
+    int getNumberOfShards(void);
+
+    // The id of the new scheduler, or -1 if there is no memory left.
+    std::future<int> createScheduler(double latitude, double longitude, time_t secondsFromGMT);
+    std::future<int> destroyScheduler(int schedulerId);
+
+    std::future<CEventSchedulerItemHandle> addItem(int schedulerId, const CEventSchedulerItem &item);
+    std::future<int> removeItem(int schedulerId, CEventSchedulerItemHandle handle);
+    std::future<int> replaceAllItems(int schedulerId, const CEventSchedulerItem *newItems, int numberOfNewItems);
+    std::future<CEventSchedulerItem> getActiveItem(int schedulerId);
+
+    // Call function(scheduler) on the thread of the scheduler's shard, and return what it returns through the future.
+    // The function gets nullptr if the scheduler does not exist. It must return a value.
+    template <typename Function>
+    auto call(int schedulerId, Function function) -> std::future<decltype(function(static_cast<CEventSchedulerBase *>(nullptr)))>;
+
+private:
+    struct Command {
+        std::atomic<Command *>  next;
+        virtual ~Command() {}
+        virtual void execute(Shard &shard) = 0;
+    };
+
+    template <typename Function>
+    struct FunctionCommand : Command {
+        Function function;
+        FunctionCommand(Function &&function) : function(std::move(function)) {}
+        void execute(Shard &shard) override { function(shard); }
+    };
+
+    // Vyukov's intrusive MPSC queue. push() can be called from any thread, pop() only from the shard.
+    class CommandQueue {
+    public:
+        CommandQueue();
+        void push(Command *command);
+        Command *pop(void);
+        bool isEmpty(void);
+
+    private:
+        struct Stub : Command {
+            void execute(Shard & /* shard */) override {}
+        };
+
+        std::atomic<Command *>  head;
+        Command                 *tail;
+        Stub                    stub;
+    };
+
+    struct ServiceScheduler : CEventSchedulerServiceSchedulerBase {
+        int schedulerId;
+        ServiceScheduler(double latitude, double longitude, time_t secondsFromGMT);
+    };
+
+    class Shard {
+    public:
+        Shard(CEventSchedulerService &service, int index);
+        ~Shard();
+
+        CEventSchedulerBase *findScheduler(int schedulerId);
+        int createScheduler(double latitude, double longitude, time_t secondsFromGMT);
+        int destroyScheduler(int schedulerId);
+
+        CEventSchedulerService  &service;
+        int                     index;
+        std::thread             thread;
+        std::atomic<bool>       running;
+        std::atomic<bool>       sleeping;
+        CommandQueue            commands;
+        CEventSchedulerWaiter   waiter;
+        CEventSchedulerCoordinator coordinator;
+
+        ServiceScheduler        **schedulers = nullptr;     // By coordinator id
+        int                     schedulerCapacity = 0;
+
+        void run(void);
+        void executeCommands(void);
+    };
+
+    Shard                   **shards;
+    int                     numberOfShards;
+    std::atomic<uint32_t>   nextShard;
+    bool                    pinThreads;
+
+    CEventSchedulerServiceCallback callback;
+    void                    *context;
+
+    void pushCommand(int shard, Command *command);
+    int shardForScheduler(int schedulerId);
+
+    template <typename Function>
+    void post(int shard, Function &&function) {
+        pushCommand(shard, new FunctionCommand<typename std::decay<Function>::type>(std::forward<Function>(function)));
+    }
+
+    static void schedulerTransition(CEventSchedulerBase &scheduler, const CEventSchedulerItem &activeItem, const CEventSchedulerItem &nextActiveItem, time_t timestampGMT, void *context);
+};
+
+template <typename Function>
+auto CEventSchedulerService::call(int schedulerId, Function function) -> std::future<decltype(function(static_cast<CEventSchedulerBase *>(nullptr)))> {
+    typedef decltype(function(static_cast<CEventSchedulerBase *>(nullptr))) Result;
+
+    std::promise<Result> promise;
+    std::future<Result> future = promise.get_future();
+
+    int shard = shardForScheduler(schedulerId);
+    if (shard < 0) {
+        promise.set_value(function(nullptr));
+        return future;
+    }
+
+    post(shard, [promise = std::move(promise), function, schedulerId](Shard &owner) mutable {
+        promise.set_value(function(owner.findScheduler(schedulerId)));
+    });
+
+    return future;
+}
@@ -0,0 +1,128 @@
+#pragma once
+
+#include <time.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "EventScheduler.hpp"
+
+// NOTES
+//
+// A binary snapshot of many schedulers, to start up fast. Rebuilding the schedulers from their items sorts them and
+// calculates the sunrise and sunset again for every scheduler. A snapshot holds the items with their activation
+// times already calculated, in the order of the compiled schedule, so restoring a scheduler from it is a copy.
+//
+// The file is mapped into memory (mmap) instead of read. The file can answer getActiveItem() and
+// getNextActivationTime() for every scheduler in it right away, straight from the mapped pages. There is no need to
+// create the schedulers first. restore() fills a real scheduler, when it is needed, e.g. to change its items.
+//
+// Layout (all numbers in the byte order of the machine that wrote it, which is checked when opening):
+//
+//     FileHeader                                  magic, version, byte order mark, number of schedulers, size, CRC-32
+//     SchedulerRecord[numberOfSchedulers]         location, secondsFromGMT, random seed, week, where the items are
+//     per scheduler, 8-byte aligned:
+//         uint16_t minutesOfWeek[numberOfItems]   sorted, the keys of the compiled schedule
+//         uint16_t slots[numberOfItems]           the slot each item was in, see restore()
+//         uint8_t  items[numberOfItems][6]        the 48 bits of CEventSchedulerItem, packed
+//
+// The CRC-32 covers everything after the header, and is checked by open(). One-shot items are not part of the
+// snapshot, they are about a moment that has usually passed by the next start.
+//
+// The activation times are those of the week the file was written in. The lookups on the file repeat that week, the
+// random offsets, sunrise and sunset of other weeks are not in it. A restored scheduler compiles the week it is asked
+// about, see CEventSchedulerBase.
+//
+// A time zone (see CEventSchedulerBase::setTimeZone()) is not part of the snapshot either. The file keeps the offset
+// of the time zone at the time it was written, set the time zone again after restore().
+class CEventSchedulerSnapshotFile {
+public:
+    // 2: the random seed is the key of the counter-based random offsets, not the seed of a Mersenne Twister, and
+    //    there is no count of random draws anymore. Files of version 1 would restore with other random offsets.
+    //    The reserved field of the scheduler record holds the week of the activation times.
+    static const uint16_t   currentVersion = 2;
+    static const size_t     packedItemSize = 6;
+
+    CEventSchedulerSnapshotFile();
+    ~CEventSchedulerSnapshotFile();
+
+    CEventSchedulerSnapshotFile(const CEventSchedulerSnapshotFile &) = delete;
+    CEventSchedulerSnapshotFile &operator=(const CEventSchedulerSnapshotFile &) = delete;
+
+    // Write the schedulers to a file. The file is written next to it first, and then renamed, so a crash never leaves
+    // half a snapshot. Schedulers with an update in progress can not be written.
+    static int write(const char *path, CEventSchedulerBase *const *schedulers, int numberOfSchedulers);
+
+    // The two halves of write(): encode() makes the file in memory (malloc, free() it when done), writeEncoded() writes
+    // it and waits until it is on disk. The schedulers are only needed for encode(), so writeEncoded() can be done on
+    // another thread, e.g. by CEventSchedulerJournal.
+    static int encode(CEventSchedulerBase *const *schedulers, int numberOfSchedulers, uint8_t *&buffer, size_t &size, uint32_t &checksum);
+    static int writeEncoded(const char *path, const uint8_t *buffer, size_t size);
+
+    // Map the file, and check its header and checksum. Returns -1 if it can not be used.
+    int open(const char *path);
+    void close(void);
+    bool isOpen(void);
+
+    int getNumberOfSchedulers(void);
+    uint32_t getChecksum(void);
+    int getNumberOfItems(int schedulerIndex);
+    double getLatitude(int schedulerIndex);
+    double getLongitude(int schedulerIndex);
+    time_t getSecondsFromGMT(int schedulerIndex);
+
+    // Straight from the file, like CEventSchedulerBase::getActiveAndNextItem().
+    CEventSchedulerItem getActiveItem(int schedulerIndex, time_t timestampGMT);
+    int getActiveAndNextItem(int schedulerIndex, time_t timestampGMT, CEventSchedulerItem &activeItem, CEventSchedulerItem &nextActiveItem);
+    time_t getNextActivationTime(int schedulerIndex, time_t timestampGMT);
+
+    // Replace the items of the scheduler with the ones in the file. The scheduler must have been created with the
+    // location of the snapshot (getLatitude(), getLongitude()), as the location can not be changed afterwards.
+    // The items go back into the slots they were in, and the random seed is restored, so the restored scheduler
+    // calculates the same random offsets as the saved one would have. Handles of before the snapshot are not valid
+    // anymore.
+    int restore(int schedulerIndex, CEventSchedulerBase &scheduler);
+
+    static void packItem(const CEventSchedulerItem &item, uint8_t *packed);
+    static CEventSchedulerItem unpackItem(const uint8_t *packed);
+
+    static uint32_t crc32(const void *data, size_t size, uint32_t crc = 0);
+    static int syncDirectory(const char *path);
+
+private:
+    static const uint32_t   byteOrderMark = 0x01020304;
+
+    struct FileHeader {
+        char                magic[4];               // "EVSS"
+        uint16_t            version;
+        uint16_t            headerSize;
+        uint32_t            byteOrderMark;
+        uint32_t            numberOfSchedulers;
+        uint64_t            fileSize;
+        uint32_t            checksum;               // CRC-32 of everything after the header
+        uint32_t            reserved;
+    };
+
+    struct SchedulerRecord {
+        double              latitude;
+        double              longitude;
+        int64_t             secondsFromGMT;
+        uint64_t            itemsOffset;            // From the start of the file
+        uint32_t            numberOfItems;
+        uint32_t            randomSeed;
+        int64_t             localBeginningOfWeek;   // The week of the activation times, in local time
+    };
+
+    const uint8_t           *data = nullptr;
+    size_t                  size = 0;
+    const FileHeader        *header = nullptr;
+    const SchedulerRecord   *records = nullptr;
+
+    const SchedulerRecord *record(int schedulerIndex);
+    const uint16_t *minutesOfWeek(const SchedulerRecord &schedulerRecord);
+    const uint16_t *slots(const SchedulerRecord &schedulerRecord);
+    const uint8_t *packedItems(const SchedulerRecord &schedulerRecord);
+    int findEntry(const SchedulerRecord &schedulerRecord, time_t timestampGMT, time_t &beginningOfWeek);
+    bool isValid(void);
+
+    static size_t itemBlockSize(uint32_t numberOfItems);
+};
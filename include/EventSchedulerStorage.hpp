@@ -0,0 +1,131 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "EventSchedulerItem.hpp"
+
+// A compiled schedule entry. The compiled schedule holds one entry per stored item, sorted by activation time, with
+// the activation moment flattened into minutes from the beginning of the week (Sunday 00:00). Looking up the active
+// item is then a binary search over a small array of 16-bit keys, instead of walking the items. The items themselves
+// are stored unordered.
+struct CEventSchedulerScheduleEntry {
+    uint16_t minuteOfWeek;      // (activeWeekDay - 1) * minutesInDay + activeTimeOffset, 0..10079
+    uint16_t itemIndex;         // Index of the item in the items array
+};
+
+enum CEventSchedulerSlotState: uint8_t {
+    CEventSchedulerSlotState_Free = 0,
+    CEventSchedulerSlotState_Stored,                    // Part of the schedule
+    CEventSchedulerSlotState_PendingAdd,                // Added during an update, becomes part of the schedule on commit
+    CEventSchedulerSlotState_PendingRemoval             // Removed during an update, stays part of the schedule until commit
+};
+
+// NOTES
+//
+// The scheduler does not own its item storage, a storage policy does. The scheduler only sees the arrays through
+// a CEventSchedulerStorage, which is filled in by the policy. There are three policies:
+//
+//     CEventSchedulerInlineStorage<Capacity>   All arrays inside the scheduler object, sized at compile time. No heap.
+//     CEventSchedulerGrowableStorage           Arrays in one heap (or arena/pool) block, doubled when the scheduler is full.
+//     CEventSchedulerExternalStorage           Arrays in a buffer that is provided (and owned) by the caller.
+//
+// Per item slot, the storage takes sizeof(CEventSchedulerItem) + 9 bytes, plus 2 or 4 bytes for the content index.
+// The slot number is stored in 16 bits, so the capacity is limited to 65535 items.
+
+struct CEventSchedulerStorage {
+    CEventSchedulerItem             *items;
+    CEventSchedulerScheduleEntry    *schedule;
+    uint16_t                        *slotGenerations;
+    uint16_t                        *freeSlots;
+    uint16_t                        *contentIndex;
+    CEventSchedulerSlotState        *slotStates;
+    int                             capacity;
+    int                             contentIndexSize;
+
+    static const int maximumCapacity = 0xffff;
+
+    // The content index is a hash table, its size must be a power of two, and at least 1.5 times the capacity.
+    static constexpr int contentIndexSizeForCapacity(int capacity) {
+        int size = 2;
+        while (size < capacity + capacity / 2) {
+            size *= 2;
+        }
+        return size;
+    }
+
+    static size_t requiredBufferSize(int capacity);
+    static int capacityForBufferSize(size_t bufferSize);
+
+    void layoutInBuffer(void *buffer, int capacity);
+    void copyItemsFrom(const CEventSchedulerStorage &other);
+};
+
+template <int Capacity>
+class CEventSchedulerInlineStorage {
+    static_assert(Capacity > 0 && Capacity <= CEventSchedulerStorage::maximumCapacity, "Capacity must be 1..65535");
+
+    static const int contentIndexSize = CEventSchedulerStorage::contentIndexSizeForCapacity(Capacity);
+
+    CEventSchedulerItem             items[Capacity];
+    CEventSchedulerScheduleEntry    schedule[Capacity];
+    uint16_t                        slotGenerations[Capacity];
+    uint16_t                        freeSlots[Capacity];
+    uint16_t                        contentIndex[contentIndexSize];
+    CEventSchedulerSlotState        slotStates[Capacity];
+
+public:
+    explicit CEventSchedulerInlineStorage(int /* capacity */ = Capacity) {}
+
+    CEventSchedulerStorage storageView(void) {
+        CEventSchedulerStorage storage;
+        storage.items = items;
+        storage.schedule = schedule;
+        storage.slotGenerations = slotGenerations;
+        storage.freeSlots = freeSlots;
+        storage.contentIndex = contentIndex;
+        storage.slotStates = slotStates;
+        storage.capacity = Capacity;
+        storage.contentIndexSize = contentIndexSize;
+        return storage;
+    }
+
+    bool resizeStorage(CEventSchedulerStorage & /* storage */, int /* newCapacity */) {
+        return false;   // Fixed at compile time
+    }
+};
+
+class CEventSchedulerGrowableStorage {
+public:
+    // The allocation functions can be replaced by ones that take memory from an arena or pool.
+    explicit CEventSchedulerGrowableStorage(int initialCapacity, void *(*allocate)(size_t) = malloc, void (*release)(void *) = free);
+    ~CEventSchedulerGrowableStorage();
+
+    CEventSchedulerGrowableStorage(const CEventSchedulerGrowableStorage &) = delete;
+    CEventSchedulerGrowableStorage &operator=(const CEventSchedulerGrowableStorage &) = delete;
+
+    CEventSchedulerStorage storageView(void);
+    bool resizeStorage(CEventSchedulerStorage &storage, int newCapacity);
+
+private:
+    void                    *buffer;
+    CEventSchedulerStorage  storage;
+
+    void                    *(*allocate)(size_t);
+    void                    (*release)(void *);
+};
+
+class CEventSchedulerExternalStorage {
+public:
+    // The buffer must stay valid for the lifetime of the scheduler, and be aligned for CEventSchedulerItem. Use
+    // CEventSchedulerStorage::requiredBufferSize() to find out how large it must be for a given capacity.
+    CEventSchedulerExternalStorage(void *buffer, size_t bufferSize);
+
+    CEventSchedulerStorage storageView(void);
+    bool resizeStorage(CEventSchedulerStorage &storage, int newCapacity);
+
+private:
+    void                    *buffer;
+    size_t                  bufferSize;
+};
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <time.h>
+#include <stdint.h>
+
+// A time zone with daylight saving time, compiled from a POSIX TZ string, e.g. "CET-1CEST,M3.5.0,M10.5.0/3" (see
+// 'man tzset'), or from the name of one of a few bundled zones, e.g. "Europe/Amsterdam", see rulesForZone(). The rules
+// are turned into a table of spans with the same offset from GMT, one per transition, for the years firstYear up to
+// and including lastYear. Before and after those years, the offset of the first and last span holds. A lookup is a
+// binary search in the table, and the caller can keep the span of the last lookup, so that the next lookups are O(1)
+// until the next transition.
+//
+// Local time, as the scheduler sees it, never goes back:
+//
+// - A local time in the hour that is skipped when the clock moves forward (e.g. 02:30 on the last Sunday of March in
+//   Europe) happens at the moment of the transition.
+// - A local time in the hour that is repeated when the clock moves back happens the first time. During the repeated
+//   hour, the local time stays at the last second before the transition, so items in that hour do not activate again.
+//
+// After setRules(), a time zone does not change, so it can be shared by any number of schedulers, on any threads.
+// See CEventSchedulerBase::setTimeZone().
+
+// A part of the time line with one offset from GMT, from fromGMT up to (not including) untilGMT. The local time in it
+// is timestampGMT + secondsFromGMT, but at least minimumLocalTime.
+struct CEventSchedulerTimeZoneSpan {
+    time_t  fromGMT = 0;
+    time_t  untilGMT = 0;
+    time_t  secondsFromGMT = 0;
+    time_t  minimumLocalTime = 0;
+};
+
+class CEventSchedulerTimeZone {
+public:
+    static const int        firstYear = 1970;
+    static const int        lastYear = 2099;
+
+    // A fixed offset, without daylight saving time.
+    CEventSchedulerTimeZone(time_t secondsFromGMT = 0);
+
+    // A POSIX TZ string, or the name of a bundled zone. Returns -1, and keeps the previous rules, if it can not be
+    // parsed. Without rules for the start and end of daylight saving time, the rules of the United States are used,
+    // as POSIX does.
+    int setRules(const char *rules);
+
+    bool hasDaylightSavingTime(void) const;
+    int getNumberOfTransitions(void) const;
+
+    time_t getSecondsFromGMT(time_t timestampGMT) const;
+
+    time_t localTimeForGMT(time_t timestampGMT) const;
+    time_t gmtForLocalTime(time_t localTime) const;
+
+    void getSpan(time_t timestampGMT, CEventSchedulerTimeZoneSpan &span) const;
+
+    // The POSIX TZ string of a bundled zone, or nullptr if it is not bundled. Only the current rules are bundled, so
+    // times before the last change of the rules of a zone can be off.
+    static const char *rulesForZone(const char *name);
+
+private:
+    static const int        maximumNumberOfSpans = 1 + 2 * (lastYear - firstYear + 1);
+
+    // The day of a transition, in one of the three forms of POSIX, and the local time of day.
+    struct Rule {
+        enum Form { Julian, ZeroBasedJulian, MonthWeekDay };
+
+        Form        form;
+        int         day;            // Julian: 1..365, ZeroBasedJulian: 0..365, MonthWeekDay: 0 (Sunday) .. 6
+        int         week;           // MonthWeekDay: 1..5, 5 is the last one
+        int         month;          // MonthWeekDay: 1..12
+        int32_t     time;           // Seconds, -167..167 hours
+    };
+
+    // The spans are sorted by fromGMT, untilGMT is the fromGMT of the next one.
+    CEventSchedulerTimeZoneSpan spans[maximumNumberOfSpans];
+    int                     numberOfSpans = 0;
+
+    int findSpan(time_t timestampGMT) const;
+    void compile(time_t standardSecondsFromGMT, time_t daylightSecondsFromGMT, const Rule &start, const Rule &end);
+
+    static bool parseName(const char *&position);
+    static bool parseTime(const char *&position, int maximumHours, int32_t &seconds);
+    static bool parseRule(const char *&position, Rule &rule);
+    static time_t daysSinceEpochForRule(int year, const Rule &rule);
+    static time_t daysFromCivil(int year, int month, int day);
+};
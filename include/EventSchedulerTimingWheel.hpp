@@ -0,0 +1,95 @@
+#pragma once
+
+#include <time.h>
+#include <stdint.h>
+#include <stddef.h>
+
+#include "EventSchedulerItem.hpp"
+
+// Handle to a timer in a CEventSchedulerTimingWheel. Negative values are invalid handles.
+typedef int32_t CEventSchedulerTimerHandle;
+
+// NOTES
+//
+// A hierarchical timing wheel, for one-shot timers at an absolute time (in seconds, GMT). There are 4 levels of 64
+// buckets. A timer is put in the level of the highest 6 bit group in which its expiry time differs from the current
+// time of the wheel, and in the bucket given by that group of its expiry time. So level 0 holds the timers of the
+// coming minute (to the second), level 1 those of the coming hour, level 2 of the coming 3 days, and level 3 of the
+// coming 194 days. Timers further away than that are kept in an overflow list, that is looked at every 194 days.
+//
+// Adding and cancelling a timer is O(1): the timers are nodes in intrusive doubly linked lists. When the time moves
+// on, a bucket of a higher level is only emptied into the lower levels when the time reaches it, so a timer moves at
+// most 4 times before it expires, which makes expiring amortized O(1). The wheel jumps from bucket to bucket, so
+// advancing over a long time without timers costs nothing.
+//
+// The nodes come from a pool, that doubles in size when it is full. Handles have a generation, like the item
+// handles of the scheduler, so a handle of an expired or cancelled timer never refers to a new timer.
+
+typedef void (*CEventSchedulerTimerCallback)(CEventSchedulerTimerHandle handle, time_t expiryTimeGMT, const CEventSchedulerItem &item, void *context);
+
+class CEventSchedulerTimingWheel {
+public:
+    CEventSchedulerTimingWheel(time_t currentTimeGMT, int initialCapacity = 64);
+    ~CEventSchedulerTimingWheel();
+
+    CEventSchedulerTimingWheel(const CEventSchedulerTimingWheel &) = delete;
+    CEventSchedulerTimingWheel &operator=(const CEventSchedulerTimingWheel &) = delete;
+
+    // Add a timer. A timer with an expiry time that is not after the current time of the wheel expires on the next
+    // advance(). Returns -1 if there is no memory left.
+    CEventSchedulerTimerHandle add(time_t expiryTimeGMT, const CEventSchedulerItem &item);
+    int cancel(CEventSchedulerTimerHandle handle);
+
+    // Move the time of the wheel forward to the given time, and call the callback for every timer that expires, in
+    // order of expiry time. The time of the wheel never moves back.
+    void advance(time_t timestampGMT, CEventSchedulerTimerCallback callback, void *context);
+
+    // The expiry time of the first timer that will expire, and its item. Returns -1 if there are no timers.
+    time_t getNextExpiryTime(CEventSchedulerItem *item = nullptr);
+
+    time_t getCurrentTime(void);
+    int getNumberOfTimers(void);
+
+private:
+    static const int        bitsPerLevel = 6;
+    static const int        bucketsPerLevel = 1 << bitsPerLevel;
+    static const int        numberOfLevels = 4;
+    static const int        overflowList = numberOfLevels * bucketsPerLevel;
+    static const int        expiredList = overflowList + 1;
+    static const int        numberOfLists = expiredList + 1;
+    static const uint32_t   noNode = 0xffffffff;
+    static const int        maximumCapacity = 1 << 24;
+    static const int        maximumGeneration = 0x7f;
+
+    struct Node {
+        time_t              expiryTimeGMT;
+        CEventSchedulerItem item;
+        uint32_t            next;           // Next free node, when the node is not in use
+        uint32_t            previous;
+        uint16_t            list;           // The list the node is in, numberOfLists when not in use
+        uint8_t             generation;
+    };
+
+    Node                    *nodes;
+    int                     capacity;
+    uint32_t                firstFreeNode;
+    int                     numberOfTimers = 0;
+
+    uint32_t                listHeads[numberOfLists];
+    uint32_t                expiredTail;
+    uint64_t                occupiedBuckets[numberOfLevels];   // Bit per bucket that is not empty
+
+    time_t                  currentTime;
+
+    bool grow(void);
+    void insert(uint32_t index);
+    void link(uint32_t index, int list);
+    void linkExpired(uint32_t index);
+    void unlink(uint32_t index);
+    void releaseNode(uint32_t index);
+    void moveTo(time_t timestampGMT);
+    void cascade(int list);
+    bool findFirstBucket(int &level, int &bucket);
+    time_t bucketStartTime(int level, int bucket);
+    int indexForHandle(CEventSchedulerTimerHandle handle);
+};
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <stdarg.h>
+
+// NOTES
+//
+// Tracing for the library. The level is chosen at compile time with EVENT_SCHEDULER_TRACE_LEVEL (see
+// CMakeLists.txt), and a trace call site above that level compiles to nothing: its arguments are still checked by the
+// compiler, but never evaluated. The default level is CEventSchedulerTraceLevel_Off, so the hot paths (lookups,
+// recalculating activation times) cost nothing in a normal build.
+//
+// The messages go to a sink, which writes them to stderr unless another one is set with setSink(). The message is
+// formatted like printf(). Set the sink before the schedulers are used, it is not changed atomically.
+//
+//     EVENT_SCHEDULER_TRACE_DEBUG("beginningOfThisWeek: %lld", (long long)beginningOfThisWeek);
+
+enum CEventSchedulerTraceLevel_Value {
+    CEventSchedulerTraceLevel_Off = 0,
+    CEventSchedulerTraceLevel_Error,
+    CEventSchedulerTraceLevel_Warning,
+    CEventSchedulerTraceLevel_Info,
+    CEventSchedulerTraceLevel_Debug,
+    CEventSchedulerTraceLevel_Verbose
+};
+
+#ifndef EVENT_SCHEDULER_TRACE_LEVEL
+#define EVENT_SCHEDULER_TRACE_LEVEL 0
+#endif
+
+// Gets the formatted message, without a trailing newline.
+typedef void (*CEventSchedulerTraceSink)(CEventSchedulerTraceLevel_Value level, const char *file, int line, const char *message, void *context);
+
+class CEventSchedulerTrace {
+public:
+    // Pass nullptr to drop all messages.
+    static void setSink(CEventSchedulerTraceSink sink, void *context = nullptr);
+
+    static void write(CEventSchedulerTraceLevel_Value level, const char *file, int line, const char *format, ...)
+#if defined(__GNUC__)
+    __attribute__((format(printf, 4, 5)))
+#endif
+    ;
+
+    static const char *levelAsString(CEventSchedulerTraceLevel_Value level);
+
+private:
+    static CEventSchedulerTraceSink sink;
+    static void                     *sinkContext;
+
+    static void writeToStandardError(CEventSchedulerTraceLevel_Value level, const char *file, int line, const char *message, void *context);
+};
+
+#define EVENT_SCHEDULER_TRACE(level, ...) \
+    do { \
+        if constexpr ((level) <= EVENT_SCHEDULER_TRACE_LEVEL) { \
+            CEventSchedulerTrace::write((level), __FILE__, __LINE__, __VA_ARGS__); \
+        } \
+    } while (0)
+
+#define EVENT_SCHEDULER_TRACE_ERROR(...)    EVENT_SCHEDULER_TRACE(CEventSchedulerTraceLevel_Error, __VA_ARGS__)
+#define EVENT_SCHEDULER_TRACE_WARNING(...)  EVENT_SCHEDULER_TRACE(CEventSchedulerTraceLevel_Warning, __VA_ARGS__)
+#define EVENT_SCHEDULER_TRACE_INFO(...)     EVENT_SCHEDULER_TRACE(CEventSchedulerTraceLevel_Info, __VA_ARGS__)
+#define EVENT_SCHEDULER_TRACE_DEBUG(...)    EVENT_SCHEDULER_TRACE(CEventSchedulerTraceLevel_Debug, __VA_ARGS__)
+#define EVENT_SCHEDULER_TRACE_VERBOSE(...)  EVENT_SCHEDULER_TRACE(CEventSchedulerTraceLevel_Verbose, __VA_ARGS__)
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <time.h>
+#include <mutex>
+#include <condition_variable>
+
+// NOTES
+//
+// Sleeps until an absolute time on the system clock, for CEventSchedulerRunner and CEventSchedulerCoordinator.
+//
+// On Linux, it sleeps on a timerfd with an absolute CLOCK_REALTIME time, that is also woken up when the system clock
+// is set, and an eventfd for wakeUp(). Elsewhere it falls back to a condition variable, which does not notice the
+// clock being set.
+class CEventSchedulerWaiter {
+public:
+    CEventSchedulerWaiter();
+    ~CEventSchedulerWaiter();
+
+    CEventSchedulerWaiter(const CEventSchedulerWaiter &) = delete;
+    CEventSchedulerWaiter &operator=(const CEventSchedulerWaiter &) = delete;
+
+    bool isValid(void);
+
+    // Sleep until the given time, until wakeUp() is called, or (on Linux) until the system clock is set. A negative
+    // time sleeps until one of the latter. Returns true if the given time was reached.
+    bool waitUntil(time_t timestampGMT);
+
+    // Can be called from any thread. A wakeUp() before waitUntil() makes it return right away.
+    void wakeUp(void);
+
+private:
+#ifdef __linux__
+    int                     timerFd;
+    int                     eventFd;
+#else
+    std::mutex              waitMutex;
+    std::condition_variable waitCondition;
+    bool                    wakeUpRequested = false;
+#endif
+};
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <time.h>
+#include <stdint.h>
+#include <mutex>
+
+#include "SunriseCalculator.hpp"
+
+// A cache of sunrise and sunset times, that can be shared by many schedulers. Entries are keyed by the location,
+// quantized to a grid of quantizationDegrees (0.01 degrees is about 1 km, and moves sunrise by less than 2 seconds),
+// the beginning of the local day in GMT, and the mode of the calculation (exact or fast), so that calculators in
+// different modes can share a cache without getting each other's times. The cache has a fixed number of entries, that is set when it is
+// constructed. It is 4-way set associative, and replaces the least recently used entry of a set.
+//
+// The cache can be prefilled, e.g. with a whole year of sunrise and sunset times for a location, after which the
+// schedulers for that location never have to do the calculation themselves.
+//
+// All methods are thread safe.
+class CSolarTableCache {
+public:
+    CSolarTableCache(int numberOfEntries, double quantizationDegrees = 0.01);
+    ~CSolarTableCache();
+
+    CSolarTableCache(const CSolarTableCache &) = delete;
+    CSolarTableCache &operator=(const CSolarTableCache &) = delete;
+
+    bool lookup(double latitude, double longitude, time_t beginningOfDayGMT, time_t &sunRise, time_t &sunSet, CSunriseCalculatorMode mode = CSunriseCalculatorMode_Exact);
+    void store(double latitude, double longitude, time_t beginningOfDayGMT, time_t sunRise, time_t sunSet, CSunriseCalculatorMode mode = CSunriseCalculatorMode_Exact);
+
+    // Lookup, and calculate and store when not in the cache, in the mode of the calculator.
+    void sunRiseAndSetForDay(CSunriseCalculator &calculator, time_t beginningOfDayGMT, time_t &sunRise, time_t &sunSet);
+
+    // Calculate and store the given number of days for the location, starting at the beginning of the given day.
+    // Use 366 days to fill a whole year. Returns the number of days stored, which is less than asked for if the cache
+    // can not hold them all. Prefill in the mode of the calculators that will use the cache.
+    int prefill(double latitude, double longitude, time_t secondsFromGMT, time_t firstBeginningOfDayGMT, int numberOfDays, CSunriseCalculatorMode mode = CSunriseCalculatorMode_Exact);
+
+    void clear(void);
+
+    int getNumberOfEntries(void);
+    uint32_t getHits(void);
+    uint32_t getMisses(void);
+
+private:
+    static const int        waysPerSet = 4;
+    static const int32_t    unusedKey = INT32_MIN;
+
+    struct Entry {
+        int32_t     latitudeKey;            // unusedKey marks an unused entry
+        int32_t     longitudeKey;
+        CSunriseCalculatorMode mode;
+        time_t      beginningOfDayGMT;
+        time_t      sunRise;
+        time_t      sunSet;
+    };
+
+    Entry                   *entries;
+    int                     numberOfSets;
+    double                  quantizationDegrees;
+
+    uint32_t                hits = 0;
+    uint32_t                misses = 0;
+
+    std::mutex              mutex;
+
+    int32_t quantize(double degrees);
+    Entry *setForKey(int32_t latitudeKey, int32_t longitudeKey, time_t beginningOfDayGMT, CSunriseCalculatorMode mode);
+    static bool isKey(const Entry &entry, int32_t latitudeKey, int32_t longitudeKey, time_t beginningOfDayGMT, CSunriseCalculatorMode mode);
+};
@@ -1,15 +1,35 @@
 #pragma once
 
 #include <time.h>
+#include <stddef.h>
+
+enum CSunriseCalculatorMode {
+    CSunriseCalculatorMode_Exact = 0,       // The sunrise equation, with libm
+    CSunriseCalculatorMode_Fast             // Tables and polynomials, no libm sin/cos/asin/acos. See SunriseCalculator.cpp for the error.
+};
 
 class CSunriseCalculator {
 public:
     
-    CSunriseCalculator(float latitude, float longitude) : latitude(latitude), longitude(longitude) {}
+    CSunriseCalculator(float latitude, float longitude, CSunriseCalculatorMode mode = CSunriseCalculatorMode_Exact);
 
     void sunRiseAndSetForTimestamp(time_t timestampGMT, time_t secondsFromGMT, time_t &sunRise, time_t &sunSet);
 
+    void sunRiseAndSetForDays(const time_t *days, size_t count, time_t *sunRises, time_t *sunSets);
+
+    static void sunRiseAndSetBatch(const time_t *days, const double *latitudes, const double *longitudes, size_t count, time_t *sunRises, time_t *sunSets);
+
+    void setMode(CSunriseCalculatorMode mode);
+    CSunriseCalculatorMode getMode(void) const;
+
+    double getLatitude(void) const { return latitude; }
+    double getLongitude(void) const { return longitude; }
+
 private:
     double latitude;
     double longitude;
+    CSunriseCalculatorMode mode;
+
+    double sinLatitude;                     // For the fast mode
+    double cosLatitude;
 };
@@ -1,116 +1,411 @@
 #include <stdlib.h>
+#include <string.h>
 #include <algorithm>
 #include <time.h>
 #include <iostream>
 #include <assert.h>
-#include <random>
 
 #include "EventScheduler.hpp"
+#include "EventSchedulerTrace.hpp"
 
 // NOTE: We have to sort on the ACTIVE weekdays and time offsets, as those are the ones that are actually
-// used by the scheduler. That's why we have to re-sort every time the active weekdays and time offsets
-// might change.
-int qsortCompareEventSchedulerItems(const void *a, const void *b) {
-    const CEventSchedulerItem* itemA = static_cast<const CEventSchedulerItem*>(a);
-    const CEventSchedulerItem* itemB = static_cast<const CEventSchedulerItem*>(b);
-
-    if (itemA->isValid() == false && itemB->isValid() == true) {            // Invalid items go to the end
-        return 1;
-    } else if (itemA->isValid() == true && itemB->isValid() == false) {     // Invalid items go to the end
-        return -1;
-    } else if (itemA->activeWeekDay < itemB->activeWeekDay) {                           // Sort by week day
-        return -1;
-    } else if (itemA->activeWeekDay > itemB->activeWeekDay) {                           // Sort by week day
-        return 1;
-    } else {
-        if (itemA->activeTimeOffset < itemB->activeTimeOffset) {                        // Sort by time offset
-            return -1;
-        } else if (itemA->activeTimeOffset > itemB->activeTimeOffset) {                 // Sort by time offset
-            return 1;
-        } else {
-            return 0;                                                       // Equal    
-        }
+// used by the scheduler. The compiled schedule holds exactly these as its minuteOfWeek key. Ties are ordered by item
+// index, so that the order is the same whether the schedule was compiled or built one insert at a time.
+static bool compareScheduleEntries(const CEventSchedulerScheduleEntry &entryA, const CEventSchedulerScheduleEntry &entryB) {
+    return entryA.minuteOfWeek < entryB.minuteOfWeek || (entryA.minuteOfWeek == entryB.minuteOfWeek && entryA.itemIndex < entryB.itemIndex);
+}
+
+// Hash over the same fields that CEventSchedulerItem::operator== compares, so that equal items always end up in the
+// same bucket of the content index.
+static uint16_t hashItemContent(const CEventSchedulerItem &item) {
+    uint32_t hash = item.eventType;
+    hash = hash * 31 + item.weekDay;
+    hash = hash * 31 + item.userDefined;
+    if (item.eventType != CEventSchedulerItemType_Sunrise && item.eventType != CEventSchedulerItemType_Sunset) {
+        hash = hash * 31 + item.timeOffset;
     }
+    hash *= 2654435761u;    // Knuth's multiplicative hash, to spread the bits
+    return (uint16_t)(hash >> 16);
 }
 
-CEventScheduler::CEventScheduler(double latitude, double longitude, time_t secondsFromGMT, time_t (*timeProvider)(void)) :
+CEventSchedulerBase::CEventSchedulerBase(const CEventSchedulerStorage &storage, double latitude, double longitude, time_t secondsFromGMT, time_t (*timeProvider)(void)) :
 sunriseCalculator(CSunriseCalculator(latitude, longitude)),
 secondsFromGMT(secondsFromGMT),
 timeProvider(timeProvider) {
+    attachStorage(storage);
+    for (int slot = 0; slot < numberOfSchedulerItems; slot++) {
+        slotGenerations[slot] = 1;
+        slotStates[slot] = CEventSchedulerSlotState_Free;
+    }
+    resetItems();
+
     randomGenerator.seed(5138008 + timeProvider());
     recalculateAllActivationTimes();
 }
 
-CEventScheduler::~CEventScheduler() {
+CEventSchedulerBase::~CEventSchedulerBase() {
+    delete oneShotItems;
+    delete concurrentReader;
+}
+
+int CEventSchedulerBase::getCapacity(void) {
+    return numberOfSchedulerItems;
+}
+
+void CEventSchedulerBase::resetItems() {
+    if (updateInProgress) {
+        // Remove everything when the update is committed
+        for (int slot = 0; slot < numberOfSchedulerItems; slot++) {
+            if (slotStates[slot] == CEventSchedulerSlotState_Stored) {
+                slotStates[slot] = CEventSchedulerSlotState_PendingRemoval;
+            } else if (slotStates[slot] == CEventSchedulerSlotState_PendingAdd) {
+                releaseSlot(slot);
+            }
+        }
+        return;
+    }
+
+    clearItems();
+
+    notifyChanged();
 }
 
-void CEventScheduler::resetItems() {
+// Free all slots, without telling anyone. The caller publishes the change.
+void CEventSchedulerBase::clearItems(void) {
     numberOfStoredItems = 0;
-    for (int index = 0; index < numberOfSchedulerItems; index++) {
-        items[index] = CEventSchedulerItem();
+    numberOfFreeSlots = 0;
+    for (int slot = numberOfSchedulerItems - 1; slot >= 0; slot--) {
+        if (slotStates[slot] != CEventSchedulerSlotState_Free) {
+            slotGenerations[slot] = (slotGenerations[slot] % maximumSlotGeneration) + 1;
+        }
+        items[slot] = CEventSchedulerItem();
+        slotStates[slot] = CEventSchedulerSlotState_Free;
+        freeSlots[numberOfFreeSlots++] = slot;
     }
+    memset(contentIndex, 0, contentIndexSize * sizeof(uint16_t));
 }
 
-time_t CEventScheduler::getSecondsFromGMT(void) {
+// With a time zone, the offset at the current time.
+time_t CEventSchedulerBase::getSecondsFromGMT(void) {
+    if (timeZone != nullptr) {
+        return timeZone->getSecondsFromGMT(timeProvider());
+    }
     return secondsFromGMT;
 }
 
-void CEventScheduler::setSecondsFromGMT(time_t secondsFromGMT) {
+void CEventSchedulerBase::setSecondsFromGMT(time_t secondsFromGMT) {
     this->secondsFromGMT = secondsFromGMT;
-    randomGenerator.seed(5138008 + timeProvider());
+    timeZone = nullptr;
+    recalculateAllActivationTimes();
+}
+
+// The week starts at a different moment in another time zone, so the activation times are recalculated once. After
+// that, the transitions of the time zone need nothing.
+void CEventSchedulerBase::setTimeZone(const CEventSchedulerTimeZone *timeZone) {
+    this->timeZone = timeZone;
+    timeZoneSpan = CEventSchedulerTimeZoneSpan();
     recalculateAllActivationTimes();
 }
 
-// NOTE: It is undefined what happens when there are duplicate items (e.g. 2 or more 'sunset' items).
-//       In the case of having a random number, the duplication will probably resolve itself fine in
-//       most cases. But if there is no randomnes, only the first item is simply returned.
-//       Probably it's beneficial to be able to have duplicates. Can we do that without adding
-//       something that makes them unique (like an ID)?
-int CEventScheduler::addItem(const CEventSchedulerItem& item) {
+const CEventSchedulerTimeZone *CEventSchedulerBase::getTimeZone(void) {
+    return timeZone;
+}
 
-    if (numberOfStoredItems >= numberOfSchedulerItems) {
+uint32_t CEventSchedulerBase::getRandomSeed(void) {
+    return randomGenerator.getSeed();
+}
+
+void CEventSchedulerBase::setRandomSeed(uint32_t seed) {
+    randomGenerator.seed(seed);
+    recalculateAllActivationTimes();
+}
+
+// Add an item, and return a handle to it. The handle stays valid until the item is removed, and can be used to
+// find, update or remove exactly this item, also when there are other items that compare equal (e.g. 2 or more
+// 'sunset' items on the same day). Returns -1 if there is no space left.
+CEventSchedulerItemHandle CEventSchedulerBase::addItem(const CEventSchedulerItem& item) {
+    EVENT_SCHEDULER_METRICS_TIME(metrics, CEventSchedulerLatency_AddItem);
+
+    int slot = allocateSlot(item);
+    if (slot < 0) {
         return -1; // No space left
     }
 
-    int newItemIndex = numberOfStoredItems;
-    
-    items[newItemIndex] = item;
-    recalculateActivationTime(items[newItemIndex]);
+    if (updateInProgress) {
+        // Activation time is calculated on commit
+        slotStates[slot] = CEventSchedulerSlotState_PendingAdd;
+        return makeHandle(slot);
+    }
+
+    recalculateActivationTime(slot);
+    slotStates[slot] = CEventSchedulerSlotState_Stored;
 
     numberOfStoredItems++;
 
-    sortItems();
+    insertIntoSchedule(slot);
 
-    return 0;
+    notifyChanged();
+
+    return makeHandle(slot);
 }
  
-int CEventScheduler::removeItem(const CEventSchedulerItem& item) {
+// NOTE: It is undefined which item is removed when there are duplicate items (e.g. 2 or more 'sunset' items).
+//       Use the handle that addItem() returned to remove a specific one.
+int CEventSchedulerBase::removeItem(const CEventSchedulerItem& item) {
+    EVENT_SCHEDULER_METRICS_TIME(metrics, CEventSchedulerLatency_RemoveItem);
+
+    int slot = findItemIndex(item, true);
+    if (slot < 0) {
+        return -1; // Item not found
+    }
+
+    return removeItemInSlot(slot);
+}
+
+// Remove exactly this item, not one that only compares equal, e.g. when replaying a CEventSchedulerJournal. The item in
+// preferredSlot is removed if it is this item, so that the right one of equal items goes.
+int CEventSchedulerBase::removeIdenticalItem(const CEventSchedulerItem &item, int preferredSlot) {
+    EVENT_SCHEDULER_METRICS_TIME(metrics, CEventSchedulerLatency_RemoveItem);
+
+    int slot = preferredSlot;
+    if (slot < 0 || slot >= numberOfSchedulerItems ||
+        !(slotStates[slot] == CEventSchedulerSlotState_Stored || slotStates[slot] == CEventSchedulerSlotState_PendingAdd) ||
+        !(items[slot] == item) || items[slot].randomOffsetMinus != item.randomOffsetMinus || items[slot].randomOffsetPlus != item.randomOffsetPlus) {
+        slot = findItemIndex(item, true, true);
+    }
+    if (slot < 0) {
+        return -1; // Item not found
+    }
+
+    return removeItemInSlot(slot);
+}
+
+// Add the item in the given slot, e.g. when replaying a CEventSchedulerJournal, so that it gets the same random offsets
+// as before. Takes another slot if that one is not free.
+CEventSchedulerItemHandle CEventSchedulerBase::addItemInSlot(const CEventSchedulerItem &item, int slot) {
+    while (slot >= numberOfSchedulerItems && slot < CEventSchedulerStorage::maximumCapacity) {
+        if (!growStorage()) {
+            break;
+        }
+    }
+
+    if (slot >= 0 && slot < numberOfSchedulerItems && slotStates[slot] == CEventSchedulerSlotState_Free) {
+        // addItem() takes the slot on top of the free slots
+        for (int index = 0; index < numberOfFreeSlots; index++) {
+            if (freeSlots[index] == slot) {
+                std::swap(freeSlots[index], freeSlots[numberOfFreeSlots - 1]);
+                break;
+            }
+        }
+    }
+
+    return addItem(item);
+}
+
+int CEventSchedulerBase::removeItem(CEventSchedulerItemHandle handle) {
+    EVENT_SCHEDULER_METRICS_TIME(metrics, CEventSchedulerLatency_RemoveItem);
+
+    int slot = slotForHandle(handle);
+    if (slot < 0) {
+        return -1; // Item not found
+    }
 
-    int foundItemIndex = findItemIndex(item);
-    if (foundItemIndex >= 0) {
-        items[foundItemIndex] = CEventSchedulerItem{}; // Invalidate the item
-        sortItems();
-        numberOfStoredItems--;
+    return removeItemInSlot(slot);
+}
+
+// Replace the contents of the item, keeping its handle. Items that were stored before an update was started can not be
+// changed during the update.
+int CEventSchedulerBase::updateItem(CEventSchedulerItemHandle handle, const CEventSchedulerItem& item) {
+
+    int slot = slotForHandle(handle);
+    if (slot < 0 || !item.isValid()) {
+        return -1; // Item not found
+    }
+
+    if (slotStates[slot] == CEventSchedulerSlotState_PendingAdd) {
+        removeFromContentIndex(slot);
+        items[slot] = item;
+        insertIntoContentIndex(slot);
         return 0;
     }
-    return -1; // Item not found
+
+    if (updateInProgress) {
+        return -1; // The stored item is still in use by the schedule
+    }
+
+    removeFromSchedule(slot);
+    removeFromContentIndex(slot);
+
+    items[slot] = item;
+    recalculateActivationTime(slot);
+
+    insertIntoContentIndex(slot);
+    insertIntoSchedule(slot);
+
+    notifyChanged();
+
+    return 0;
+}
+
+// Start a bulk update. Until commitUpdate() is called, addItem(), removeItem() and resetItems() only collect the
+// changes, and all getters keep returning the items as they were before the update. On commit, the activation times
+// of the new items are calculated and the schedule is rebuilt once, instead of once per change.
+int CEventSchedulerBase::beginUpdate(void) {
+    if (updateInProgress) {
+        return -1; // Updates can not be nested
+    }
+
+    updateInProgress = true;
+
+    return 0;
+}
+
+int CEventSchedulerBase::commitUpdate(void) {
+    if (!updateInProgress) {
+        return -1; // No update to commit
+    }
+
+    // Calculate the activation times of the new items, in the week of the compiled schedule. They all use the same
+    // week, so the sunrise and sunset only have to be calculated once per week day.
+    numberOfStoredItems = 0;
+    for (int slot = 0; slot < numberOfSchedulerItems; slot++) {
+        switch (slotStates[slot]) {
+            case CEventSchedulerSlotState_PendingAdd:
+                recalculateActivationTime(slot, scheduleLocalBeginningOfWeek);
+                slotStates[slot] = CEventSchedulerSlotState_Stored;
+                numberOfStoredItems++;
+                break;
+            case CEventSchedulerSlotState_PendingRemoval:
+                releaseSlot(slot);
+                break;
+            case CEventSchedulerSlotState_Stored:
+                numberOfStoredItems++;
+                break;
+            default:
+                break;
+        }
+    }
+
+    updateInProgress = false;
+
+    compileSchedule();
+
+    notifyChanged();
+
+    return 0;
+}
+
+// Discard all changes made since beginUpdate().
+void CEventSchedulerBase::cancelUpdate(void) {
+    if (!updateInProgress) {
+        return;
+    }
+
+    for (int slot = 0; slot < numberOfSchedulerItems; slot++) {
+        if (slotStates[slot] == CEventSchedulerSlotState_PendingAdd) {
+            releaseSlot(slot);
+        } else if (slotStates[slot] == CEventSchedulerSlotState_PendingRemoval) {
+            slotStates[slot] = CEventSchedulerSlotState_Stored;
+        }
+    }
+
+    updateInProgress = false;
+}
+
+// Replace all items by the given items in one go. Fails without changing anything if an item is not valid, or the items
+// do not fit. If handles is not null, it receives the handles of the new items. The change is published once, on commit:
+// listeners and concurrent readers see either the old items or the new ones.
+int CEventSchedulerBase::replaceAllItems(const CEventSchedulerItem *newItems, int numberOfNewItems, CEventSchedulerItemHandle *handles) {
+    if (numberOfNewItems < 0 || updateInProgress) {
+        return -1; // Can not be used during an update
+    }
+
+    for (int index = 0; index < numberOfNewItems; index++) {
+        if (!newItems[index].isValid() || newItems[index].eventType == CEventSchedulerItemType_OneShot) {
+            return -1; // Would not be added
+        }
+    }
+
+    while (numberOfNewItems > numberOfSchedulerItems) {
+        if (!growStorage()) {
+            return -1; // No space left
+        }
+    }
+
+    // All stored items are replaced, so their slots can be reused right away. The schedule is not looked at again
+    // before it is compiled on commit.
+    beginUpdate();
+    clearItems();
+
+    for (int index = 0; index < numberOfNewItems; index++) {
+        CEventSchedulerItemHandle handle = addItem(newItems[index]);
+        if (handles != nullptr) {
+            handles[index] = handle;
+        }
+    }
+
+    return commitUpdate();
+}
+
+// Add an item that activates once, at the given time. Returns a handle that can be used to cancel it, or -1 if
+// there is no memory left.
+CEventSchedulerTimerHandle CEventSchedulerBase::addOneShotItem(time_t timestampGMT, uint8_t userDefined) {
+
+    if (oneShotItems == nullptr) {
+        oneShotItems = new CEventSchedulerTimingWheel(timeProvider());
+    }
+
+    // The item gets the week day and time of day of the activation, so it looks like any other item.
+    CEventSchedulerItem item;
+    item.eventType = CEventSchedulerItemType_OneShot;
+    item.weekDay = calculateWeekDay(timestampGMT);
+    item.timeOffset = calculateMinutesFromBeginningOfDay(timestampGMT);
+    item.activeWeekDay = item.weekDay;
+    item.activeTimeOffset = item.timeOffset;
+    item.userDefined = userDefined;
+
+    CEventSchedulerTimerHandle handle = oneShotItems->add(timestampGMT, item);
+    if (handle >= 0) {
+        notifyChanged();
+    }
+
+    return handle;
 }
 
-int CEventScheduler::getNumberOfItems(void) {
+// Cancel a one-shot item that has not activated yet.
+int CEventSchedulerBase::cancelOneShotItem(CEventSchedulerTimerHandle handle) {
+
+    if (oneShotItems == nullptr || oneShotItems->cancel(handle) < 0) {
+        return -1; // Already activated or cancelled
+    }
+
+    notifyChanged();
+
+    return 0;
+}
+
+// The number of one-shot items that have not activated yet.
+int CEventSchedulerBase::getNumberOfOneShotItems(void) {
+    return (oneShotItems != nullptr) ? oneShotItems->getNumberOfTimers() : 0;
+}
+
+int CEventSchedulerBase::getNumberOfItems(void) {
     return numberOfStoredItems;
 }
 
-CEventSchedulerItem CEventScheduler::getItem(int index) {
+// Returns the item at the given position in the schedule, i.e. the items are returned sorted by their
+// activation time.
+CEventSchedulerItem CEventSchedulerBase::getItem(int index) {
     if ((index >= 0) && (index < numberOfStoredItems)) {
-        return items[index];
+        return items[schedule[index].itemIndex];
 
     }
     return CEventSchedulerItem();
 }
 
-CEventSchedulerItem CEventScheduler::findItem(const CEventSchedulerItem& itemToFind) {
+CEventSchedulerItem CEventSchedulerBase::findItem(const CEventSchedulerItem& itemToFind) {
     
-    int itemIndex = findItemIndex(itemToFind);
+    int itemIndex = findItemIndex(itemToFind, false);
     
     if (itemIndex >= 0) {
         return items[itemIndex];
@@ -119,140 +414,668 @@ CEventSchedulerItem CEventScheduler::findItem(const CEventSchedulerItem& itemToF
     return CEventSchedulerItem();
 }
 
-CEventSchedulerItem CEventScheduler::getActiveItem(void) {
+CEventSchedulerItem CEventSchedulerBase::findItem(CEventSchedulerItemHandle handle) {
+
+    int slot = slotForHandle(handle);
+
+    if (slot >= 0 && slotStates[slot] != CEventSchedulerSlotState_PendingAdd) {
+        return items[slot];
+    }
+
+    return CEventSchedulerItem();
+}
+
+CEventSchedulerItemHandle CEventSchedulerBase::findItemHandle(const CEventSchedulerItem& itemToFind) {
+
+    int itemIndex = findItemIndex(itemToFind, false);
+
+    if (itemIndex >= 0) {
+        return makeHandle(itemIndex);
+    }
+
+    return -1;
+}
+
+CEventSchedulerItem CEventSchedulerBase::getActiveItem(void) {
 
     time_t timestampGMT = timeProvider();
     return getActiveItem(timestampGMT);
 }
 
-CEventSchedulerItem CEventScheduler::getNextActiveItem(void) {
+CEventSchedulerItem CEventSchedulerBase::getNextActiveItem(void) {
 
     time_t timestampGMT = timeProvider();
     return getNextActiveItem(timestampGMT);
 }
 
-CEventSchedulerItem CEventScheduler::getActiveItem(time_t timestampGMT) {
+CEventSchedulerItem CEventSchedulerBase::getActiveItem(time_t timestampGMT) {
 
-    int index;
-    
-    if ((index = getActiveItemIndex(timestampGMT)) >= 0) {
-        return items[index];
+    CEventSchedulerItem activeItem;
+    CEventSchedulerItem nextActiveItem;
+    getActiveAndNextItem(timestampGMT, activeItem, nextActiveItem);
+
+    return activeItem;
+}
+
+CEventSchedulerItem CEventSchedulerBase::getNextActiveItem(time_t timestampGMT) {
+
+    CEventSchedulerItem activeItem;
+    CEventSchedulerItem nextActiveItem;
+    getActiveAndNextItem(timestampGMT, activeItem, nextActiveItem);
+
+    return nextActiveItem;
+}
+
+int CEventSchedulerBase::getActiveAndNextItem(CEventSchedulerItem &activeItem, CEventSchedulerItem &nextActiveItem) {
+
+    time_t timestampGMT = timeProvider();
+    return getActiveAndNextItem(timestampGMT, activeItem, nextActiveItem);
+}
+
+// Same as calling getActiveItem() and getNextActiveItem(), but with a single lookup. Both the weekly items and the
+// one-shot items are looked at.
+int CEventSchedulerBase::getActiveAndNextItem(time_t timestampGMT, CEventSchedulerItem &activeItem, CEventSchedulerItem &nextActiveItem) {
+    EVENT_SCHEDULER_METRICS_TIME(metrics, CEventSchedulerLatency_Lookup);
+    EVENT_SCHEDULER_METRICS_COUNT(metrics, CEventSchedulerCounter_Lookups);
+
+    time_t activationTime = -1;
+    time_t nextActivationTime = -1;
+
+    processOneShotItems(timestampGMT);
+    compileScheduleForWeekOf(timestampGMT);
+
+    activeItem = CEventSchedulerItem{};
+    nextActiveItem = CEventSchedulerItem{};
+
+    if (numberOfStoredItems > 0) {
+        int index = getActiveItemIndex(timestampGMT);
+        if (index >= 0) {
+            activeItem = items[schedule[index].itemIndex];
+            activationTime = calculateActivationTime(index);
+        } else {
+            // Nothing activated in this week yet, so the last activation of the week before is still active.
+            calculateAdjacentActivations();
+            activeItem = lastActivationOfPreviousWeek.item;
+            activationTime = lastActivationOfPreviousWeek.timestampGMT;
+        }
+        nextActivationTime = getNextWeeklyActivationTime(timestampGMT, nextActiveItem);
     }
 
-    return CEventSchedulerItem{}; // Return an invalid item
+    if (oneShotItems != nullptr) {
+        // A one-shot item overrides the weekly item that was active when it activated.
+        if (lastOneShotTime >= 0 && lastOneShotTime <= timestampGMT && lastOneShotTime >= activationTime) {
+            activeItem = lastOneShotItem;
+        }
+
+        CEventSchedulerItem oneShotItem;
+        time_t oneShotTime = oneShotItems->getNextExpiryTime(&oneShotItem);
+        if (oneShotTime > timestampGMT && (nextActivationTime < 0 || oneShotTime <= nextActivationTime)) {
+            nextActiveItem = oneShotItem;
+        }
+    }
+
+    return activeItem.isValid() ? 0 : -1;
+}
+
+time_t CEventSchedulerBase::getNextActivationTime(void) {
+
+    time_t timestampGMT = timeProvider();
+    return getNextActivationTime(timestampGMT);
 }
 
-CEventSchedulerItem CEventScheduler::getNextActiveItem(time_t timestampGMT) {
+// Returns the GMT timestamp of the first activation of an item (weekly or one-shot) after the given time, so that a
+// caller can sleep until then instead of polling. Returns -1 if there are no items.
+time_t CEventSchedulerBase::getNextActivationTime(time_t timestampGMT) {
+    EVENT_SCHEDULER_METRICS_COUNT(metrics, CEventSchedulerCounter_Lookups);
+
+    compileScheduleForWeekOf(timestampGMT);
+
+    CEventSchedulerItem nextItem;
+    time_t nextActivationTime = getNextWeeklyActivationTime(timestampGMT, nextItem);
 
-    int index;
+    if (oneShotItems != nullptr) {
+        processOneShotItems(timestampGMT);
 
-    if ((index = getActiveItemIndex(timestampGMT)) >= 0) {
-        int nextIndex = (index + 1) % numberOfStoredItems;
-        return items[nextIndex];
+        time_t oneShotTime = oneShotItems->getNextExpiryTime();
+        if (oneShotTime > timestampGMT && (nextActivationTime < 0 || oneShotTime < nextActivationTime)) {
+            nextActivationTime = oneShotTime;
+        }
     }
 
-    return CEventSchedulerItem{}; // Return an invalid item
+    return nextActivationTime;
 }
 
-int CEventScheduler::getActiveItemIndex(time_t timestampGMT) {
+// Returns the GMT timestamp of the first activation of a weekly item after the given time, or -1 if there are none.
+// nextItem receives the item. The given time must be in the week of the compiled schedule.
+time_t CEventSchedulerBase::getNextWeeklyActivationTime(time_t timestampGMT, CEventSchedulerItem &nextItem) {
 
-    // If the list is empty, return an invalid item
     if (numberOfStoredItems == 0) {
-        // std::cout << "No scheduled events\n";
         return -1;
     }
 
-    // If the list contains only one item, return that item
-    if (numberOfStoredItems == 1) {
-        // std::cout << "Only one scheduled event\n";
-        return 0;
+    uint16_t minuteOfWeek = calculateMinutesFromBeginningOfWeek(timestampGMT);
+
+    // The next activation is the first entry after the current minute. If there is none, it is the first activation
+    // of next week, which has random offsets (and a sunrise and sunset) of its own.
+    const CEventSchedulerScheduleEntry *first = schedule;
+    const CEventSchedulerScheduleEntry *last = schedule + numberOfStoredItems;
+    const CEventSchedulerScheduleEntry *found = std::upper_bound(first, last, minuteOfWeek,
+        [](uint16_t minute, const CEventSchedulerScheduleEntry &entry) { return minute < entry.minuteOfWeek; });
+
+    if (found == last) {
+        calculateAdjacentActivations();
+        nextItem = firstActivationOfNextWeek.item;
+        return firstActivationOfNextWeek.timestampGMT;
     }
 
-    CEventSchedulerWeekDay weekDay = calculateWeekDay(timestampGMT);
-    time_t minutesFromBeginningOfDay = calculateMinutesFromBeginningOfDay(timestampGMT);
+    nextItem = items[found->itemIndex];
+    return gmtForLocalTime(scheduleLocalBeginningOfWeek + (time_t)found->minuteOfWeek * 60);
+}
 
-    // std::cout << "Current weekDay: " << (int)weekDay << "\n";
-    // std::cout << "Current minutes: " << (minutesFromBeginningOfDay / 60) << ":" << std::setfill('0') << std::setw(2) << (minutesFromBeginningOfDay % 60) << "\n";
+// The compiled schedule holds the activation times of one week. Compile it for the week of the given time, if that is
+// another week, e.g. at the first lookup after the week rolled over. The activation times change, so the listeners
+// are told.
+void CEventSchedulerBase::compileScheduleForWeekOf(time_t timestampGMT) {
+    time_t localBeginningOfWeek = calculateLocalBeginningOfWeek(timestampGMT);
 
-    // The active item is the last item before or equal to the current time on the current weekday.
-    // Easiest way to find it, is to turn that around: iterate backwards through the list of items
-    // and look for the first item that is before or equal to the current time on the current weekday.
-    // Note that this relies on a sorted list if event items.
-    for (int index = numberOfStoredItems - 1; index >= 0; index--) {
-        const CEventSchedulerItem& item = items[index];
+    if (localBeginningOfWeek != scheduleLocalBeginningOfWeek) {
+        recalculateAllActivationTimes(localBeginningOfWeek);
+    }
+}
 
-        // std::cout << "Considering item index: " << index << " - ";
-        item.debugPrint();
+// Calculate the last activation of the week before the compiled schedule, and the first activation of the week after
+// it, for the lookups that go past either end of the compiled schedule. Items that activate at the same time are
+// ordered by slot, as in activations().
+void CEventSchedulerBase::calculateAdjacentActivations(void) {
+    const time_t secondsInWeek = daysInWeek * secondsInDay;
 
-        if (item.isValid() && item.activeWeekDay <= weekDay) {
+    if (areAdjacentActivationsValid) {
+        return;
+    }
 
-            if (item.activeWeekDay == weekDay && item.activeTimeOffset <= minutesFromBeginningOfDay) {
-                // If this item has the requested weekday, and its activeTimeoffset is less than the
-                // time we have been given, then this is the active item.
-                // std::cout << "-> Found. activeWeekDay == weekDay && activeTimeOffset <= minutesFromBeginningOfDay\n";
-                return index;   
+    int lastSlot = -1;
+    int firstSlot = -1;
+
+    for (int slot = 0; slot < numberOfSchedulerItems; slot++) {
+        if (!isVisible(slot)) {
+            continue;
+        }
+
+        CEventSchedulerItem itemInWeek;
+        time_t localBeginningOfWeek = scheduleLocalBeginningOfWeek - secondsInWeek;
+        time_t timestamp = gmtForLocalTime(localBeginningOfWeek + (time_t)calculateMinuteOfWeekInWeek(slot, localBeginningOfWeek, itemInWeek) * 60);
+        if (lastSlot < 0 || timestamp >= lastActivationOfPreviousWeek.timestampGMT) {
+            lastActivationOfPreviousWeek.timestampGMT = timestamp;
+            lastActivationOfPreviousWeek.item = itemInWeek;
+            lastSlot = slot;
+        }
+
+        localBeginningOfWeek = scheduleLocalBeginningOfWeek + secondsInWeek;
+        timestamp = gmtForLocalTime(localBeginningOfWeek + (time_t)calculateMinuteOfWeekInWeek(slot, localBeginningOfWeek, itemInWeek) * 60);
+        if (firstSlot < 0 || timestamp < firstActivationOfNextWeek.timestampGMT) {
+            firstActivationOfNextWeek.timestampGMT = timestamp;
+            firstActivationOfNextWeek.item = itemInWeek;
+            firstSlot = slot;
+        }
+    }
+
+    lastActivationOfPreviousWeek.handle = (lastSlot >= 0) ? makeHandle(lastSlot) : -1;
+    firstActivationOfNextWeek.handle = (firstSlot >= 0) ? makeHandle(firstSlot) : -1;
+    areAdjacentActivationsValid = true;
+}
+
+time_t CEventSchedulerBase::getCurrentTime(void) {
+    return timeProvider();
+}
+
+// Returns the activations of all items from fromGMT up to (not including) toGMT. See CEventSchedulerActivationRange.
+CEventSchedulerActivationRange CEventSchedulerBase::activations(time_t fromGMT, time_t toGMT) {
+    return CEventSchedulerActivationRange(this, fromGMT, toGMT);
+}
+
+// Find the first activation after the given one, i.e. the one with the lowest (timestamp, slot) that is higher than
+// (activation.timestampGMT, slot), and before toGMT. Only the week that is being looked at is calculated, so the
+// sunrise and sunset times are calculated once per day, and nothing has to be stored.
+bool CEventSchedulerBase::findNextActivation(time_t toGMT, CEventSchedulerActivation &activation, int &slot) {
+
+    if (numberOfStoredItems == 0) {
+        return false;
+    }
+
+    time_t afterTimestamp = activation.timestampGMT;
+    int afterSlot = slot;
+
+    for (time_t localBeginningOfWeek = calculateLocalBeginningOfWeek(afterTimestamp); gmtForLocalTime(localBeginningOfWeek) < toGMT; localBeginningOfWeek += daysInWeek * secondsInDay) {
+        int bestSlot = -1;
+        time_t bestTimestamp = 0;
+        CEventSchedulerItem bestItem;
+
+        for (int candidateSlot = 0; candidateSlot < numberOfSchedulerItems; candidateSlot++) {
+            if (!isVisible(candidateSlot)) {
+                continue;
+            }
+
+            CEventSchedulerItem itemInWeek;
+            time_t timestamp = gmtForLocalTime(localBeginningOfWeek + (time_t)calculateMinuteOfWeekInWeek(candidateSlot, localBeginningOfWeek, itemInWeek) * 60);
+
+            if (timestamp < afterTimestamp || (timestamp == afterTimestamp && candidateSlot <= afterSlot)) {
+                continue; // Already had this one
+            }
+            if (bestSlot < 0 || timestamp < bestTimestamp) {
+                bestSlot = candidateSlot;
+                bestTimestamp = timestamp;
+                bestItem = itemInWeek;
             }
-            else if (item.activeWeekDay < weekDay) {
-                // std::cout << "-> Found. activeWeekDay < weekDay\n";
-                return index;
+        }
+
+        if (bestSlot >= 0) {
+            if (bestTimestamp >= toGMT) {
+                return false;
             }
+            activation.timestampGMT = bestTimestamp;
+            activation.item = bestItem;
+            activation.handle = makeHandle(bestSlot);
+            slot = bestSlot;
+            return true;
         }
     }
 
-    // If we come here, we did not find an active item during iterating. Therefore, IF there is
-    //  any active item, it must be the last valid item in the list.
-    for (int index = numberOfStoredItems - 1; index >= 0; index--) {
-        const CEventSchedulerItem& item = items[index];
-        if (item.isValid()) {
-            // std::cout << "-> Found. Last item in list\n";
-            return index;
+    return false;
+}
+
+// Calculate the activation time of the item in the slot in the week that starts at localBeginningOfWeek, as minutes from
+// the beginning of that week. The sunrise, sunset and random offset are those of that week. itemInWeek receives the item
+// with the activation time in that week.
+uint16_t CEventSchedulerBase::calculateMinuteOfWeekInWeek(int slot, time_t localBeginningOfWeek, CEventSchedulerItem &itemInWeek) {
+    const int minutesInWeek = daysInWeek * minutesInDay;
+    const CEventSchedulerItem &item = items[slot];
+
+    int randomOffset = calculateRandomOffset(item, slot, localBeginningOfWeek);
+
+    itemInWeek = item;
+
+    if (item.eventType == CEventSchedulerItemType_Sunrise || item.eventType == CEventSchedulerItemType_Sunset) {
+        time_t sunriseTime, sunsetTime;
+        sunRiseAndSetForDay(gmtForLocalTime(localBeginningOfWeek + (item.weekDay - 1) * secondsInDay), sunriseTime, sunsetTime);
+        itemInWeek.timeOffset = calculateMinutesFromBeginningOfDay(item.eventType == CEventSchedulerItemType_Sunrise ? sunriseTime : sunsetTime);
+    }
+
+    int minuteOfWeek = ((itemInWeek.weekDay - 1) * minutesInDay + itemInWeek.timeOffset + randomOffset + minutesInWeek) % minutesInWeek;
+
+    itemInWeek.activeWeekDay = static_cast<CEventSchedulerWeekDay>(minuteOfWeek / minutesInDay + 1);
+    itemInWeek.activeTimeOffset = minuteOfWeek % minutesInDay;
+
+    return minuteOfWeek;
+}
+
+CEventSchedulerActivationRange::Iterator CEventSchedulerActivationRange::begin(void) {
+    Iterator iterator;
+
+    // Start right before fromGMT, so that an activation at exactly fromGMT is included.
+    iterator.scheduler = scheduler;
+    iterator.toGMT = toGMT;
+    iterator.slot = -1;
+    iterator.activation.timestampGMT = fromGMT;
+
+    if (!scheduler->findNextActivation(toGMT, iterator.activation, iterator.slot)) {
+        iterator.scheduler = nullptr;
+    }
+
+    return iterator;
+}
+
+CEventSchedulerActivationRange::Iterator &CEventSchedulerActivationRange::Iterator::operator++() {
+    if (scheduler != nullptr && !scheduler->findNextActivation(toGMT, activation, slot)) {
+        scheduler = nullptr;
+    }
+    return *this;
+}
+
+// The change counter is incremented on every change of the items or their activation times.
+uint32_t CEventSchedulerBase::getChangeCounter(void) {
+    return changeCounter;
+}
+
+// Set a function that is called after every change of the items or their activation times. Changes that are made
+// during an update are reported once, on commit. Pass nullptr to remove the listener.
+void CEventSchedulerBase::setChangeListener(CEventSchedulerChangeListener listener, void *context) {
+    changeListener = listener;
+    changeListenerContext = context;
+}
+
+// Returns a reader that can be used from any number of threads without a lock, see EventSchedulerConcurrentReader.hpp.
+// The reader is owned by the scheduler. From now on, every change of the scheduler is published to the reader.
+CEventSchedulerConcurrentReader *CEventSchedulerBase::enableConcurrentReads(void) {
+    if (concurrentReader == nullptr) {
+        concurrentReader = new CEventSchedulerConcurrentReader(timeProvider);
+        publishSnapshot();
+    }
+    return concurrentReader;
+}
+
+void CEventSchedulerBase::notifyChanged(void) {
+    changeCounter++;
+    areAdjacentActivationsValid = false;
+    publishSnapshot();
+    if (changeListener != nullptr) {
+        changeListener(*this, changeListenerContext);
+    }
+}
+
+// Copy the compiled schedule, and what is needed to look up items in it, to the concurrent reader.
+void CEventSchedulerBase::publishSnapshot(void) {
+    if (concurrentReader == nullptr) {
+        return;
+    }
+
+    CEventSchedulerConcurrentReader::Snapshot *snapshot = concurrentReader->beginPublish(numberOfStoredItems);
+    if (snapshot == nullptr) {
+        return; // No memory left, the readers keep the previous snapshot
+    }
+
+    for (int index = 0; index < numberOfStoredItems; index++) {
+        snapshot->minutesOfWeek[index] = schedule[index].minuteOfWeek;
+        snapshot->items[index] = items[schedule[index].itemIndex];
+    }
+
+    snapshot->localBeginningOfWeek = scheduleLocalBeginningOfWeek;
+    if (numberOfStoredItems > 0) {
+        calculateAdjacentActivations();
+        snapshot->lastTimeOfPreviousWeek = lastActivationOfPreviousWeek.timestampGMT;
+        snapshot->lastItemOfPreviousWeek = lastActivationOfPreviousWeek.item;
+        snapshot->firstTimeOfNextWeek = firstActivationOfNextWeek.timestampGMT;
+        snapshot->firstItemOfNextWeek = firstActivationOfNextWeek.item;
+    }
+
+    snapshot->secondsFromGMT = secondsFromGMT;
+    snapshot->timeZone = timeZone;
+    snapshot->lastOneShotTime = lastOneShotTime;
+    snapshot->lastOneShotItem = lastOneShotItem;
+    snapshot->nextOneShotTime = (oneShotItems != nullptr) ? oneShotItems->getNextExpiryTime(&snapshot->nextOneShotItem) : -1;
+    snapshot->changeCounter = changeCounter;
+
+    concurrentReader->endPublish();
+}
+
+// Returns the GMT timestamp of the activation of the entry at the given index in the compiled schedule, in the week
+// of the compiled schedule.
+time_t CEventSchedulerBase::calculateActivationTime(int scheduleIndex) {
+
+    return gmtForLocalTime(scheduleLocalBeginningOfWeek + (time_t)schedule[scheduleIndex].minuteOfWeek * 60);
+}
+
+// Let the one-shot items activate, up to the given time. The timing wheel follows the clock, so it does not move
+// beyond the current time, and it never moves back.
+void CEventSchedulerBase::processOneShotItems(time_t timestampGMT) {
+
+    if (oneShotItems == nullptr) {
+        return;
+    }
+
+    time_t currentTime = timeProvider();
+    if (timestampGMT > currentTime) {
+        timestampGMT = currentTime;
+    }
+    if (timestampGMT > oneShotItems->getCurrentTime()) {
+        time_t previousOneShotTime = lastOneShotTime;
+        oneShotItems->advance(timestampGMT, oneShotItemActivated, this);
+        if (lastOneShotTime != previousOneShotTime) {
+            publishSnapshot();
         }
     }
+}
 
-    // Basically, we should never come here, because if there are no valid items, we should have returned
-    // at the beginning of the function. Assert, but for release builds, just return an error.
-    assert(false && "This should never happen, because if there are no valid items, we should have returned at the beginning of the function.");
-    
-    return -1;
+void CEventSchedulerBase::oneShotItemActivated(CEventSchedulerTimerHandle /* handle */, time_t timestampGMT, const CEventSchedulerItem &item, void *context) {
+    CEventSchedulerBase *scheduler = static_cast<CEventSchedulerBase *>(context);
+
+    scheduler->lastOneShotTime = timestampGMT;
+    scheduler->lastOneShotItem = item;
 }
 
-int CEventScheduler::findItemIndex(const CEventSchedulerItem& itemToFind) {
-    for (int i = 0; i < numberOfStoredItems; i++) {
-        if (items[i] == itemToFind) {
-            return i;
+// Returns the index into the compiled schedule of the item that is active at the given time, or -1 if no item has
+// activated yet in the week of the compiled schedule. The given time must be in that week.
+int CEventSchedulerBase::getActiveItemIndex(time_t timestampGMT) {
+
+    uint16_t minuteOfWeek = calculateMinutesFromBeginningOfWeek(timestampGMT);
+
+    // The active item is the last item before or equal to the current time in the week. The compiled
+    // schedule is sorted, so binary search for the first entry that is after the current time, the
+    // entry before that one is the active one.
+    const CEventSchedulerScheduleEntry *first = schedule;
+    const CEventSchedulerScheduleEntry *last = schedule + numberOfStoredItems;
+    const CEventSchedulerScheduleEntry *found = std::upper_bound(first, last, minuteOfWeek,
+        [](uint16_t minute, const CEventSchedulerScheduleEntry &entry) { return minute < entry.minuteOfWeek; });
+
+    return (int)(found - first) - 1;
+}
+
+// Find the slot of an item that compares equal to itemToFind, through the content index. Items that were added
+// during an update are only found if includePending is set, items that are removed during an update only if it is
+// not set.
+// With identicalOnly, the item must also have the same random offsets, which operator== does not compare.
+int CEventSchedulerBase::findItemIndex(const CEventSchedulerItem& itemToFind, bool includePending, bool identicalOnly) {
+    uint16_t mask = contentIndexSize - 1;
+    for (uint16_t position = hashItemContent(itemToFind) & mask; contentIndex[position] != 0; position = (position + 1) & mask) {
+        int slot = contentIndex[position] - 1;
+        if (items[slot] == itemToFind &&
+            (!identicalOnly || (items[slot].randomOffsetMinus == itemToFind.randomOffsetMinus &&
+                                items[slot].randomOffsetPlus == itemToFind.randomOffsetPlus))) {
+            CEventSchedulerSlotState state = slotStates[slot];
+            if (state == CEventSchedulerSlotState_Stored ||
+                (state == CEventSchedulerSlotState_PendingAdd && includePending) ||
+                (state == CEventSchedulerSlotState_PendingRemoval && !includePending)) {
+                return slot;
+            }
         }
     }
     return -1;
 }
 
-int CEventScheduler::calculateBeginningOfWeekInSeconds(time_t timestampGMT) {
-    time_t localTime = timestampGMT + secondsFromGMT;
+int CEventSchedulerBase::removeItemInSlot(int slot) {
+
+    if (updateInProgress) {
+        if (slotStates[slot] == CEventSchedulerSlotState_PendingAdd) {
+            // Was never visible, so can be removed right away.
+            releaseSlot(slot);
+            return 0;
+        }
+        if (slotStates[slot] == CEventSchedulerSlotState_PendingRemoval) {
+            return -1; // Already removed
+        }
+        // Stored items are only marked, they are removed when the update is committed.
+        slotStates[slot] = CEventSchedulerSlotState_PendingRemoval;
+        return 0;
+    }
+
+    removeFromSchedule(slot);
+    numberOfStoredItems--;
+    releaseSlot(slot);
+
+    notifyChanged();
+
+    return 0;
+}
+
+void CEventSchedulerBase::attachStorage(const CEventSchedulerStorage &storage) {
+    numberOfSchedulerItems = storage.capacity;
+    items = storage.items;
+    slotStates = storage.slotStates;
+    slotGenerations = storage.slotGenerations;
+    freeSlots = storage.freeSlots;
+    contentIndexSize = storage.contentIndexSize;
+    contentIndex = storage.contentIndex;
+    schedule = storage.schedule;
+}
+
+// Double the capacity, if the storage policy allows it. The storage policy copies the item slots and the schedule,
+// the free slots and the content index are rebuilt here.
+bool CEventSchedulerBase::growStorage(void) {
+    CEventSchedulerStorage storage;
+    int oldCapacity = numberOfSchedulerItems;
+
+    if (!resizeStorage(storage, oldCapacity < 1 ? 1 : oldCapacity * 2)) {
+        return false;
+    }
+
+    attachStorage(storage);
+
+    for (int slot = numberOfSchedulerItems - 1; slot >= oldCapacity; slot--) {
+        slotGenerations[slot] = 1;
+        slotStates[slot] = CEventSchedulerSlotState_Free;
+        freeSlots[numberOfFreeSlots++] = slot;
+    }
+
+    memset(contentIndex, 0, contentIndexSize * sizeof(uint16_t));
+    for (int slot = 0; slot < oldCapacity; slot++) {
+        if (slotStates[slot] != CEventSchedulerSlotState_Free) {
+            insertIntoContentIndex(slot);
+        }
+    }
+
+    return true;
+}
+
+// Take a free slot, store the item in it and add it to the content index. The caller sets the state of the slot.
+int CEventSchedulerBase::allocateSlot(const CEventSchedulerItem& item) {
+    if (!item.isValid() || item.eventType == CEventSchedulerItemType_OneShot) {
+        return -1; // One-shot items are added with addOneShotItem()
+    }
+
+    // NOTE: Items that are removed during an update still take up space until the update is committed.
+    if (numberOfFreeSlots == 0 && !growStorage()) {
+        return -1;
+    }
+
+    int slot = freeSlots[--numberOfFreeSlots];
+    items[slot] = item;
+    insertIntoContentIndex(slot);
+
+    return slot;
+}
+
+// Free the slot. This invalidates all handles to it, by moving on to the next generation.
+void CEventSchedulerBase::releaseSlot(int slot) {
+    removeFromContentIndex(slot);
+
+    items[slot] = CEventSchedulerItem{};
+    slotStates[slot] = CEventSchedulerSlotState_Free;
+    slotGenerations[slot] = (slotGenerations[slot] % maximumSlotGeneration) + 1;
+    freeSlots[numberOfFreeSlots++] = slot;
+}
+
+// Handles hold the generation of the slot in the upper bits, and the slot in the lower 16 bits. A handle is only valid
+// as long as the generation matches, i.e. as long as the slot was not released.
+CEventSchedulerItemHandle CEventSchedulerBase::makeHandle(int slot) {
+    return ((CEventSchedulerItemHandle)slotGenerations[slot] << 16) | slot;
+}
+
+int CEventSchedulerBase::slotForHandle(CEventSchedulerItemHandle handle) {
+    if (handle < 0) {
+        return -1;
+    }
+
+    int slot = handle & 0xffff;
+    if (slot >= numberOfSchedulerItems ||
+        slotGenerations[slot] != (handle >> 16) ||
+        slotStates[slot] == CEventSchedulerSlotState_Free) {
+        return -1;
+    }
+
+    return slot;
+}
+
+// The content index is an open addressing hash table with linear probing, holding slot + 1 (0 marks an empty position).
+void CEventSchedulerBase::insertIntoContentIndex(int slot) {
+    uint16_t mask = contentIndexSize - 1;
+    uint16_t position = hashItemContent(items[slot]) & mask;
+    while (contentIndex[position] != 0) {
+        position = (position + 1) & mask;
+    }
+    contentIndex[position] = slot + 1;
+}
+
+void CEventSchedulerBase::removeFromContentIndex(int slot) {
+    uint16_t mask = contentIndexSize - 1;
+    uint16_t position = hashItemContent(items[slot]) & mask;
+    while (contentIndex[position] != slot + 1) {
+        assert(contentIndex[position] != 0);
+        position = (position + 1) & mask;
+    }
+
+    // Close the gap, by moving back the entries after it that would otherwise not be found anymore.
+    uint16_t gap = position;
+    for (position = (position + 1) & mask; contentIndex[position] != 0; position = (position + 1) & mask) {
+        uint16_t home = hashItemContent(items[contentIndex[position] - 1]) & mask;
+        if (((position - home) & mask) >= ((position - gap) & mask)) {
+            contentIndex[gap] = contentIndex[position];
+            gap = position;
+        }
+    }
+    contentIndex[gap] = 0;
+}
+
+// The local time for a GMT timestamp, by the time zone or by the fixed secondsFromGMT. Within the span of the last
+// lookup in the time zone, this needs no search.
+time_t CEventSchedulerBase::localTimeForGMT(time_t timestampGMT) {
+    if (timeZone == nullptr) {
+        return timestampGMT + secondsFromGMT;
+    }
+
+    if (timestampGMT < timeZoneSpan.fromGMT || timestampGMT >= timeZoneSpan.untilGMT) {
+        timeZone->getSpan(timestampGMT, timeZoneSpan);
+    }
+
+    time_t localTime = timestampGMT + timeZoneSpan.secondsFromGMT;
+    return (localTime > timeZoneSpan.minimumLocalTime) ? localTime : timeZoneSpan.minimumLocalTime;
+}
+
+// The first moment at which it is localTime, see CEventSchedulerTimeZone::gmtForLocalTime().
+time_t CEventSchedulerBase::gmtForLocalTime(time_t localTime) {
+    if (timeZone == nullptr) {
+        return localTime - secondsFromGMT;
+    }
 
-    // std::cout << "  localTime: " << localTime << " (secondsFromGMT: " << secondsFromGMT << ")\n";
+    // Past the beginning of the span of the last lookup, and before its end, the offset is the one of the span.
+    time_t timestampGMT = localTime - timeZoneSpan.secondsFromGMT;
+    if (timestampGMT > timeZoneSpan.fromGMT && timestampGMT < timeZoneSpan.untilGMT && localTime > timeZoneSpan.minimumLocalTime) {
+        return timestampGMT;
+    }
+
+    return timeZone->gmtForLocalTime(localTime);
+}
+
+// The beginning of the week, Sunday 00:00, in local time.
+time_t CEventSchedulerBase::calculateLocalBeginningOfWeek(time_t timestampGMT) {
+    time_t localTime = localTimeForGMT(timestampGMT);
+
+    EVENT_SCHEDULER_TRACE_VERBOSE("localTime: %lld (timestampGMT: %lld)", (long long)localTime, (long long)timestampGMT);
 
     time_t daysSinceEpoch = localTime / secondsInDay;
     time_t secondsIntoDay = localTime % secondsInDay;
 
     if ((localTime < 0) && (secondsIntoDay != 0)) { daysSinceEpoch--; }
 
-    // std::cout << "  daysSinceEpoch: " << daysSinceEpoch << "\n";
-    // std::cout << "  secondsIntoDay: " << secondsIntoDay << "\n";
+    EVENT_SCHEDULER_TRACE_VERBOSE("daysSinceEpoch: %lld, secondsIntoDay: %lld", (long long)daysSinceEpoch, (long long)secondsIntoDay);
 
     CEventSchedulerWeekDay weekDay = calculateWeekDay(timestampGMT);
     time_t startOfWeekDay = daysSinceEpoch - ((time_t)weekDay - 1);
     time_t startOfWeekInLocaltime = startOfWeekDay * secondsInDay;
 
-    // std::cout << "  weekDay: " << weekDay << "\n";
-    // std::cout << "  startOfWeekDay: " << startOfWeekDay << "\n";
-    // std::cout << "  startOfWeekInLocaltime: " << startOfWeekInLocaltime << "\n";
+    EVENT_SCHEDULER_TRACE_VERBOSE("weekDay: %d, startOfWeekDay: %lld, startOfWeekInLocaltime: %lld", (int)weekDay, (long long)startOfWeekDay, (long long)startOfWeekInLocaltime);
+
+    return startOfWeekInLocaltime;
+}
 
-    // std::cout << "  result: " << startOfWeekInLocaltime - secondsFromGMT << "\n";
+int CEventSchedulerBase::calculateBeginningOfWeekInSeconds(time_t timestampGMT) {
+    time_t startOfWeekInGMT = gmtForLocalTime(calculateLocalBeginningOfWeek(timestampGMT));
 
-    return startOfWeekInLocaltime - secondsFromGMT;
+    EVENT_SCHEDULER_TRACE_VERBOSE("result: %lld", (long long)startOfWeekInGMT);
+
+    return startOfWeekInGMT;
 }
 
-int CEventScheduler::calculateBeginningOfDayInSeconds(time_t timestampGMT) {
-    time_t localTime = timestampGMT + secondsFromGMT;
+int CEventSchedulerBase::calculateBeginningOfDayInSeconds(time_t timestampGMT) {
+    time_t localTime = localTimeForGMT(timestampGMT);
 
     time_t daysSinceEpoch = localTime / secondsInDay;
     time_t secondsIntoDay = localTime % secondsInDay;
@@ -261,31 +1084,35 @@ int CEventScheduler::calculateBeginningOfDayInSeconds(time_t timestampGMT) {
 
     time_t startOfDayInLocalTime = daysSinceEpoch * secondsInDay;
 
-    return startOfDayInLocalTime - secondsFromGMT;
+    return gmtForLocalTime(startOfDayInLocalTime);
+}
+
+int CEventSchedulerBase::calculateMinutesFromBeginningOfWeek(time_t timestampGMT) {
+    return ((int)calculateWeekDay(timestampGMT) - 1) * minutesInDay + calculateMinutesFromBeginningOfDay(timestampGMT);
 }
 
-int CEventScheduler::calculateMinutesFromBeginningOfDay(time_t timestampGMT) {
+int CEventSchedulerBase::calculateMinutesFromBeginningOfDay(time_t timestampGMT) {
     int minutesIntoDay = calculateSecondsFromBeginningOfDay(timestampGMT) / 60;
 
-    // std::cout << "minutesFromBeginningOfDay: " << minutesIntoDay << " (timestampGMT: " << timestampGMT << ")\n";
+    EVENT_SCHEDULER_TRACE_VERBOSE("minutesFromBeginningOfDay: %d (timestampGMT: %lld)", minutesIntoDay, (long long)timestampGMT);
     
     return minutesIntoDay;
 }
 
-int CEventScheduler::calculateSecondsFromBeginningOfDay(time_t timestampGMT) {
-    time_t localTime = timestampGMT + secondsFromGMT;
+int CEventSchedulerBase::calculateSecondsFromBeginningOfDay(time_t timestampGMT) {
+    time_t localTime = localTimeForGMT(timestampGMT);
 
     time_t secondsIntoDay = localTime % secondsInDay;
 
     if (secondsIntoDay < 0) { secondsIntoDay += secondsInDay; }
 
-    // std::cout << "secondsFromBeginningOfDay: " << secondsIntoDay << " (timestampGMT: " << timestampGMT << ")\n";
+    EVENT_SCHEDULER_TRACE_VERBOSE("secondsFromBeginningOfDay: %lld (timestampGMT: %lld)", (long long)secondsIntoDay, (long long)timestampGMT);
 
     return secondsIntoDay;
 }
 
-CEventSchedulerWeekDay CEventScheduler::calculateWeekDay(time_t timestampGMT) {
-    time_t localTime = timestampGMT + secondsFromGMT;
+CEventSchedulerWeekDay CEventSchedulerBase::calculateWeekDay(time_t timestampGMT) {
+    time_t localTime = localTimeForGMT(timestampGMT);
 
     time_t daysSinceEpoch = localTime / secondsInDay;
     if ((localTime < 0) && ((localTime % secondsInDay) > 0))    { // Timestamp can be negative, fix number of days for that case.
@@ -299,83 +1126,256 @@ CEventSchedulerWeekDay CEventScheduler::calculateWeekDay(time_t timestampGMT) {
     return static_cast<CEventSchedulerWeekDay>(weekDay);
 }
 
-time_t CEventScheduler::sunrise(time_t timestampGMT) {
+time_t CEventSchedulerBase::sunrise(time_t timestampGMT) {
     time_t beginningOfDayInGMT = calculateBeginningOfDayInSeconds(timestampGMT);
-    // std::cout << "beginning of day: " << beginningOfDayInGMT << "\n";
+    EVENT_SCHEDULER_TRACE_VERBOSE("beginning of day: %lld", (long long)beginningOfDayInGMT);
     time_t sunriseTime, sunsetTime;
 
-    sunriseCalculator.sunRiseAndSetForTimestamp(beginningOfDayInGMT, 0, sunriseTime, sunsetTime);
+    sunRiseAndSetForDay(beginningOfDayInGMT, sunriseTime, sunsetTime);
 
-    // std::cout << "sunrise/sunset: " << sunriseTime << " - " << sunsetTime << "\n";
+    EVENT_SCHEDULER_TRACE_VERBOSE("sunrise/sunset: %lld - %lld", (long long)sunriseTime, (long long)sunsetTime);
     return sunriseTime;
 }
 
-time_t CEventScheduler::sunset(time_t timestampGMT) {
+time_t CEventSchedulerBase::sunset(time_t timestampGMT) {
     time_t beginningOfDayInGMT = calculateBeginningOfDayInSeconds(timestampGMT);
     time_t sunriseTime, sunsetTime;
 
-    sunriseCalculator.sunRiseAndSetForTimestamp(beginningOfDayInGMT, 0, sunriseTime, sunsetTime);
+    sunRiseAndSetForDay(beginningOfDayInGMT, sunriseTime, sunsetTime);
 
     return sunsetTime;
 }
 
-// Sort all items in ascending order by week day and time offset. Invalid items are moved to the end of the list.
-void CEventScheduler::sortItems(void) {
-    qsort(items, sizeof(items) / sizeof(items[0]), sizeof(items[0]), qsortCompareEventSchedulerItems);
+// Share a sunrise/sunset cache with other schedulers. The cache must outlive the scheduler. Pass nullptr to stop
+// using it.
+void CEventSchedulerBase::setSolarTableCache(CSolarTableCache *cache) {
+    solarTableCache = cache;
+}
+
+// Count into the given metrics, or stop counting with nullptr. The metrics can be shared between schedulers, and must
+// outlive them.
+void CEventSchedulerBase::setMetrics(CEventSchedulerMetrics *metrics) {
+    this->metrics = metrics;
+}
+
+// Select the exact or fast sunrise calculation. A solar table cache that is shared with schedulers in the other mode
+// would mix both, so use a cache per mode.
+void CEventSchedulerBase::setSunriseCalculatorMode(CSunriseCalculatorMode mode) {
+    sunriseCalculator.setMode(mode);
+    for (int day = 0; day < daysInWeek; day++) {
+        solarDays[day].isValid = false;
+    }
+    recalculateAllActivationTimes();
+}
+
+// Get the sunrise and sunset for the local day that starts at beginningOfDayGMT. Each week day has its own entry in
+// solarDays, so a whole week of items only calculates each day once.
+void CEventSchedulerBase::sunRiseAndSetForDay(time_t beginningOfDayGMT, time_t &sunRise, time_t &sunSet) {
+    CEventSchedulerSolarDay &solarDay = solarDays[calculateWeekDay(beginningOfDayGMT) - 1];
+
+    if (!solarDay.isValid || solarDay.beginningOfDayGMT != beginningOfDayGMT) {
+        EVENT_SCHEDULER_METRICS_COUNT(metrics, CEventSchedulerCounter_SolarCalculations);
+        if (solarTableCache != nullptr) {
+            solarTableCache->sunRiseAndSetForDay(sunriseCalculator, beginningOfDayGMT, solarDay.sunRise, solarDay.sunSet);
+        } else {
+            sunriseCalculator.sunRiseAndSetForTimestamp(beginningOfDayGMT, 0, solarDay.sunRise, solarDay.sunSet);
+        }
+        solarDay.beginningOfDayGMT = beginningOfDayGMT;
+        solarDay.isValid = true;
+    }
+
+    sunRise = solarDay.sunRise;
+    sunSet = solarDay.sunSet;
+}
+
+// Replace all items with items that already have their activation times, in the order of the compiled schedule, e.g.
+// from a snapshot file. The items go back into the slots they were in, so that items that activate in the same minute
+// stay in the same order. Nothing is sorted or recalculated, the items activate exactly as they did when they were saved.
+int CEventSchedulerBase::restoreSchedule(const CEventSchedulerItem *itemsInScheduleOrder, const uint16_t *slotsInScheduleOrder, int numberOfItems, time_t secondsFromGMT, uint32_t randomSeed, time_t localBeginningOfWeek) {
+    if (updateInProgress || numberOfItems < 0 || numberOfItems > CEventSchedulerStorage::maximumCapacity) {
+        return -1;
+    }
+
+    int numberOfSlotsNeeded = numberOfItems;
+    for (int index = 0; index < numberOfItems; index++) {
+        numberOfSlotsNeeded = std::max(numberOfSlotsNeeded, slotsInScheduleOrder[index] + 1);
+    }
+    while (numberOfSchedulerItems < numberOfSlotsNeeded) {
+        if (!growStorage()) {
+            return -1; // No space left
+        }
+    }
+
+    // Like resetItems(), without telling anyone yet.
+    numberOfStoredItems = 0;
+    for (int slot = 0; slot < numberOfSchedulerItems; slot++) {
+        if (slotStates[slot] != CEventSchedulerSlotState_Free) {
+            slotGenerations[slot] = (slotGenerations[slot] % maximumSlotGeneration) + 1;
+        }
+        items[slot] = CEventSchedulerItem();
+        slotStates[slot] = CEventSchedulerSlotState_Free;
+    }
+    memset(contentIndex, 0, contentIndexSize * sizeof(uint16_t));
+
+    for (int index = 0; index < numberOfItems; index++) {
+        const CEventSchedulerItem &item = itemsInScheduleOrder[index];
+        int slot = slotsInScheduleOrder[index];
+        if (!item.isValid() || item.eventType == CEventSchedulerItemType_OneShot || slotStates[slot] != CEventSchedulerSlotState_Free) {
+            resetItems();
+            return -1; // Not a weekly item, or two items in one slot
+        }
+        items[slot] = item;
+        insertIntoContentIndex(slot);
+        slotStates[slot] = CEventSchedulerSlotState_Stored;
+        schedule[index].minuteOfWeek = calculateMinuteOfWeek(item);
+        schedule[index].itemIndex = slot;
+        numberOfStoredItems++;
+    }
+
+    // The lowest free slot is used first, like in a new scheduler.
+    numberOfFreeSlots = 0;
+    for (int slot = numberOfSchedulerItems - 1; slot >= 0; slot--) {
+        if (slotStates[slot] == CEventSchedulerSlotState_Free) {
+            freeSlots[numberOfFreeSlots++] = slot;
+        }
+    }
+
+    this->secondsFromGMT = secondsFromGMT;
+    randomGenerator.seed(randomSeed);
+    scheduleLocalBeginningOfWeek = localBeginningOfWeek;
+
+    notifyChanged();
+
+    return 0;
+}
+
+// Rebuild the compiled schedule from scratch and sort it by activation time. Only needed when the activation
+// times of all items have changed, single items are inserted into and removed from the schedule in place.
+void CEventSchedulerBase::compileSchedule(void) {
+    int numberOfEntries = 0;
+    for (int slot = 0; slot < numberOfSchedulerItems; slot++) {
+        if (isVisible(slot)) {
+            schedule[numberOfEntries].minuteOfWeek = calculateMinuteOfWeek(items[slot]);
+            schedule[numberOfEntries].itemIndex = slot;
+            numberOfEntries++;
+        }
+    }
+    assert(numberOfEntries == numberOfStoredItems);
+    EVENT_SCHEDULER_METRICS_COUNT(metrics, CEventSchedulerCounter_ScheduleSorts);
+    std::sort(schedule, schedule + numberOfStoredItems, compareScheduleEntries);
+}
+
+// Insert the item at the given index into the compiled schedule, at the position given by its activation time.
+// The schedule must not contain the item yet, and numberOfStoredItems must already include it.
+void CEventSchedulerBase::insertIntoSchedule(int itemIndex) {
+    CEventSchedulerScheduleEntry newEntry;
+    newEntry.minuteOfWeek = calculateMinuteOfWeek(items[itemIndex]);
+    newEntry.itemIndex = itemIndex;
+
+    int numberOfEntries = numberOfStoredItems - 1;
+    CEventSchedulerScheduleEntry *position = std::lower_bound(schedule, schedule + numberOfEntries, newEntry, compareScheduleEntries);
+
+    memmove(position + 1, position, (schedule + numberOfEntries - position) * sizeof(CEventSchedulerScheduleEntry));
+    *position = newEntry;
+}
+
+// Remove the item at the given index from the compiled schedule, closing the gap it leaves.
+void CEventSchedulerBase::removeFromSchedule(int itemIndex) {
+    int scheduleIndex = findScheduleIndex(itemIndex);
+
+    memmove(schedule + scheduleIndex, schedule + scheduleIndex + 1, (numberOfStoredItems - scheduleIndex - 1) * sizeof(CEventSchedulerScheduleEntry));
+}
+
+// Find the position of the item at the given index in the compiled schedule.
+int CEventSchedulerBase::findScheduleIndex(int itemIndex) {
+    CEventSchedulerScheduleEntry entryToFind;
+    entryToFind.minuteOfWeek = calculateMinuteOfWeek(items[itemIndex]);
+    entryToFind.itemIndex = itemIndex;
+
+    // The entries are ordered by activation time and item index, so this is exactly the entry of the item.
+    CEventSchedulerScheduleEntry *position = std::lower_bound(schedule, schedule + numberOfStoredItems, entryToFind, compareScheduleEntries);
+
+    assert(position < schedule + numberOfStoredItems && position->itemIndex == itemIndex);
+
+    return (int)(position - schedule);
+}
+
+// Items in the slot are part of the schedule.
+bool CEventSchedulerBase::isVisible(int slot) {
+    return slotStates[slot] == CEventSchedulerSlotState_Stored || slotStates[slot] == CEventSchedulerSlotState_PendingRemoval;
+}
+
+uint16_t CEventSchedulerBase::calculateMinuteOfWeek(const CEventSchedulerItem &item) {
+    return (item.activeWeekDay - 1) * minutesInDay + item.activeTimeOffset;
 }
 
 // Update the random offsets of all items. The random offset is used to add some randomness to the activation times
 // of the items. This is, for instance, useful when you want to switch a light on at sunset, but don't want to switch
 // it on at the exact sunset every day, to make it seem as if there is a person at home switching the light on.
 // Same for when to switch the light off.
-void CEventScheduler::recalculateAllActivationTimes(void) {
-    
-    for (int i = 0; i < numberOfStoredItems; i++) {
-        if (items[i].isValid()) {
-            recalculateActivationTime(items[i]);
+void CEventSchedulerBase::recalculateAllActivationTimes(void) {
+
+    recalculateAllActivationTimes(calculateLocalBeginningOfWeek(timeProvider()));
+}
+
+// Recalculate the activation times of all items for the week starting at localBeginningOfWeek (in local time), and
+// compile the schedule for that week.
+void CEventSchedulerBase::recalculateAllActivationTimes(time_t localBeginningOfWeek) {
+    EVENT_SCHEDULER_METRICS_TIME(metrics, CEventSchedulerLatency_Recalculation);
+
+    scheduleLocalBeginningOfWeek = localBeginningOfWeek;
+
+    for (int slot = 0; slot < numberOfSchedulerItems; slot++) {
+        if (isVisible(slot)) {
+            recalculateActivationTime(slot, localBeginningOfWeek);
         }
     }
-    // After recalculating, sort the items again.
-    sortItems();
+    // After recalculating, all activation times have changed, so rebuild the schedule.
+    compileSchedule();
+
+    notifyChanged();
 }
 
-void CEventScheduler::recalculateActivationTime(CEventSchedulerItem &item) {
+// Recalculate the activation time of the item in the slot for the week of the compiled schedule.
+void CEventSchedulerBase::recalculateActivationTime(int slot) {
 
-    // std::cout << "recalculateActivationTime item type: " << item.eventType << ", weekDay: " << item.weekDay << ", timeOffset" << item.timeOffset << "\n";
+    recalculateActivationTime(slot, scheduleLocalBeginningOfWeek);
+}
 
-    time_t timestampGMT = timeProvider();
+// Recalculate the activation time of the item in the slot for the week starting at localBeginningOfThisWeek (in local
+// time). Pass the same localBeginningOfThisWeek when recalculating many items.
+void CEventSchedulerBase::recalculateActivationTime(int slot, time_t localBeginningOfThisWeek) {
+    CEventSchedulerItem &item = items[slot];
 
-    time_t beginningOfThisWeek = calculateBeginningOfWeekInSeconds(timestampGMT);
-    time_t beginningOfDayForItem = beginningOfThisWeek + ((item.weekDay - 1) * secondsInDay);
+    EVENT_SCHEDULER_TRACE_DEBUG("recalculateActivationTime item type: %d, weekDay: %d, timeOffset: %d", (int)item.eventType, (int)item.weekDay, (int)item.timeOffset);
+
+    time_t beginningOfDayForItem = gmtForLocalTime(localBeginningOfThisWeek + ((item.weekDay - 1) * secondsInDay));
     time_t sunriseTime, sunsetTime;
 
-    // std::cout << "timestampGMT: " << timestampGMT << "\n";
-    // std::cout << "beginningOfThisWeek: " << beginningOfThisWeek << "\n";
-    // std::cout << "beginningOfDayForItem: " << beginningOfDayForItem << "\n";
+    EVENT_SCHEDULER_TRACE_DEBUG("localBeginningOfThisWeek: %lld, beginningOfDayForItem: %lld", (long long)localBeginningOfThisWeek, (long long)beginningOfDayForItem);
 
     switch (item.eventType) {
         case CEventSchedulerItemType_Time:
             // For time-based events, we can apply the random offset directly to the time offset.
-            // std::cout << "timeOffset is " << item.timeOffset << "\n";
+            EVENT_SCHEDULER_TRACE_DEBUG("timeOffset is %d", (int)item.timeOffset);
             break;
         case CEventSchedulerItemType_Sunrise:
         case CEventSchedulerItemType_Sunset:
             // For sunrise/sunset-based events, we need to first calculate the sunrise/sunset time
             // for the day of the event and then apply the random offset to that time.
-            sunriseCalculator.sunRiseAndSetForTimestamp(beginningOfDayForItem, 0, sunriseTime, sunsetTime);
-            // std::cout << "set timeOffset to " << (item.eventType == CEventSchedulerItemType_Sunrise ? "sunrise" : "sunset") << " at " << (item.eventType == CEventSchedulerItemType_Sunrise ? sunriseTime : sunsetTime) << "\n";
+            sunRiseAndSetForDay(beginningOfDayForItem, sunriseTime, sunsetTime);
+            EVENT_SCHEDULER_TRACE_DEBUG("set timeOffset to %s at %lld", (item.eventType == CEventSchedulerItemType_Sunrise) ? "sunrise" : "sunset", (long long)((item.eventType == CEventSchedulerItemType_Sunrise) ? sunriseTime : sunsetTime));
             item.timeOffset = calculateMinutesFromBeginningOfDay(item.eventType == CEventSchedulerItemType_Sunrise ? sunriseTime : sunsetTime);
             break;
         default:
             break;
     }
 
-    // std::cout << "randomOffsetMinus is -" << (int)item.randomOffsetMinus << ", randomOffsetPlus is " << (int)item.randomOffsetPlus << "\n";
+    EVENT_SCHEDULER_TRACE_DEBUG("randomOffsetMinus is -%d, randomOffsetPlus is %d", (int)item.randomOffsetMinus, (int)item.randomOffsetPlus);
 
-    std::uniform_int_distribution<int> int_dist(-item.randomOffsetMinus, item.randomOffsetPlus);
-    int randomOffset = int_dist(randomGenerator);
+    int randomOffset = calculateRandomOffset(item, slot, localBeginningOfThisWeek);
 
-    // std::cout << "randomOffset is: " << randomOffset << "\n";
+    EVENT_SCHEDULER_TRACE_DEBUG("randomOffset is: %d", randomOffset);
 
     int16_t newActiveWeekDay = item.weekDay;
     int16_t newActiveTimeOffset = item.timeOffset + randomOffset;
@@ -391,17 +1391,40 @@ void CEventScheduler::recalculateActivationTime(CEventSchedulerItem &item) {
         item.activeWeekDay = static_cast<CEventSchedulerWeekDay>(newActiveWeekDay);
     }
 
-    // std::cout << "timeOffset is " << item.timeOffset << "\n";
-    // std::cout << "weekDay is " << item.weekDay << "\n";
+    EVENT_SCHEDULER_TRACE_DEBUG("timeOffset is %d, weekDay is %d", (int)item.timeOffset, (int)item.weekDay);
+    EVENT_SCHEDULER_TRACE_DEBUG("activeTimeOffset is %d, activeWeekDay is %d", (int)item.activeTimeOffset, (int)item.activeWeekDay);
+}
+
+// The random offset of the item in the slot, in the week that starts at localBeginningOfWeek. The key is everything of
+// the item that the user sets (so not the calculated timeOffset of sunrise and sunset items, nor the activation time),
+// and the slot, so that equal items (e.g. 2 'sunset' items on the same day) get offsets of their own.
+int CEventSchedulerBase::calculateRandomOffset(const CEventSchedulerItem &item, int slot, time_t localBeginningOfWeek) {
+    if (item.randomOffsetMinus == 0 && item.randomOffsetPlus == 0) {
+        return 0;
+    }
+
+    EVENT_SCHEDULER_METRICS_COUNT(metrics, CEventSchedulerCounter_RandomDraws);
+
+    uint64_t key = (uint64_t)item.weekDay |
+                   ((uint64_t)item.eventType << 3) |
+                   ((uint64_t)item.randomOffsetMinus << 5) |
+                   ((uint64_t)item.randomOffsetPlus << 12) |
+                   ((uint64_t)item.userDefined << 19);
+    if (item.eventType == CEventSchedulerItemType_Time) {
+        key |= (uint64_t)item.timeOffset << 23;
+    }
+    key |= (uint64_t)slot << 40;
+
+    // Weeks since the epoch. The weeks start on Sunday, the epoch was on a Thursday.
+    int64_t week = (localBeginningOfWeek / secondsInDay + 4) / daysInWeek;
 
-    // std::cout << "activeTimeOffset is " << item.activeTimeOffset << "\n";
-    // std::cout << "activeWeekDay is " << item.activeWeekDay << "\n";
+    return randomGenerator.uniform(key, week, -item.randomOffsetMinus, item.randomOffsetPlus);
 }
 
-void CEventScheduler::debugPrint() {
+void CEventSchedulerBase::debugPrint() {
     std::cout << "Scheduler has following items:\n";
 
     for (int index = 0; index < numberOfStoredItems; index++) {
-        items[index].debugPrint();
+        items[schedule[index].itemIndex].debugPrint();
     }
 }
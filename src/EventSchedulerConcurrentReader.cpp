@@ -0,0 +1,250 @@
+#include <stdlib.h>
+#include <algorithm>
+#include <thread>
+
+#include "EventSchedulerConcurrentReader.hpp"
+
+CEventSchedulerConcurrentReader::CEventSchedulerConcurrentReader(time_t (*timeProvider)(void)) :
+timeProvider(timeProvider) {
+}
+
+CEventSchedulerConcurrentReader::~CEventSchedulerConcurrentReader() {
+    for (int index = 0; index < 2; index++) {
+        free(snapshots[index].minutesOfWeek);
+        free(snapshots[index].items);
+    }
+}
+
+CEventSchedulerItem CEventSchedulerConcurrentReader::getActiveItem(void) {
+    return getActiveItem(timeProvider());
+}
+
+CEventSchedulerItem CEventSchedulerConcurrentReader::getNextActiveItem(void) {
+    return getNextActiveItem(timeProvider());
+}
+
+CEventSchedulerItem CEventSchedulerConcurrentReader::getActiveItem(time_t timestampGMT) {
+    CEventSchedulerItem activeItem;
+    CEventSchedulerItem nextActiveItem;
+    getActiveAndNextItem(timestampGMT, activeItem, nextActiveItem);
+
+    return activeItem;
+}
+
+CEventSchedulerItem CEventSchedulerConcurrentReader::getNextActiveItem(time_t timestampGMT) {
+    CEventSchedulerItem activeItem;
+    CEventSchedulerItem nextActiveItem;
+    getActiveAndNextItem(timestampGMT, activeItem, nextActiveItem);
+
+    return nextActiveItem;
+}
+
+int CEventSchedulerConcurrentReader::getActiveAndNextItem(CEventSchedulerItem &activeItem, CEventSchedulerItem &nextActiveItem) {
+    return getActiveAndNextItem(timeProvider(), activeItem, nextActiveItem);
+}
+
+int CEventSchedulerConcurrentReader::getActiveAndNextItem(time_t timestampGMT, CEventSchedulerItem &activeItem, CEventSchedulerItem &nextActiveItem) {
+    time_t nextActivationTime;
+
+    int version, readIndicator;
+    const Snapshot &snapshot = enterRead(version, readIndicator);
+
+    lookup(snapshot, timestampGMT, activeItem, nextActiveItem, nextActivationTime);
+
+    leaveRead(version, readIndicator);
+
+    return activeItem.isValid() ? 0 : -1;
+}
+
+time_t CEventSchedulerConcurrentReader::getNextActivationTime(void) {
+    return getNextActivationTime(timeProvider());
+}
+
+time_t CEventSchedulerConcurrentReader::getNextActivationTime(time_t timestampGMT) {
+    CEventSchedulerItem activeItem;
+    CEventSchedulerItem nextActiveItem;
+    time_t nextActivationTime;
+
+    int version, readIndicator;
+    const Snapshot &snapshot = enterRead(version, readIndicator);
+
+    lookup(snapshot, timestampGMT, activeItem, nextActiveItem, nextActivationTime);
+
+    leaveRead(version, readIndicator);
+
+    return nextActivationTime;
+}
+
+uint32_t CEventSchedulerConcurrentReader::getChangeCounter(void) {
+    int version, readIndicator;
+    const Snapshot &snapshot = enterRead(version, readIndicator);
+
+    uint32_t changeCounter = snapshot.changeCounter;
+
+    leaveRead(version, readIndicator);
+
+    return changeCounter;
+}
+
+int CEventSchedulerConcurrentReader::getNumberOfItems(void) {
+    int version, readIndicator;
+    const Snapshot &snapshot = enterRead(version, readIndicator);
+
+    int numberOfItems = snapshot.numberOfEntries;
+
+    leaveRead(version, readIndicator);
+
+    return numberOfItems;
+}
+
+// Announce the reader in the read indicator of the current version, and return the published snapshot. The
+// snapshot stays valid until leaveRead().
+const CEventSchedulerConcurrentReader::Snapshot &CEventSchedulerConcurrentReader::enterRead(int &version, int &readIndicator) {
+    readIndicator = readIndicatorForThread();
+    version = readIndicatorVersion.load();
+    readIndicators[version][readIndicator].numberOfReaders.fetch_add(1);
+
+    return snapshots[publishedSnapshot.load()];
+}
+
+void CEventSchedulerConcurrentReader::leaveRead(int version, int readIndicator) {
+    readIndicators[version][readIndicator].numberOfReaders.fetch_sub(1);
+}
+
+// Returns the snapshot that is not published, with room for the given number of entries, or nullptr if there is no
+// memory left. No reader uses it: they all left it before the previous endPublish() returned.
+CEventSchedulerConcurrentReader::Snapshot *CEventSchedulerConcurrentReader::beginPublish(int numberOfEntries) {
+    Snapshot &snapshot = snapshots[1 - publishedSnapshot.load()];
+
+    if (numberOfEntries > snapshot.capacity) {
+        uint16_t *newMinutesOfWeek = static_cast<uint16_t *>(realloc(snapshot.minutesOfWeek, numberOfEntries * sizeof(uint16_t)));
+        if (newMinutesOfWeek == nullptr) {
+            return nullptr;
+        }
+        snapshot.minutesOfWeek = newMinutesOfWeek;
+
+        CEventSchedulerItem *newItems = static_cast<CEventSchedulerItem *>(realloc(snapshot.items, numberOfEntries * sizeof(CEventSchedulerItem)));
+        if (newItems == nullptr) {
+            return nullptr;
+        }
+        snapshot.items = newItems;
+
+        snapshot.capacity = numberOfEntries;
+    }
+
+    snapshot.numberOfEntries = numberOfEntries;
+
+    return &snapshot;
+}
+
+// Publish the snapshot that was filled, then wait until no reader can be using the previous one anymore. New readers
+// announce themselves in the other version of the read indicators, so waiting for each version in turn ends.
+void CEventSchedulerConcurrentReader::endPublish(void) {
+    publishedSnapshot.store(1 - publishedSnapshot.load());
+
+    int version = readIndicatorVersion.load();
+    waitForReaders(1 - version);
+    readIndicatorVersion.store(1 - version);
+    waitForReaders(version);
+}
+
+void CEventSchedulerConcurrentReader::waitForReaders(int version) {
+    for (int readIndicator = 0; readIndicator < numberOfReadIndicators; readIndicator++) {
+        while (readIndicators[version][readIndicator].numberOfReaders.load() != 0) {
+            std::this_thread::yield();
+        }
+    }
+}
+
+// Each thread always uses the same read indicator, the threads are spread over them in the order they first read.
+int CEventSchedulerConcurrentReader::readIndicatorForThread(void) {
+    static std::atomic<int> numberOfThreads{0};
+    static thread_local int readIndicator = numberOfThreads.fetch_add(1) % numberOfReadIndicators;
+
+    return readIndicator;
+}
+
+// The same lookup as CEventSchedulerBase::getActiveAndNextItem() and getNextActivationTime(), on a snapshot.
+void CEventSchedulerConcurrentReader::lookup(const Snapshot &snapshot, time_t timestampGMT, CEventSchedulerItem &activeItem, CEventSchedulerItem &nextActiveItem, time_t &nextActivationTime) {
+    const time_t secondsInDay = 24 * 60 * 60;
+    const time_t secondsInWeek = 7 * secondsInDay;
+    const int numberOfEntries = snapshot.numberOfEntries;
+
+    // The time zone is shared and does not change, so it can be used from any thread (without the span of the last
+    // lookup, which belongs to the scheduler).
+    const CEventSchedulerTimeZone *timeZone = snapshot.timeZone;
+    auto gmtForLocalTime = [&](time_t localTime) {
+        return (timeZone != nullptr) ? timeZone->gmtForLocalTime(localTime) : localTime - snapshot.secondsFromGMT;
+    };
+
+    // The week starts on Sunday 00:00 local time, and the epoch was on a Thursday.
+    time_t localTime = (timeZone != nullptr) ? timeZone->localTimeForGMT(timestampGMT) : timestampGMT + snapshot.secondsFromGMT;
+    time_t daysSinceEpoch = localTime / secondsInDay;
+    if ((localTime < 0) && ((localTime % secondsInDay) != 0)) { daysSinceEpoch--; }
+    int daysIntoWeek = (int)(((daysSinceEpoch + 4) % 7 + 7) % 7);
+    time_t localBeginningOfWeek = (daysSinceEpoch - daysIntoWeek) * secondsInDay;
+    uint16_t minuteOfWeek = (uint16_t)((localTime - localBeginningOfWeek) / 60);
+
+    time_t activationTime = -1;
+
+    activeItem = CEventSchedulerItem{};
+    nextActiveItem = CEventSchedulerItem{};
+    nextActivationTime = -1;
+
+    if (numberOfEntries > 0) {
+        int found = (int)(std::upper_bound(snapshot.minutesOfWeek, snapshot.minutesOfWeek + numberOfEntries, minuteOfWeek) - snapshot.minutesOfWeek);
+
+        // Between the last activation of the week before and the first entry, or between the last entry and the first
+        // activation of the week after, the time is as good as in the week of the snapshot.
+        if (localBeginningOfWeek == snapshot.localBeginningOfWeek - secondsInWeek && timestampGMT >= snapshot.lastTimeOfPreviousWeek) {
+            localBeginningOfWeek = snapshot.localBeginningOfWeek;
+            found = 0;
+        } else if (localBeginningOfWeek == snapshot.localBeginningOfWeek + secondsInWeek && timestampGMT < snapshot.firstTimeOfNextWeek) {
+            localBeginningOfWeek = snapshot.localBeginningOfWeek;
+            found = numberOfEntries;
+        }
+        bool isSnapshotWeek = (localBeginningOfWeek == snapshot.localBeginningOfWeek);
+
+        if (found > 0) {
+            activeItem = snapshot.items[found - 1];
+            activationTime = gmtForLocalTime(localBeginningOfWeek + (time_t)snapshot.minutesOfWeek[found - 1] * 60);
+        } else if (isSnapshotWeek) {
+            activeItem = snapshot.lastItemOfPreviousWeek;
+            activationTime = snapshot.lastTimeOfPreviousWeek;
+        } else {
+            activeItem = snapshot.items[numberOfEntries - 1];
+            activationTime = gmtForLocalTime(localBeginningOfWeek - secondsInWeek + (time_t)snapshot.minutesOfWeek[numberOfEntries - 1] * 60);
+        }
+
+        if (found < numberOfEntries) {
+            nextActiveItem = snapshot.items[found];
+            nextActivationTime = gmtForLocalTime(localBeginningOfWeek + (time_t)snapshot.minutesOfWeek[found] * 60);
+        } else if (isSnapshotWeek) {
+            nextActiveItem = snapshot.firstItemOfNextWeek;
+            nextActivationTime = snapshot.firstTimeOfNextWeek;
+        } else {
+            nextActiveItem = snapshot.items[0];
+            nextActivationTime = gmtForLocalTime(localBeginningOfWeek + secondsInWeek + (time_t)snapshot.minutesOfWeek[0] * 60);
+        }
+    }
+
+    // The first one-shot item has activated if its time has come, also if the scheduler did not get to it yet.
+    time_t lastOneShotTime = snapshot.lastOneShotTime;
+    CEventSchedulerItem lastOneShotItem = snapshot.lastOneShotItem;
+    time_t nextOneShotTime = snapshot.nextOneShotTime;
+
+    if (nextOneShotTime >= 0 && nextOneShotTime <= timestampGMT && nextOneShotTime <= timeProvider()) {
+        lastOneShotTime = nextOneShotTime;
+        lastOneShotItem = snapshot.nextOneShotItem;
+        nextOneShotTime = -1;
+    }
+
+    if (lastOneShotTime >= 0 && lastOneShotTime <= timestampGMT && lastOneShotTime >= activationTime) {
+        activeItem = lastOneShotItem;
+    }
+
+    if (nextOneShotTime > timestampGMT && (nextActivationTime < 0 || nextOneShotTime <= nextActivationTime)) {
+        nextActiveItem = snapshot.nextOneShotItem;
+        nextActivationTime = nextOneShotTime;
+    }
+}
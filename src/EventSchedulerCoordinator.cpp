@@ -0,0 +1,336 @@
+#include <stdlib.h>
+
+#include "EventSchedulerCoordinator.hpp"
+
+CEventSchedulerCoordinator::CEventSchedulerCoordinator(CEventSchedulerTransitionCallback callback, void *context) :
+callback(callback),
+context(context),
+running(false),
+numberOfWakeUps(0) {
+}
+
+CEventSchedulerCoordinator::~CEventSchedulerCoordinator() {
+    stop();
+
+    for (int id = 0; id < numberOfRegistrations; id++) {
+        if (registration(id).scheduler != nullptr) {
+            registration(id).scheduler->setChangeListener(nullptr, nullptr);
+        }
+    }
+    for (int block = 0; block < numberOfRegistrationBlocks; block++) {
+        delete[] registrationBlocks[block];
+    }
+    free(registrationBlocks);
+    free(heap);
+}
+
+int CEventSchedulerCoordinator::addScheduler(CEventSchedulerBase &scheduler) {
+    int id = firstFreeRegistration;
+
+    if (id >= 0) {
+        firstFreeRegistration = registration(id).next;
+    } else {
+        if (numberOfRegistrations == numberOfRegistrationBlocks * registrationsPerBlock) {
+            Registration **newRegistrationBlocks = static_cast<Registration **>(realloc(registrationBlocks, (numberOfRegistrationBlocks + 1) * sizeof(Registration *)));
+            if (newRegistrationBlocks == nullptr) {
+                return -1; // No memory left
+            }
+            registrationBlocks = newRegistrationBlocks;
+            registrationBlocks[numberOfRegistrationBlocks++] = new Registration[registrationsPerBlock];
+        }
+        id = numberOfRegistrations++;
+    }
+
+    Registration &newRegistration = registration(id);
+    newRegistration.scheduler = &scheduler;
+    newRegistration.coordinator = this;
+    newRegistration.id = id;
+    newRegistration.heapPosition = -1;
+    newRegistration.next = -1;
+    newRegistration.isChanged = false;
+    newRegistration.isFirstActivation = true;
+    newRegistration.previousActiveItem = CEventSchedulerItem();
+
+    scheduler.setChangeListener(schedulerChanged, &newRegistration);
+    numberOfSchedulers++;
+
+    // Looked at on the next round, which calls the callback with the active item.
+    markChanged(newRegistration);
+    wakeUp();
+
+    return id;
+}
+
+int CEventSchedulerCoordinator::removeScheduler(int schedulerId) {
+    if (schedulerId < 0 || schedulerId >= numberOfRegistrations || registration(schedulerId).scheduler == nullptr) {
+        return -1; // Not in the coordinator
+    }
+
+    Registration &oldRegistration = registration(schedulerId);
+    oldRegistration.scheduler->setChangeListener(nullptr, nullptr);
+    oldRegistration.scheduler = nullptr;
+    removeFromHeap(oldRegistration);
+    numberOfSchedulers--;
+
+    // A registration in the list of changed ones is freed when it comes out of that list.
+    if (!oldRegistration.isChanged) {
+        oldRegistration.next = firstFreeRegistration;
+        firstFreeRegistration = schedulerId;
+    }
+
+    return 0;
+}
+
+int CEventSchedulerCoordinator::getNumberOfSchedulers(void) {
+    return numberOfSchedulers;
+}
+
+int CEventSchedulerCoordinator::run(void) {
+    if (!waiter.isValid()) {
+        return -1;
+    }
+    if (running.exchange(true)) {
+        return -1; // Already running
+    }
+
+    runLoop();
+
+    return 0;
+}
+
+void CEventSchedulerCoordinator::runLoop(void) {
+    bool timerExpired = false;
+    time_t nextActivationTime = -1;
+
+    while (running) {
+        {
+            std::lock_guard<std::mutex> lock(schedulerMutex);
+
+            time_t timestampGMT = time(nullptr);
+
+            // time() can still be a second behind when the timer expires, see CEventSchedulerRunner::run().
+            if (timerExpired && timestampGMT < nextActivationTime) {
+                timestampGMT = nextActivationTime;
+            }
+
+            nextActivationTime = processDue(timestampGMT);
+        }
+
+        if (running) {
+            timerExpired = waiter.waitUntil(nextActivationTime);
+            numberOfWakeUps++;
+        }
+    }
+}
+
+int CEventSchedulerCoordinator::start(void) {
+    if (!waiter.isValid()) {
+        return -1;
+    }
+    if (running || thread.joinable()) {
+        return -1; // Already running
+    }
+
+    // Running before the thread exists, so that a stop() right after this always ends it.
+    running = true;
+    thread = std::thread([this]() { runLoop(); });
+
+    return 0;
+}
+
+void CEventSchedulerCoordinator::stop(void) {
+    running = false;
+    wakeUp();
+
+    if (thread.joinable() && thread.get_id() != std::this_thread::get_id()) {
+        thread.join();
+    }
+}
+
+void CEventSchedulerCoordinator::wakeUp(void) {
+    waiter.wakeUp();
+}
+
+time_t CEventSchedulerCoordinator::processDue(time_t timestampGMT) {
+    // The schedulers that changed, and the new ones, may have a different active item now.
+    while (firstChangedRegistration >= 0) {
+        Registration &changedRegistration = registration(firstChangedRegistration);
+        firstChangedRegistration = changedRegistration.next;
+        changedRegistration.isChanged = false;
+
+        if (changedRegistration.scheduler == nullptr) {
+            // Removed while it was in the list
+            changedRegistration.next = firstFreeRegistration;
+            firstFreeRegistration = changedRegistration.id;
+            continue;
+        }
+
+        activate(changedRegistration, timestampGMT, false);
+    }
+
+    // The activations that are due, in order of time. Every scheduler moves to an activation after timestampGMT, so
+    // this ends.
+    while (heapSize > 0 && heap[0].nextActivationTime <= timestampGMT) {
+        activate(registration(heap[0].registration), timestampGMT, true);
+    }
+
+    return getNextActivationTime();
+}
+
+time_t CEventSchedulerCoordinator::getNextActivationTime(void) {
+    return (heapSize > 0) ? heap[0].nextActivationTime : -1;
+}
+
+std::mutex &CEventSchedulerCoordinator::getSchedulerMutex(void) {
+    return schedulerMutex;
+}
+
+uint32_t CEventSchedulerCoordinator::getNumberOfWakeUps(void) {
+    return numberOfWakeUps;
+}
+
+uint32_t CEventSchedulerCoordinator::getNumberOfCallbacks(void) {
+    return numberOfCallbacks;
+}
+
+CEventSchedulerCoordinator::Registration &CEventSchedulerCoordinator::registration(int id) {
+    return registrationBlocks[id / registrationsPerBlock][id % registrationsPerBlock];
+}
+
+void CEventSchedulerCoordinator::markChanged(Registration &changedRegistration) {
+    if (!changedRegistration.isChanged) {
+        changedRegistration.isChanged = true;
+        changedRegistration.next = firstChangedRegistration;
+        firstChangedRegistration = changedRegistration.id;
+    }
+}
+
+// Call the callback if the scheduler has a new active item (or the same item activated again), and move the
+// scheduler to its next activation time in the heap.
+void CEventSchedulerCoordinator::activate(Registration &activeRegistration, time_t timestampGMT, bool activationReached) {
+    CEventSchedulerBase *scheduler = activeRegistration.scheduler;
+
+    CEventSchedulerItem activeItem;
+    CEventSchedulerItem nextActiveItem;
+    scheduler->getActiveAndNextItem(timestampGMT, activeItem, nextActiveItem);
+
+    if (activeRegistration.isFirstActivation || activationReached || !(activeItem == activeRegistration.previousActiveItem)) {
+        activeRegistration.previousActiveItem = activeItem;
+        activeRegistration.isFirstActivation = false;
+        numberOfCallbacks++;
+        callback(*scheduler, activeItem, nextActiveItem, timestampGMT, context);
+
+        if (activeRegistration.scheduler != scheduler) {
+            return; // Removed by the callback
+        }
+    }
+
+    if (!setHeapTime(activeRegistration, scheduler->getNextActivationTime(timestampGMT))) {
+        // No memory left to put it in the heap, try again on the next round.
+        markChanged(activeRegistration);
+    }
+}
+
+bool CEventSchedulerCoordinator::setHeapTime(Registration &heapRegistration, time_t nextActivationTime) {
+    if (nextActivationTime < 0) {
+        removeFromHeap(heapRegistration);
+        return true;
+    }
+
+    int position = heapRegistration.heapPosition;
+    if (position < 0) {
+        if (heapSize == heapCapacity) {
+            int newCapacity = (heapCapacity < 64) ? 64 : heapCapacity * 2;
+            HeapEntry *newHeap = static_cast<HeapEntry *>(realloc(heap, newCapacity * sizeof(HeapEntry)));
+            if (newHeap == nullptr) {
+                return false;
+            }
+            heap = newHeap;
+            heapCapacity = newCapacity;
+        }
+        position = heapSize++;
+    }
+
+    HeapEntry entry;
+    entry.nextActivationTime = nextActivationTime;
+    entry.registration = heapRegistration.id;
+    placeInHeap(position, entry);
+
+    siftUp(position);
+    siftDown(heapRegistration.heapPosition);
+
+    return true;
+}
+
+// Fill the hole with the last entry, which may have to move up or down from there.
+void CEventSchedulerCoordinator::removeFromHeap(Registration &heapRegistration) {
+    int position = heapRegistration.heapPosition;
+    if (position < 0) {
+        return;
+    }
+    heapRegistration.heapPosition = -1;
+
+    heapSize--;
+    if (position == heapSize) {
+        return;
+    }
+
+    HeapEntry last = heap[heapSize];
+    placeInHeap(position, last);
+    siftUp(position);
+    siftDown(registration(last.registration).heapPosition);
+}
+
+void CEventSchedulerCoordinator::siftUp(int position) {
+    HeapEntry entry = heap[position];
+
+    while (position > 0) {
+        int parent = (position - 1) / heapArity;
+        if (heap[parent].nextActivationTime <= entry.nextActivationTime) {
+            break;
+        }
+        placeInHeap(position, heap[parent]);
+        position = parent;
+    }
+
+    placeInHeap(position, entry);
+}
+
+void CEventSchedulerCoordinator::siftDown(int position) {
+    HeapEntry entry = heap[position];
+
+    while (true) {
+        int firstChild = position * heapArity + 1;
+        if (firstChild >= heapSize) {
+            break;
+        }
+
+        int lastChild = (firstChild + heapArity < heapSize) ? firstChild + heapArity : heapSize;
+        int smallestChild = firstChild;
+        for (int child = firstChild + 1; child < lastChild; child++) {
+            if (heap[child].nextActivationTime < heap[smallestChild].nextActivationTime) {
+                smallestChild = child;
+            }
+        }
+
+        if (heap[smallestChild].nextActivationTime >= entry.nextActivationTime) {
+            break;
+        }
+        placeInHeap(position, heap[smallestChild]);
+        position = smallestChild;
+    }
+
+    placeInHeap(position, entry);
+}
+
+void CEventSchedulerCoordinator::placeInHeap(int position, const HeapEntry &entry) {
+    heap[position] = entry;
+    registration(entry.registration).heapPosition = position;
+}
+
+void CEventSchedulerCoordinator::schedulerChanged(CEventSchedulerBase & /* scheduler */, void *context) {
+    Registration *changedRegistration = static_cast<Registration *>(context);
+
+    changedRegistration->coordinator->markChanged(*changedRegistration);
+    changedRegistration->coordinator->wakeUp();
+}
@@ -0,0 +1,168 @@
+#include "EventSchedulerDispatcher.hpp"
+
+CEventSchedulerStrand::CEventSchedulerStrand(CEventSchedulerDispatcher &dispatcher, int queueCapacity) :
+dispatcher(dispatcher),
+transitions(new CEventSchedulerTransition[queueCapacity]),
+queueCapacity(queueCapacity) {
+}
+
+CEventSchedulerStrand::~CEventSchedulerStrand() {
+    delete[] transitions;
+}
+
+void CEventSchedulerStrand::setAction(uint8_t userDefined, CEventSchedulerActionHandler handler, void *context) {
+    if (userDefined >= numberOfActions) {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(dispatcher.mutex);
+    actions[userDefined].handler = handler;
+    actions[userDefined].context = context;
+}
+
+int CEventSchedulerStrand::post(const CEventSchedulerTransition &transition) {
+    std::lock_guard<std::mutex> lock(dispatcher.mutex);
+
+    if (numberOfTransitions == queueCapacity || dispatcher.isStopping) {
+        numberOfRejectedTransitions++;
+        return -1; // Queue full
+    }
+
+    transitions[(firstTransition + numberOfTransitions) % queueCapacity] = transition;
+    numberOfTransitions++;
+
+    if (!isScheduled) {
+        dispatcher.makeReady(this);
+    }
+
+    return 0;
+}
+
+int CEventSchedulerStrand::getNumberOfQueuedTransitions(void) {
+    std::lock_guard<std::mutex> lock(dispatcher.mutex);
+    return numberOfTransitions;
+}
+
+uint32_t CEventSchedulerStrand::getNumberOfRejectedTransitions(void) {
+    std::lock_guard<std::mutex> lock(dispatcher.mutex);
+    return numberOfRejectedTransitions;
+}
+
+CEventSchedulerDispatcher::CEventSchedulerDispatcher(int numberOfThreads, int queueCapacity) :
+threads(nullptr),
+numberOfThreads(numberOfThreads < 1 ? 1 : numberOfThreads),
+queueCapacity(queueCapacity < 1 ? 1 : queueCapacity) {
+    threads = new std::thread[this->numberOfThreads];
+    for (int index = 0; index < this->numberOfThreads; index++) {
+        threads[index] = std::thread([this]() { workerLoop(); });
+    }
+}
+
+// Handles what is still queued, then stops the workers.
+CEventSchedulerDispatcher::~CEventSchedulerDispatcher() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        isStopping = true;
+    }
+    workAvailable.notify_all();
+
+    for (int index = 0; index < numberOfThreads; index++) {
+        threads[index].join();
+    }
+    delete[] threads;
+
+    while (firstStrand != nullptr) {
+        CEventSchedulerStrand *strand = firstStrand;
+        firstStrand = strand->nextStrand;
+        delete strand;
+    }
+}
+
+CEventSchedulerStrand *CEventSchedulerDispatcher::createStrand(void) {
+    CEventSchedulerStrand *strand = new CEventSchedulerStrand(*this, queueCapacity);
+
+    std::lock_guard<std::mutex> lock(mutex);
+    strand->nextStrand = firstStrand;
+    firstStrand = strand;
+
+    return strand;
+}
+
+void CEventSchedulerDispatcher::waitUntilIdle(void) {
+    std::unique_lock<std::mutex> lock(mutex);
+    workDone.wait(lock, [this]() { return firstReady == nullptr && numberOfBusyWorkers == 0; });
+}
+
+void CEventSchedulerDispatcher::runnerCallback(CEventSchedulerBase &scheduler, const CEventSchedulerItem &activeItem, const CEventSchedulerItem &nextActiveItem, time_t timestampGMT, void *context) {
+    CEventSchedulerTransition transition;
+    transition.scheduler = &scheduler;
+    transition.activeItem = activeItem;
+    transition.nextActiveItem = nextActiveItem;
+    transition.timestampGMT = timestampGMT;
+
+    // NOTE: When the queue is full, the transition is dropped. It is counted in getNumberOfRejectedTransitions().
+    static_cast<CEventSchedulerStrand *>(context)->post(transition);
+}
+
+// Add the strand to the end of the ready list. Must be called with the mutex held.
+void CEventSchedulerDispatcher::makeReady(CEventSchedulerStrand *strand) {
+    strand->isScheduled = true;
+    strand->nextReady = nullptr;
+    if (lastReady != nullptr) {
+        lastReady->nextReady = strand;
+    } else {
+        firstReady = strand;
+    }
+    lastReady = strand;
+
+    workAvailable.notify_one();
+}
+
+void CEventSchedulerDispatcher::workerLoop(void) {
+    std::unique_lock<std::mutex> lock(mutex);
+
+    while (true) {
+        workAvailable.wait(lock, [this]() { return firstReady != nullptr || isStopping; });
+        if (firstReady == nullptr) {
+            return; // Stopping, and nothing left to do
+        }
+
+        // Take the strand out of the ready list. It stays scheduled, so no other worker takes it while this one is
+        // handling its transitions, which keeps them in order.
+        CEventSchedulerStrand *strand = firstReady;
+        firstReady = strand->nextReady;
+        if (firstReady == nullptr) {
+            lastReady = nullptr;
+        }
+        numberOfBusyWorkers++;
+
+        for (int turn = 0; turn < transitionsPerTurn && strand->numberOfTransitions > 0; turn++) {
+            CEventSchedulerTransition transition = strand->transitions[strand->firstTransition];
+            strand->firstTransition = (strand->firstTransition + 1) % strand->queueCapacity;
+            strand->numberOfTransitions--;
+
+            CEventSchedulerStrand::Action action;
+            if (transition.activeItem.isValid()) {
+                action = strand->actions[transition.activeItem.userDefined];
+            }
+
+            if (action.handler != nullptr) {
+                lock.unlock();
+                action.handler(transition, action.context);
+                lock.lock();
+            }
+        }
+
+        // Back to the end of the ready list if there is more to do, so that the other strands get their turn first.
+        if (strand->numberOfTransitions > 0) {
+            makeReady(strand);
+        } else {
+            strand->isScheduled = false;
+        }
+
+        numberOfBusyWorkers--;
+        if (firstReady == nullptr && numberOfBusyWorkers == 0) {
+            workDone.notify_all();
+        }
+    }
+}
@@ -0,0 +1,676 @@
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "EventSchedulerImporter.hpp"
+
+// How much of a mapped file is parsed before its pages are given back.
+static const size_t releaseInterval = 64 * 1024 * 1024;
+
+CEventSchedulerImporter::CEventSchedulerImporter(CEventSchedulerImporterTenantResolver resolver, void *context, int batchSize, int maximumOpenBatches) :
+resolver(resolver),
+context(context),
+batchSize(batchSize > 0 ? batchSize : 1),
+maximumOpenBatches(maximumOpenBatches > 0 ? maximumOpenBatches : 1) {
+    batches = static_cast<Batch *>(calloc(this->maximumOpenBatches, sizeof(Batch)));
+    for (int index = 0; index < this->maximumOpenBatches; index++) {
+        batches[index].tenantIndex = -1;
+        batches[index].items = static_cast<CEventSchedulerItem *>(malloc(this->batchSize * sizeof(CEventSchedulerItem)));
+        batches[index].lineNumbers = static_cast<uint64_t *>(malloc(this->batchSize * sizeof(uint64_t)));
+    }
+}
+
+CEventSchedulerImporter::~CEventSchedulerImporter() {
+    for (int index = 0; index < maximumOpenBatches; index++) {
+        free(batches[index].items);
+        free(batches[index].lineNumbers);
+    }
+    free(batches);
+}
+
+void CEventSchedulerImporter::setReplaceItems(bool replaceItems) {
+    this->replaceItems = replaceItems;
+}
+
+int CEventSchedulerImporter::importFile(const char *path, CEventSchedulerImportFormat_Value format) {
+    int fileDescriptor = open(path, O_RDONLY);
+    if (fileDescriptor < 0) {
+        return -1;
+    }
+
+    struct stat fileStatus;
+    if (fstat(fileDescriptor, &fileStatus) != 0) {
+        close(fileDescriptor);
+        return -1;
+    }
+
+    size_t size = (size_t)fileStatus.st_size;
+    if (size == 0) {
+        close(fileDescriptor);
+        return importBuffer("", 0, format);
+    }
+
+    void *mapped = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fileDescriptor, 0);
+    close(fileDescriptor); // The mapping keeps the file open
+    if (mapped == MAP_FAILED) {
+        return -1;
+    }
+    madvise(mapped, size, MADV_SEQUENTIAL);
+
+    const char *data = static_cast<const char *>(mapped);
+    size_t pageSize = (size_t)sysconf(_SC_PAGESIZE);
+    size_t released = 0;
+
+    beginImport(format);
+
+    // In parts, to give back the pages of each part when it has been parsed. A part ends at the end of a line.
+    size_t offset = 0;
+    while (offset < size) {
+        size_t partSize = (size - offset > releaseInterval) ? releaseInterval : size - offset;
+        size_t used = importLines(data + offset, partSize, offset + partSize == size);
+
+        if (used == 0) {
+            // A line that is longer than a part, which is still a line.
+            const char *endOfLine = static_cast<const char *>(memchr(data + offset, '\n', size - offset));
+            size_t lineSize = (endOfLine != nullptr) ? (size_t)(endOfLine - (data + offset)) : size - offset;
+            lineNumber++;
+            importLine(data + offset, lineSize);
+            used = (endOfLine != nullptr) ? lineSize + 1 : lineSize;
+        }
+        offset += used;
+
+        size_t releasable = (offset / pageSize) * pageSize;
+        if (releasable > released) {
+            madvise(const_cast<char *>(data) + released, releasable - released, MADV_DONTNEED);
+            released = releasable;
+        }
+    }
+
+    endImport();
+
+    munmap(mapped, size);
+
+    return 0;
+}
+
+int CEventSchedulerImporter::importStream(int fileDescriptor, CEventSchedulerImportFormat_Value format) {
+    char *buffer = static_cast<char *>(malloc(streamChunkSize));
+    if (buffer == nullptr) {
+        return -1;
+    }
+
+    beginImport(format);
+
+    size_t size = 0;
+    bool isSkippingLine = false;    // The rest of a line that did not fit
+    bool isEnd = false;
+    int result = 0;
+    while (!isEnd) {
+        ssize_t numberOfRead = read(fileDescriptor, buffer + size, streamChunkSize - size);
+        if (numberOfRead < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            result = -1;
+            break;
+        }
+        size += (size_t)numberOfRead;
+        isEnd = (numberOfRead == 0);
+
+        size_t start = 0;
+        if (isSkippingLine) {
+            const char *endOfLine = static_cast<const char *>(memchr(buffer, '\n', size));
+            if (endOfLine == nullptr) {
+                size = 0;
+                continue;
+            }
+            start = (size_t)(endOfLine - buffer) + 1;
+            isSkippingLine = false;
+        }
+
+        size_t used = start + importLines(buffer + start, size - start, isEnd);
+        memmove(buffer, buffer + used, size - used);
+        size -= used;
+
+        if (size == streamChunkSize) {
+            lineNumber++;
+            numberOfRows++;
+            addError(-1, lineNumber, CEventSchedulerImportError_LineTooLong);
+            isSkippingLine = true;
+            size = 0;
+        }
+    }
+
+    endImport();
+    free(buffer);
+
+    return result;
+}
+
+int CEventSchedulerImporter::importBuffer(const char *data, size_t size, CEventSchedulerImportFormat_Value format) {
+    beginImport(format);
+    importLines(data, size, true);
+    endImport();
+
+    return 0;
+}
+
+int CEventSchedulerImporter::getNumberOfReports(void) {
+    return (int)tenants.size();
+}
+
+const CEventSchedulerImportReport &CEventSchedulerImporter::getReport(int index) {
+    return tenants[index].report;
+}
+
+uint64_t CEventSchedulerImporter::getNumberOfRows(void) {
+    return numberOfRows;
+}
+
+uint64_t CEventSchedulerImporter::getNumberOfImportedItems(void) {
+    return numberOfImportedItems;
+}
+
+uint64_t CEventSchedulerImporter::getNumberOfErrors(void) {
+    return numberOfErrors;
+}
+
+void CEventSchedulerImporter::reset(void) {
+    tenantIndexes.clear();
+    tenants.clear();
+    lastTenantIndex = -1;
+    numberOfRows = 0;
+    numberOfImportedItems = 0;
+    numberOfErrors = 0;
+}
+
+const char *CEventSchedulerImporter::errorAsString(CEventSchedulerImportError_Value error) {
+    switch (error) {
+        case CEventSchedulerImportError_Syntax: return "Syntax";
+        case CEventSchedulerImportError_WeekDay: return "WeekDay";
+        case CEventSchedulerImportError_EventType: return "EventType";
+        case CEventSchedulerImportError_TimeOffset: return "TimeOffset";
+        case CEventSchedulerImportError_RandomOffset: return "RandomOffset";
+        case CEventSchedulerImportError_UserDefined: return "UserDefined";
+        case CEventSchedulerImportError_LineTooLong: return "LineTooLong";
+        case CEventSchedulerImportError_UnknownTenant: return "UnknownTenant";
+        case CEventSchedulerImportError_Scheduler: return "Scheduler";
+        default: return "Invalid";
+    }
+}
+
+void CEventSchedulerImporter::beginImport(CEventSchedulerImportFormat_Value format) {
+    this->format = format;
+    lineNumber = 0;
+}
+
+// Hand over the batches that are still open. The tenants are the same in the next import, so are kept.
+void CEventSchedulerImporter::endImport(void) {
+    for (int index = 0; index < maximumOpenBatches; index++) {
+        if (batches[index].tenantIndex >= 0) {
+            flushBatch(batches[index]);
+        }
+    }
+}
+
+// Import the complete lines, and return how much of the data they were. If isLast, the data ends with a line without
+// a newline.
+size_t CEventSchedulerImporter::importLines(const char *data, size_t size, bool isLast) {
+    size_t offset = 0;
+
+    while (offset < size) {
+        const char *line = data + offset;
+        const char *endOfLine = static_cast<const char *>(memchr(line, '\n', size - offset));
+        if (endOfLine == nullptr) {
+            if (!isLast) {
+                break;
+            }
+            endOfLine = data + size;
+        }
+
+        lineNumber++;
+        importLine(line, (size_t)(endOfLine - line));
+        offset = (size_t)(endOfLine - data) + ((endOfLine < data + size) ? 1 : 0);
+    }
+
+    return offset;
+}
+
+void CEventSchedulerImporter::importLine(const char *line, size_t size) {
+    Field trimmed = trim(line, size);
+    if (trimmed.size == 0 || trimmed.data[0] == '#') {
+        return;
+    }
+
+    if (format == CEventSchedulerImportFormat_Automatic) {
+        format = (trimmed.data[0] == '{') ? CEventSchedulerImportFormat_JSONLines : CEventSchedulerImportFormat_CSV;
+    }
+
+    Row row = {};
+    bool isSplit = (format == CEventSchedulerImportFormat_JSONLines) ? splitJSON(trimmed.data, trimmed.size, row) : splitCSV(trimmed.data, trimmed.size, row);
+
+    // The header of a CSV file.
+    if (format == CEventSchedulerImportFormat_CSV && isSplit && equalsIgnoringCase(row.tenant, "tenant") && equalsIgnoringCase(row.weekDay, "weekDay")) {
+        return;
+    }
+
+    numberOfRows++;
+
+    if (!isSplit || row.tenant.size == 0) {
+        addError(-1, lineNumber, CEventSchedulerImportError_Syntax);
+        return;
+    }
+
+    int tenantIndex = tenantForRow(row.tenant);
+    Tenant &tenant = tenants[tenantIndex];
+    tenant.report.numberOfRows++;
+
+    if (tenant.report.scheduler == nullptr) {
+        addError(tenantIndex, lineNumber, CEventSchedulerImportError_UnknownTenant);
+        return;
+    }
+
+    CEventSchedulerItem item;
+    CEventSchedulerImportError_Value error;
+    if (!parseItem(row, item, error)) {
+        addError(tenantIndex, lineNumber, error);
+        return;
+    }
+
+    addToBatch(tenantIndex, item);
+}
+
+// tenant,weekDay,eventType,timeOffset,randomOffsetMinus,randomOffsetPlus,userDefined. Fields can be in double quotes.
+bool CEventSchedulerImporter::splitCSV(const char *line, size_t size, Row &row) {
+    Field *fields[] = { &row.tenant, &row.weekDay, &row.eventType, &row.timeOffset, &row.randomOffsetMinus, &row.randomOffsetPlus, &row.userDefined };
+    const int numberOfFields = sizeof(fields) / sizeof(fields[0]);
+
+    const char *end = line + size;
+    const char *position = line;
+    for (int index = 0; index < numberOfFields; index++) {
+        const char *separator = static_cast<const char *>(memchr(position, ',', end - position));
+        bool isLastField = (index == numberOfFields - 1);
+        if ((separator == nullptr) != isLastField) {
+            return false; // Too few or too many fields
+        }
+        if (separator == nullptr) {
+            separator = end;
+        }
+
+        Field field = trim(position, separator - position);
+        if (field.size >= 2 && field.data[0] == '"' && field.data[field.size - 1] == '"') {
+            field.data++;
+            field.size -= 2;
+        }
+        *fields[index] = field;
+
+        position = separator + 1;
+    }
+
+    return true;
+}
+
+// A flat object with string and number values. Names that are not known are skipped.
+bool CEventSchedulerImporter::splitJSON(const char *line, size_t size, Row &row) {
+    const char *end = line + size;
+    const char *position = line;
+
+    auto skipSpaces = [&]() {
+        while (position < end && (*position == ' ' || *position == '\t')) {
+            position++;
+        }
+    };
+    auto readString = [&](Field &field) {
+        position++; // The opening quote
+        const char *start = position;
+        while (position < end && *position != '"') {
+            if (*position == '\\') {
+                return false; // No escapes
+            }
+            position++;
+        }
+        if (position == end) {
+            return false;
+        }
+        field.data = start;
+        field.size = position - start;
+        position++; // The closing quote
+        return true;
+    };
+
+    skipSpaces();
+    if (position == end || *position != '{') {
+        return false;
+    }
+    position++;
+
+    skipSpaces();
+    if (position < end && *position == '}') {
+        return false; // Nothing in it
+    }
+
+    while (true) {
+        Field name, value;
+
+        skipSpaces();
+        if (position == end || *position != '"' || !readString(name)) {
+            return false;
+        }
+        skipSpaces();
+        if (position == end || *position != ':') {
+            return false;
+        }
+        position++;
+        skipSpaces();
+        if (position == end) {
+            return false;
+        }
+        if (*position == '"') {
+            if (!readString(value)) {
+                return false;
+            }
+        } else {
+            const char *start = position;
+            while (position < end && *position != ',' && *position != '}' && *position != ' ' && *position != '\t') {
+                position++;
+            }
+            value.data = start;
+            value.size = position - start;
+            if (value.size == 0) {
+                return false;
+            }
+        }
+
+        if (equalsIgnoringCase(name, "tenant")) { row.tenant = value; }
+        else if (equalsIgnoringCase(name, "weekDay")) { row.weekDay = value; }
+        else if (equalsIgnoringCase(name, "eventType")) { row.eventType = value; }
+        else if (equalsIgnoringCase(name, "timeOffset")) { row.timeOffset = value; }
+        else if (equalsIgnoringCase(name, "randomOffsetMinus")) { row.randomOffsetMinus = value; }
+        else if (equalsIgnoringCase(name, "randomOffsetPlus")) { row.randomOffsetPlus = value; }
+        else if (equalsIgnoringCase(name, "userDefined")) { row.userDefined = value; }
+
+        skipSpaces();
+        if (position == end) {
+            return false;
+        }
+        if (*position == '}') {
+            position++;
+            break;
+        }
+        if (*position != ',') {
+            return false;
+        }
+        position++;
+    }
+
+    skipSpaces();
+    return position == end;
+}
+
+// Check the fields against the bit fields of CEventSchedulerItem.
+bool CEventSchedulerImporter::parseItem(const Row &row, CEventSchedulerItem &item, CEventSchedulerImportError_Value &error) {
+    CEventSchedulerWeekDay weekDay;
+    if (!parseWeekDay(row.weekDay, weekDay)) {
+        error = CEventSchedulerImportError_WeekDay;
+        return false;
+    }
+
+    CEventSchedulerItemType eventType;
+    if (!parseEventType(row.eventType, eventType)) {
+        error = CEventSchedulerImportError_EventType;
+        return false;
+    }
+
+    int timeOffset = 0;
+    if (row.timeOffset.size > 0 || eventType == CEventSchedulerItemType_Time) {
+        if (!parseTimeOffset(row.timeOffset, timeOffset)) {
+            error = CEventSchedulerImportError_TimeOffset;
+            return false;
+        }
+    }
+
+    int randomOffsetMinus = 0;
+    int randomOffsetPlus = 0;
+    if ((row.randomOffsetMinus.size > 0 && (!parseNumber(row.randomOffsetMinus, randomOffsetMinus) || randomOffsetMinus > 127)) ||
+        (row.randomOffsetPlus.size > 0 && (!parseNumber(row.randomOffsetPlus, randomOffsetPlus) || randomOffsetPlus > 127))) {
+        error = CEventSchedulerImportError_RandomOffset;
+        return false;
+    }
+
+    int userDefined = 0;
+    if (row.userDefined.size > 0 && (!parseNumber(row.userDefined, userDefined) || userDefined > 15)) {
+        error = CEventSchedulerImportError_UserDefined;
+        return false;
+    }
+
+    item = CEventSchedulerItem(weekDay, eventType, (unsigned int)timeOffset, randomOffsetMinus, randomOffsetPlus, (uint8_t)userDefined);
+
+    return true;
+}
+
+// The rows of a tenant usually come together, so the last tenant is tried first.
+int CEventSchedulerImporter::tenantForRow(Field tenant) {
+    if (lastTenantIndex >= 0) {
+        const std::string &lastTenant = tenants[lastTenantIndex].report.tenant;
+        if (lastTenant.size() == tenant.size && memcmp(lastTenant.data(), tenant.data, tenant.size) == 0) {
+            return lastTenantIndex;
+        }
+    }
+
+    auto found = tenantIndexes.find(std::string_view(tenant.data, tenant.size));
+    if (found != tenantIndexes.end()) {
+        lastTenantIndex = found->second;
+        return lastTenantIndex;
+    }
+
+    tenants.emplace_back();
+    Tenant &newTenant = tenants.back();
+    newTenant.report.tenant.assign(tenant.data, tenant.size);
+    newTenant.report.scheduler = resolver(newTenant.report.tenant.c_str(), tenant.size, context);
+    newTenant.report.numberOfRows = 0;
+    newTenant.report.numberOfImportedItems = 0;
+    newTenant.report.numberOfErrors = 0;
+    newTenant.batchIndex = -1;
+    newTenant.isReplaced = false;
+
+    lastTenantIndex = (int)tenants.size() - 1;
+    tenantIndexes.emplace(std::string_view(newTenant.report.tenant), lastTenantIndex);
+
+    return lastTenantIndex;
+}
+
+// Errors of rows without a tenant only count in the totals.
+void CEventSchedulerImporter::addError(int tenantIndex, uint64_t lineNumber, CEventSchedulerImportError_Value error) {
+    numberOfErrors++;
+
+    if (tenantIndex < 0) {
+        return;
+    }
+
+    CEventSchedulerImportReport &report = tenants[tenantIndex].report;
+    if (report.numberOfErrors < CEventSchedulerImportReport::maximumNumberOfErrors) {
+        report.errors[report.numberOfErrors].lineNumber = lineNumber;
+        report.errors[report.numberOfErrors].error = error;
+    }
+    report.numberOfErrors++;
+}
+
+void CEventSchedulerImporter::addToBatch(int tenantIndex, const CEventSchedulerItem &item) {
+    Tenant &tenant = tenants[tenantIndex];
+
+    if (tenant.batchIndex < 0) {
+        // A free batch, or else the one that was used longest ago.
+        int batchIndex = 0;
+        for (int index = 0; index < maximumOpenBatches; index++) {
+            if (batches[index].tenantIndex < 0) {
+                batchIndex = index;
+                break;
+            }
+            if (batches[index].lastUse < batches[batchIndex].lastUse) {
+                batchIndex = index;
+            }
+        }
+        if (batches[batchIndex].tenantIndex >= 0) {
+            flushBatch(batches[batchIndex]);
+        }
+        batches[batchIndex].tenantIndex = tenantIndex;
+        batches[batchIndex].numberOfItems = 0;
+        tenant.batchIndex = batchIndex;
+    }
+
+    Batch &batch = batches[tenant.batchIndex];
+    batch.items[batch.numberOfItems] = item;
+    batch.lineNumbers[batch.numberOfItems] = lineNumber;
+    batch.numberOfItems++;
+    batch.lastUse = ++numberOfBatchUses;
+
+    if (batch.numberOfItems == batchSize) {
+        flushBatch(batch);
+    }
+}
+
+// Hand the items to the scheduler in one bulk update, and close the batch.
+void CEventSchedulerImporter::flushBatch(Batch &batch) {
+    Tenant &tenant = tenants[batch.tenantIndex];
+    CEventSchedulerBase *scheduler = tenant.report.scheduler;
+
+    // Before the update: removals during an update keep their slots until it is committed.
+    if (replaceItems && !tenant.isReplaced) {
+        scheduler->resetItems();
+        tenant.isReplaced = true;
+    }
+
+    if (scheduler->beginUpdate() == 0) {
+        for (int index = 0; index < batch.numberOfItems; index++) {
+            if (scheduler->addItem(batch.items[index]) >= 0) {
+                tenant.report.numberOfImportedItems++;
+                numberOfImportedItems++;
+            } else {
+                addError(batch.tenantIndex, batch.lineNumbers[index], CEventSchedulerImportError_Scheduler);
+            }
+        }
+
+        scheduler->commitUpdate();
+    } else {
+        for (int index = 0; index < batch.numberOfItems; index++) {
+            addError(batch.tenantIndex, batch.lineNumbers[index], CEventSchedulerImportError_Scheduler);
+        }
+    }
+
+    tenant.batchIndex = -1;
+    batch.tenantIndex = -1;
+    batch.numberOfItems = 0;
+}
+
+bool CEventSchedulerImporter::parseNumber(Field field, int &value) {
+    if (field.size == 0 || field.size > 9) {
+        return false;
+    }
+
+    value = 0;
+    for (size_t index = 0; index < field.size; index++) {
+        if (field.data[index] < '0' || field.data[index] > '9') {
+            return false;
+        }
+        value = value * 10 + (field.data[index] - '0');
+    }
+
+    return true;
+}
+
+bool CEventSchedulerImporter::parseWeekDay(Field field, CEventSchedulerWeekDay &weekDay) {
+    static const char *const names[] = { "Sunday", "Monday", "Tuesday", "Wednesday", "Thursday", "Friday", "Saturday" };
+    static const char *const abbreviations[] = { "Sun", "Mon", "Tue", "Wed", "Thu", "Fri", "Sat" };
+
+    int number;
+    if (parseNumber(field, number)) {
+        if (number < 1 || number > 7) {
+            return false;
+        }
+        weekDay = (CEventSchedulerWeekDay)number;
+        return true;
+    }
+
+    for (int index = 0; index < 7; index++) {
+        if (equalsIgnoringCase(field, names[index]) || equalsIgnoringCase(field, abbreviations[index])) {
+            weekDay = (CEventSchedulerWeekDay)(CEventSchedulerDayNumber_Sunday + index);
+            return true;
+        }
+    }
+
+    return false;
+}
+
+bool CEventSchedulerImporter::parseEventType(Field field, CEventSchedulerItemType &eventType) {
+    int number;
+    if (parseNumber(field, number)) {
+        if (number < CEventSchedulerItemType_Time || number > CEventSchedulerItemType_Sunset) {
+            return false;
+        }
+        eventType = (CEventSchedulerItemType)number;
+        return true;
+    }
+
+    if (equalsIgnoringCase(field, "Time")) { eventType = CEventSchedulerItemType_Time; return true; }
+    if (equalsIgnoringCase(field, "Sunrise")) { eventType = CEventSchedulerItemType_Sunrise; return true; }
+    if (equalsIgnoringCase(field, "Sunset")) { eventType = CEventSchedulerItemType_Sunset; return true; }
+
+    return false;
+}
+
+// Minutes from the beginning of the day, or hh:mm.
+bool CEventSchedulerImporter::parseTimeOffset(Field field, int &timeOffset) {
+    if (field.size == 0) {
+        return false;
+    }
+
+    const char *colon = static_cast<const char *>(memchr(field.data, ':', field.size));
+    if (colon != nullptr) {
+        int hours, minutes;
+        Field hoursField = { field.data, (size_t)(colon - field.data) };
+        Field minutesField = { colon + 1, field.size - hoursField.size - 1 };
+        if (!parseNumber(hoursField, hours) || !parseNumber(minutesField, minutes) || minutesField.size != 2 || hours > 23 || minutes > 59) {
+            return false;
+        }
+        timeOffset = hours * 60 + minutes;
+        return true;
+    }
+
+    return parseNumber(field, timeOffset) && timeOffset < 24 * 60;
+}
+
+bool CEventSchedulerImporter::equalsIgnoringCase(Field field, const char *text) {
+    size_t length = strlen(text);
+    if (field.size != length) {
+        return false;
+    }
+
+    for (size_t index = 0; index < length; index++) {
+        char a = field.data[index];
+        char b = text[index];
+        if (a >= 'A' && a <= 'Z') { a = a - 'A' + 'a'; }
+        if (b >= 'A' && b <= 'Z') { b = b - 'A' + 'a'; }
+        if (a != b) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+CEventSchedulerImporter::Field CEventSchedulerImporter::trim(const char *data, size_t size) {
+    while (size > 0 && (data[0] == ' ' || data[0] == '\t')) {
+        data++;
+        size--;
+    }
+    while (size > 0 && (data[size - 1] == ' ' || data[size - 1] == '\t' || data[size - 1] == '\r')) {
+        size--;
+    }
+
+    return Field{ data, size };
+}
@@ -0,0 +1,655 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <algorithm>
+#include <chrono>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "EventSchedulerJournal.hpp"
+#include "EventSchedulerSnapshot.hpp"
+#include "EventSchedulerTrace.hpp"
+
+static const uint16_t journalVersion = 3;
+static const uint32_t journalByteOrderMark = 0x01020304;
+
+// fdatasync() only writes the data (and the size), not the other metadata of the file, which is all a journal needs.
+static int syncData(int fileDescriptor) {
+#if defined(__APPLE__)
+    return fsync(fileDescriptor);
+#else
+    return fdatasync(fileDescriptor);
+#endif
+}
+
+CEventSchedulerJournal::CEventSchedulerJournal(int maximumCommitDelayMilliseconds, size_t compactionThreshold) :
+maximumCommitDelayMilliseconds(maximumCommitDelayMilliseconds),
+compactionThreshold(compactionThreshold) {
+}
+
+CEventSchedulerJournal::~CEventSchedulerJournal() {
+    close();
+}
+
+int CEventSchedulerJournal::open(CEventSchedulerBase &scheduler, const char *path) {
+    if (this->scheduler != nullptr) {
+        return -1; // Already open
+    }
+
+    snapshotPath = std::string(path) + ".snapshot";
+    journalPath = std::string(path) + ".journal";
+    newJournalPath = std::string(path) + ".journal.new";
+
+    // The snapshot, if there is one. It is always complete, it is renamed into place when it has been written.
+    uint32_t snapshotChecksum = 0;
+    struct stat fileStatus;
+    if (stat(snapshotPath.c_str(), &fileStatus) == 0) {
+        CEventSchedulerSnapshotFile snapshot;
+        if (snapshot.open(snapshotPath.c_str()) != 0 || snapshot.getNumberOfSchedulers() != 1 || snapshot.restore(0, scheduler) != 0) {
+            EVENT_SCHEDULER_TRACE_ERROR("Journal: snapshot %s can not be used", snapshotPath.c_str());
+            return -1;
+        }
+        snapshotChecksum = snapshot.getChecksum();
+    }
+
+    // The journals that continue the snapshot. The new journal is first in line: if it continues the snapshot, the
+    // snapshot of a compaction was written, and the old journal is in it. If the old journal continues the snapshot,
+    // the new journal (if any) has the edits after it.
+    FileHeader header, newHeader;
+    std::vector<Record> records, newRecords;
+    bool hasJournal = readJournal(journalPath.c_str(), header, records) == 0;
+    bool hasNewJournal = readJournal(newJournalPath.c_str(), newHeader, newRecords) == 0;
+
+    if (hasNewJournal && newHeader.snapshotChecksum == snapshotChecksum) {
+        replay(scheduler, newRecords);
+    } else if (hasJournal && header.snapshotChecksum == snapshotChecksum) {
+        replay(scheduler, records);
+        if (hasNewJournal && newHeader.generation == header.generation + 1) {
+            replay(scheduler, newRecords);
+        }
+    } else if (hasJournal || hasNewJournal) {
+        EVENT_SCHEDULER_TRACE_WARNING("Journal: %s does not continue the snapshot, ignored", journalPath.c_str());
+    }
+
+    // Start over from a snapshot of what was recovered, with an empty journal.
+    uint8_t *snapshot;
+    size_t snapshotSize;
+    CEventSchedulerBase *schedulers[] = { &scheduler };
+    if (CEventSchedulerSnapshotFile::encode(schedulers, 1, snapshot, snapshotSize, snapshotChecksum) != 0) {
+        return -1;
+    }
+    int result = CEventSchedulerSnapshotFile::writeEncoded(snapshotPath.c_str(), snapshot, snapshotSize);
+    free(snapshot);
+
+    journalGeneration = (hasJournal ? header.generation : 0) + 1;
+    if (result != 0 || createJournal(journalPath.c_str(), journalGeneration, snapshotChecksum) != 0) {
+        EVENT_SCHEDULER_TRACE_ERROR("Journal: can not write %s", snapshotPath.c_str());
+        return -1;
+    }
+    remove(newJournalPath.c_str());
+
+    this->scheduler = &scheduler;
+    journalSize = sizeof(FileHeader);
+    numberOfAppendedRecords = 0;
+    numberOfCommittedRecords = 0;
+    isFailed = false;
+    isStopping = false;
+    isSyncRequested = false;
+
+    commitThread = std::thread(&CEventSchedulerJournal::commitLoop, this);
+
+    return 0;
+}
+
+void CEventSchedulerJournal::close(void) {
+    if (scheduler == nullptr) {
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        isStopping = true;
+    }
+    commitCondition.notify_one();
+    commitThread.join();
+
+    // The commit thread starts the compaction thread, so it is only known now whether there is one.
+    if (compactionThread.joinable()) {
+        compactionThread.join();
+    }
+
+    ::close(journalDescriptor);
+    journalDescriptor = -1;
+
+    if (updateInProgress) {
+        cancelUpdate();
+    }
+    scheduler = nullptr;
+}
+
+CEventSchedulerItemHandle CEventSchedulerJournal::addItem(const CEventSchedulerItem &item) {
+    CEventSchedulerItemHandle handle = scheduler->addItem(item);
+    if (handle >= 0) {
+        appendItem(RecordType_AddItem, item, scheduler->slotForHandle(handle));
+        if (updateInProgress) {
+            pendingAdds.push_back(PendingAdd{ handle, item });
+        }
+    }
+
+    return handle;
+}
+
+// The item that the scheduler removes is journaled, not the one that was asked for, which only compares equal to it.
+int CEventSchedulerJournal::removeItem(const CEventSchedulerItem &item) {
+    int slot = scheduler->findItemIndex(item, true);
+    if (slot < 0) {
+        return -1; // Item not found
+    }
+    CEventSchedulerItem removedItem = scheduler->items[slot];
+
+    int result = scheduler->removeItem(item);
+    if (result == 0) {
+        appendItem(RecordType_RemoveItem, removedItem, slot);
+    }
+
+    return result;
+}
+
+int CEventSchedulerJournal::removeItem(CEventSchedulerItemHandle handle) {
+    CEventSchedulerItem item = itemForHandle(handle);
+    int slot = scheduler->slotForHandle(handle);
+
+    int result = scheduler->removeItem(handle);
+    if (result == 0) {
+        appendItem(RecordType_RemoveItem, item, slot);
+    }
+
+    return result;
+}
+
+// Journaled as a removal and an addition.
+int CEventSchedulerJournal::updateItem(CEventSchedulerItemHandle handle, const CEventSchedulerItem &item) {
+    CEventSchedulerItem previousItem = itemForHandle(handle);
+    int slot = scheduler->slotForHandle(handle);
+
+    int result = scheduler->updateItem(handle, item);
+    if (result == 0) {
+        appendItem(RecordType_RemoveItem, previousItem, slot);
+        appendItem(RecordType_AddItem, item, slot);
+        for (PendingAdd &pendingAdd : pendingAdds) {
+            if (pendingAdd.handle == handle) {
+                pendingAdd.item = item;
+            }
+        }
+    }
+
+    return result;
+}
+
+int CEventSchedulerJournal::replaceAllItems(const CEventSchedulerItem *newItems, int numberOfNewItems, CEventSchedulerItemHandle *handles) {
+    std::vector<CEventSchedulerItemHandle> newHandles(numberOfNewItems > 0 ? numberOfNewItems : 0);
+    int result = scheduler->replaceAllItems(newItems, numberOfNewItems, newHandles.data());
+    if (result == 0) {
+        if (handles != nullptr) {
+            std::copy(newHandles.begin(), newHandles.end(), handles);
+        }
+
+        std::vector<Record> records;
+        records.reserve(numberOfNewItems + 1);
+        records.push_back(makeRecord(RecordType_ResetItems, nullptr, 0));
+        for (int index = 0; index < numberOfNewItems; index++) {
+            uint8_t payload[CEventSchedulerSnapshotFile::packedItemSize];
+            CEventSchedulerSnapshotFile::packItem(newItems[index], payload);
+            records.push_back(makeRecord(RecordType_AddItem, payload, sizeof(payload), scheduler->slotForHandle(newHandles[index])));
+        }
+        appendRecords(records.data(), records.size());
+    }
+
+    return result;
+}
+
+void CEventSchedulerJournal::resetItems(void) {
+    scheduler->resetItems();
+    pendingAdds.clear();
+
+    Record record = makeRecord(RecordType_ResetItems, nullptr, 0);
+    if (updateInProgress) {
+        updateRecords.push_back(record);
+    } else {
+        appendRecords(&record, 1);
+    }
+}
+
+void CEventSchedulerJournal::setSecondsFromGMT(time_t secondsFromGMT) {
+    scheduler->setSecondsFromGMT(secondsFromGMT);
+
+    uint8_t payload[sizeof(int64_t)];
+    int64_t value = (int64_t)secondsFromGMT;
+    memcpy(payload, &value, sizeof(value));
+
+    Record record = makeRecord(RecordType_SetSecondsFromGMT, payload, sizeof(payload));
+    if (updateInProgress) {
+        updateRecords.push_back(record);
+    } else {
+        appendRecords(&record, 1);
+    }
+}
+
+void CEventSchedulerJournal::setRandomSeed(uint32_t seed) {
+    scheduler->setRandomSeed(seed);
+
+    uint8_t payload[sizeof(uint32_t)];
+    memcpy(payload, &seed, sizeof(seed));
+
+    Record record = makeRecord(RecordType_SetRandomSeed, payload, sizeof(payload));
+    if (updateInProgress) {
+        updateRecords.push_back(record);
+    } else {
+        appendRecords(&record, 1);
+    }
+}
+
+int CEventSchedulerJournal::beginUpdate(void) {
+    if (scheduler->beginUpdate() != 0) {
+        return -1;
+    }
+
+    updateInProgress = true;
+    updateRecords.clear();
+    pendingAdds.clear();
+
+    return 0;
+}
+
+int CEventSchedulerJournal::commitUpdate(void) {
+    if (scheduler->commitUpdate() != 0) {
+        return -1;
+    }
+
+    updateInProgress = false;
+    appendRecords(updateRecords.data(), updateRecords.size());
+    updateRecords.clear();
+    pendingAdds.clear();
+
+    return 0;
+}
+
+void CEventSchedulerJournal::cancelUpdate(void) {
+    scheduler->cancelUpdate();
+
+    updateInProgress = false;
+    updateRecords.clear();
+    pendingAdds.clear();
+}
+
+int CEventSchedulerJournal::sync(void) {
+    std::unique_lock<std::mutex> lock(mutex);
+
+    uint64_t numberOfRecords = numberOfAppendedRecords;
+    isSyncRequested = true;
+    commitCondition.notify_one();
+    committedCondition.wait(lock, [&]() { return numberOfCommittedRecords >= numberOfRecords || isFailed; });
+
+    return isFailed ? -1 : 0;
+}
+
+// Take the snapshot here, on the thread of the scheduler. Writing it is left to the threads of the journal.
+int CEventSchedulerJournal::compact(void) {
+    if (scheduler == nullptr || updateInProgress) {
+        return -1;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (isCompactionRunning || isFailed) {
+            return -1; // Only one at a time
+        }
+    }
+
+    uint8_t *snapshot;
+    size_t snapshotSize;
+    uint32_t snapshotChecksum;
+    CEventSchedulerBase *schedulers[] = { scheduler };
+    if (CEventSchedulerSnapshotFile::encode(schedulers, 1, snapshot, snapshotSize, snapshotChecksum) != 0) {
+        return -1;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        compactionSnapshot = snapshot;
+        compactionSnapshotSize = snapshotSize;
+        compactionSnapshotChecksum = snapshotChecksum;
+        compactionCutRecord = numberOfAppendedRecords;
+        isCompactionStarted = true;
+        isCompactionRunning = true;
+    }
+    commitCondition.notify_one();
+
+    return 0;
+}
+
+size_t CEventSchedulerJournal::getJournalSize(void) {
+    std::lock_guard<std::mutex> lock(mutex);
+
+    return journalSize + pendingRecords.size() * recordSize;
+}
+
+void CEventSchedulerJournal::appendItem(RecordType type, const CEventSchedulerItem &item, int slot) {
+    uint8_t payload[CEventSchedulerSnapshotFile::packedItemSize];
+    CEventSchedulerSnapshotFile::packItem(item, payload);
+
+    Record record = makeRecord(type, payload, sizeof(payload), slot);
+    if (updateInProgress) {
+        updateRecords.push_back(record);
+    } else {
+        appendRecords(&record, 1);
+    }
+}
+
+// Hand the records to the commit thread, and compact when the journal has grown too large.
+void CEventSchedulerJournal::appendRecords(const Record *records, size_t numberOfRecords) {
+    if (numberOfRecords == 0) {
+        return;
+    }
+
+    bool isCompactionNeeded;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        bool wasEmpty = pendingRecords.empty();
+        pendingRecords.insert(pendingRecords.end(), records, records + numberOfRecords);
+        numberOfAppendedRecords += numberOfRecords;
+        if (wasEmpty) {
+            commitCondition.notify_one();
+        }
+        isCompactionNeeded = !isCompactionRunning && journalSize + pendingRecords.size() * recordSize >= compactionThreshold;
+    }
+
+    if (isCompactionNeeded) {
+        compact();
+    }
+}
+
+// The item of a handle, also of an item that was added during the bulk update, which the scheduler does not give yet.
+CEventSchedulerItem CEventSchedulerJournal::itemForHandle(CEventSchedulerItemHandle handle) {
+    for (const PendingAdd &pendingAdd : pendingAdds) {
+        if (pendingAdd.handle == handle) {
+            return pendingAdd.item;
+        }
+    }
+
+    return scheduler->findItem(handle);
+}
+
+CEventSchedulerJournal::Record CEventSchedulerJournal::makeRecord(RecordType type, const uint8_t *payload, size_t payloadSize, int slot) {
+    Record record;
+    memset(&record, 0, sizeof(record));
+    record.type = type;
+    record.slot = (uint16_t)slot;
+    if (payloadSize > 0) {
+        memcpy(record.payload, payload, payloadSize);
+    }
+    record.checksum = CEventSchedulerSnapshotFile::crc32(reinterpret_cast<const uint8_t *>(&record) + sizeof(record.checksum), sizeof(record) - sizeof(record.checksum));
+
+    return record;
+}
+
+bool CEventSchedulerJournal::isValidRecord(const Record &record) {
+    return record.checksum == CEventSchedulerSnapshotFile::crc32(reinterpret_cast<const uint8_t *>(&record) + sizeof(record.checksum), sizeof(record) - sizeof(record.checksum)) &&
+           record.type >= RecordType_AddItem && record.type <= RecordType_SetRandomSeed;
+}
+
+// Wait for records, give others maximumCommitDelay to add theirs, and write them all with one sync.
+void CEventSchedulerJournal::commitLoop(void) {
+    std::unique_lock<std::mutex> lock(mutex);
+
+    while (true) {
+        commitCondition.wait(lock, [&]() { return !pendingRecords.empty() || isCompactionStarted || isStopping; });
+
+        if (!isStopping && !isSyncRequested && !isCompactionStarted) {
+            std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(maximumCommitDelayMilliseconds);
+            commitCondition.wait_until(lock, deadline, [&]() { return isStopping || isSyncRequested || isCompactionStarted; });
+        }
+
+        std::vector<Record> records;
+        records.swap(pendingRecords);
+        uint64_t firstRecord = numberOfCommittedRecords;
+        bool isSwitching = isCompactionStarted;
+        size_t recordsBeforeCut = isSwitching ? (size_t)(compactionCutRecord - firstRecord) : records.size();
+        uint32_t snapshotChecksum = compactionSnapshotChecksum;
+        bool isWriting = !isFailed;
+        isSyncRequested = false;
+        isCompactionStarted = false;
+
+        lock.unlock();
+
+        int result = 0;
+        size_t newJournalSize = 0;
+        if (isWriting) {
+            result = writeRecords(records.data(), recordsBeforeCut);
+            newJournalSize = journalSize + recordsBeforeCut * recordSize;
+
+            // The records after the snapshot go to a new journal, that continues the snapshot.
+            if (result == 0 && isSwitching) {
+                int oldJournalDescriptor = journalDescriptor;
+                result = createJournal(newJournalPath.c_str(), journalGeneration + 1, snapshotChecksum);
+                if (result == 0) {
+                    ::close(oldJournalDescriptor);
+                    journalGeneration++;
+                    newJournalSize = sizeof(FileHeader);
+                }
+            }
+
+            if (result == 0) {
+                result = writeRecords(records.data() + recordsBeforeCut, records.size() - recordsBeforeCut);
+                newJournalSize += (records.size() - recordsBeforeCut) * recordSize;
+            }
+        }
+
+        bool isCompactionThreadStarted = false;
+        if (isSwitching) {
+            if (compactionThread.joinable()) {
+                compactionThread.join();    // The previous one, which has finished
+            }
+            if (isWriting && result == 0) {
+                compactionThread = std::thread(&CEventSchedulerJournal::compactionLoop, this);
+                isCompactionThreadStarted = true;
+            }
+        }
+
+        lock.lock();
+
+        if (isWriting && result == 0) {
+            journalSize = newJournalSize;
+        } else if (isWriting) {
+            EVENT_SCHEDULER_TRACE_ERROR("Journal: writing %s failed (%s), no longer journaling", journalPath.c_str(), strerror(errno));
+            isFailed = true;
+        }
+        if (isSwitching && !isCompactionThreadStarted) {
+            free(compactionSnapshot);
+            compactionSnapshot = nullptr;
+            isCompactionRunning = false;
+        }
+        numberOfCommittedRecords = firstRecord + records.size();
+        committedCondition.notify_all();
+
+        if (isStopping && pendingRecords.empty() && !isCompactionStarted) {
+            break;
+        }
+    }
+}
+
+int CEventSchedulerJournal::writeRecords(const Record *records, size_t numberOfRecords) {
+    if (numberOfRecords == 0) {
+        return 0;
+    }
+
+    const uint8_t *data = reinterpret_cast<const uint8_t *>(records);
+    size_t size = numberOfRecords * recordSize;
+    while (size > 0) {
+        ssize_t written = ::write(journalDescriptor, data, size);
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return -1;
+        }
+        data += written;
+        size -= (size_t)written;
+    }
+
+    return (syncData(journalDescriptor) == 0) ? 0 : -1;
+}
+
+// Write the snapshot, which makes the old journal superfluous, and then let the new journal take its place.
+void CEventSchedulerJournal::compactionLoop(void) {
+    int result = CEventSchedulerSnapshotFile::writeEncoded(snapshotPath.c_str(), compactionSnapshot, compactionSnapshotSize);
+    if (result == 0 && rename(newJournalPath.c_str(), journalPath.c_str()) != 0) {
+        result = -1;
+    }
+    if (result == 0) {
+        result = CEventSchedulerSnapshotFile::syncDirectory(journalPath.c_str());
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+
+    // Another compaction would overwrite the new journal, that is still needed then.
+    if (result != 0) {
+        EVENT_SCHEDULER_TRACE_ERROR("Journal: compacting into %s failed, no longer journaling", snapshotPath.c_str());
+        isFailed = true;
+    }
+    free(compactionSnapshot);
+    compactionSnapshot = nullptr;
+    isCompactionRunning = false;
+    committedCondition.notify_all();
+}
+
+// Create the journal next to the path and rename it into place, so that it never exists without its header. The new
+// journal is kept open for appending.
+int CEventSchedulerJournal::createJournal(const char *path, uint32_t generation, uint32_t snapshotChecksum) {
+    std::string temporaryPath = std::string(path) + ".tmp";
+
+    int fileDescriptor = ::open(temporaryPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_APPEND, 0644);
+    if (fileDescriptor < 0) {
+        return -1;
+    }
+
+    FileHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, "EVSJ", 4);
+    header.version = journalVersion;
+    header.headerSize = sizeof(FileHeader);
+    header.byteOrderMark = journalByteOrderMark;
+    header.generation = generation;
+    header.snapshotChecksum = snapshotChecksum;
+    header.checksum = CEventSchedulerSnapshotFile::crc32(&header, sizeof(header) - sizeof(header.checksum));
+
+    if (::write(fileDescriptor, &header, sizeof(header)) != (ssize_t)sizeof(header) || syncData(fileDescriptor) != 0 ||
+        rename(temporaryPath.c_str(), path) != 0 || CEventSchedulerSnapshotFile::syncDirectory(path) != 0) {
+        ::close(fileDescriptor);
+        remove(temporaryPath.c_str());
+        return -1;
+    }
+
+    journalDescriptor = fileDescriptor;
+
+    return 0;
+}
+
+// Read the header and the complete records. Returns -1 if there is no journal with a valid header.
+int CEventSchedulerJournal::readJournal(const char *path, FileHeader &header, std::vector<Record> &records) {
+    FILE *file = fopen(path, "rb");
+    if (file == nullptr) {
+        return -1;
+    }
+
+    if (fread(&header, sizeof(header), 1, file) != 1 ||
+        memcmp(header.magic, "EVSJ", 4) != 0 ||
+        header.version != journalVersion ||
+        header.headerSize != sizeof(FileHeader) ||
+        header.byteOrderMark != journalByteOrderMark ||
+        header.checksum != CEventSchedulerSnapshotFile::crc32(&header, sizeof(header) - sizeof(header.checksum))) {
+        fclose(file);
+        return -1;
+    }
+
+    // Read in blocks, a journal can hold many records.
+    const size_t recordsPerRead = 4096;
+    records.clear();
+    bool isComplete = true;
+    while (isComplete) {
+        size_t numberOfRecords = records.size();
+        records.resize(numberOfRecords + recordsPerRead);
+        size_t numberOfRead = fread(records.data() + numberOfRecords, recordSize, recordsPerRead, file);
+        records.resize(numberOfRecords + numberOfRead);
+
+        for (size_t index = numberOfRecords; index < records.size(); index++) {
+            if (!isValidRecord(records[index])) {
+                records.resize(index);          // Not completely written before a crash, nothing after it counts
+                isComplete = false;
+                break;
+            }
+        }
+        if (numberOfRead < recordsPerRead) {
+            break;
+        }
+    }
+
+    fclose(file);
+
+    return 0;
+}
+
+// In a single bulk update, so that the schedule is only built once. Setting the offset from GMT or the random seed
+// recalculates everything, so that is done between updates. Items go back into the slot they were added in. Removed
+// items keep their slot until the update is committed, so when an item goes into such a slot, or does not fit, the
+// update is committed first.
+void CEventSchedulerJournal::replay(CEventSchedulerBase &scheduler, const std::vector<Record> &records) {
+    scheduler.beginUpdate();
+
+    for (const Record &record : records) {
+        switch (record.type) {
+            case RecordType_AddItem: {
+                CEventSchedulerItem item = CEventSchedulerSnapshotFile::unpackItem(record.payload);
+                if (record.slot < scheduler.numberOfSchedulerItems && scheduler.slotStates[record.slot] == CEventSchedulerSlotState_PendingRemoval) {
+                    scheduler.commitUpdate();
+                    scheduler.beginUpdate();
+                }
+                if (scheduler.addItemInSlot(item, record.slot) < 0) {
+                    scheduler.commitUpdate();
+                    scheduler.beginUpdate();
+                    scheduler.addItemInSlot(item, record.slot);
+                }
+                break;
+            }
+            case RecordType_RemoveItem:
+                scheduler.removeIdenticalItem(CEventSchedulerSnapshotFile::unpackItem(record.payload), record.slot);
+                break;
+            case RecordType_ResetItems:
+                scheduler.resetItems();
+                break;
+            case RecordType_SetSecondsFromGMT: {
+                int64_t secondsFromGMT;
+                memcpy(&secondsFromGMT, record.payload, sizeof(secondsFromGMT));
+                scheduler.commitUpdate();
+                scheduler.setSecondsFromGMT((time_t)secondsFromGMT);
+                scheduler.beginUpdate();
+                break;
+            }
+            case RecordType_SetRandomSeed: {
+                uint32_t seed;
+                memcpy(&seed, record.payload, sizeof(seed));
+                scheduler.commitUpdate();
+                scheduler.setRandomSeed(seed);
+                scheduler.beginUpdate();
+                break;
+            }
+            default:
+                break;
+        }
+    }
+
+    scheduler.commitUpdate();
+}
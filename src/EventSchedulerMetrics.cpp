@@ -0,0 +1,292 @@
+#include <stdio.h>
+#include <string.h>
+#include <inttypes.h>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#endif
+
+#include "EventSchedulerMetrics.hpp"
+
+CEventSchedulerMetrics::CEventSchedulerMetrics() {
+    reset();
+}
+
+void CEventSchedulerMetrics::recordLatency(CEventSchedulerLatency_Value latency, uint64_t nanoseconds) {
+    Histogram &histogram = latencies[latency];
+
+    histogram.count.fetch_add(1, std::memory_order_relaxed);
+    histogram.sumNanoseconds.fetch_add(nanoseconds, std::memory_order_relaxed);
+    histogram.buckets[CEventSchedulerLatencySnapshot::bucketForValue(nanoseconds)].fetch_add(1, std::memory_order_relaxed);
+
+    uint64_t maximum = histogram.maximumNanoseconds.load(std::memory_order_relaxed);
+    while (nanoseconds > maximum && !histogram.maximumNanoseconds.compare_exchange_weak(maximum, nanoseconds, std::memory_order_relaxed)) {
+    }
+}
+
+void CEventSchedulerMetrics::snapshot(CEventSchedulerMetricsSnapshot &snapshot, bool reset) {
+    for (int counter = 0; counter < CEventSchedulerCounter_Count; counter++) {
+        snapshot.counters[counter] = reset ? counters[counter].exchange(0, std::memory_order_relaxed) : counters[counter].load(std::memory_order_relaxed);
+    }
+
+    for (int latency = 0; latency < CEventSchedulerLatency_Count; latency++) {
+        Histogram &histogram = latencies[latency];
+        CEventSchedulerLatencySnapshot &latencySnapshot = snapshot.latencies[latency];
+
+        latencySnapshot.count = reset ? histogram.count.exchange(0, std::memory_order_relaxed) : histogram.count.load(std::memory_order_relaxed);
+        latencySnapshot.sumNanoseconds = reset ? histogram.sumNanoseconds.exchange(0, std::memory_order_relaxed) : histogram.sumNanoseconds.load(std::memory_order_relaxed);
+        latencySnapshot.maximumNanoseconds = reset ? histogram.maximumNanoseconds.exchange(0, std::memory_order_relaxed) : histogram.maximumNanoseconds.load(std::memory_order_relaxed);
+        for (int bucket = 0; bucket < CEventSchedulerLatencySnapshot::numberOfBuckets; bucket++) {
+            latencySnapshot.buckets[bucket] = reset ? histogram.buckets[bucket].exchange(0, std::memory_order_relaxed) : histogram.buckets[bucket].load(std::memory_order_relaxed);
+        }
+    }
+}
+
+void CEventSchedulerMetrics::reset(void) {
+    for (int counter = 0; counter < CEventSchedulerCounter_Count; counter++) {
+        counters[counter].store(0, std::memory_order_relaxed);
+    }
+
+    for (int latency = 0; latency < CEventSchedulerLatency_Count; latency++) {
+        Histogram &histogram = latencies[latency];
+        histogram.count.store(0, std::memory_order_relaxed);
+        histogram.sumNanoseconds.store(0, std::memory_order_relaxed);
+        histogram.maximumNanoseconds.store(0, std::memory_order_relaxed);
+        for (int bucket = 0; bucket < CEventSchedulerLatencySnapshot::numberOfBuckets; bucket++) {
+            histogram.buckets[bucket].store(0, std::memory_order_relaxed);
+        }
+    }
+}
+
+int CEventSchedulerMetrics::exportToFile(const char *path, CEventSchedulerMetricsFormat_Value format, bool reset) {
+    std::string text = exportSnapshot(format, reset);
+    std::string temporaryPath = std::string(path) + ".tmp";
+
+    FILE *file = fopen(temporaryPath.c_str(), "w");
+    if (file == nullptr) {
+        return -1;
+    }
+
+    bool isWritten = fwrite(text.data(), 1, text.size(), file) == text.size();
+    if (fclose(file) != 0 || !isWritten || rename(temporaryPath.c_str(), path) != 0) {
+        remove(temporaryPath.c_str());
+        return -1;
+    }
+
+    return 0;
+}
+
+int CEventSchedulerMetrics::exportToSocket(const char *socketPath, CEventSchedulerMetricsFormat_Value format, bool reset) {
+#if defined(__unix__) || defined(__APPLE__)
+    struct sockaddr_un address;
+    if (strlen(socketPath) >= sizeof(address.sun_path)) {
+        return -1; // Path too long
+    }
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    strcpy(address.sun_path, socketPath);
+
+    int socketFd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (socketFd < 0) {
+        return -1;
+    }
+
+    // A closed connection must fail the send, not raise SIGPIPE and end the process. Where send() has no
+    // MSG_NOSIGNAL, the socket is told not to raise it.
+#if defined(MSG_NOSIGNAL)
+    const int sendFlags = MSG_NOSIGNAL;
+#else
+    const int sendFlags = 0;
+#if defined(SO_NOSIGPIPE)
+    int noSignalPipe = 1;
+    setsockopt(socketFd, SOL_SOCKET, SO_NOSIGPIPE, &noSignalPipe, sizeof(noSignalPipe));
+#endif
+#endif
+
+    if (connect(socketFd, reinterpret_cast<struct sockaddr *>(&address), sizeof(address)) != 0) {
+        close(socketFd);
+        return -1;
+    }
+
+    // Only take the snapshot (and reset) when it can be sent.
+    std::string text = exportSnapshot(format, reset);
+
+    size_t written = 0;
+    while (written < text.size()) {
+        ssize_t result = send(socketFd, text.data() + written, text.size() - written, sendFlags);
+        if (result <= 0) {
+            close(socketFd);
+            return -1;
+        }
+        written += result;
+    }
+
+    close(socketFd);
+    return 0;
+#else
+    return -1; // No Unix domain sockets
+#endif
+}
+
+const char *CEventSchedulerMetrics::counterName(CEventSchedulerCounter_Value counter) {
+    switch (counter) {
+        case CEventSchedulerCounter_Lookups: return "lookups";
+        case CEventSchedulerCounter_ScheduleSorts: return "schedule_sorts";
+        case CEventSchedulerCounter_SolarCalculations: return "solar_calculations";
+        case CEventSchedulerCounter_RandomDraws: return "random_draws";
+        default: return "invalid";
+    }
+}
+
+const char *CEventSchedulerMetrics::latencyName(CEventSchedulerLatency_Value latency) {
+    switch (latency) {
+        case CEventSchedulerLatency_AddItem: return "add_item";
+        case CEventSchedulerLatency_RemoveItem: return "remove_item";
+        case CEventSchedulerLatency_Lookup: return "lookup";
+        case CEventSchedulerLatency_Recalculation: return "recalculation";
+        default: return "invalid";
+    }
+}
+
+std::string CEventSchedulerMetrics::exportSnapshot(CEventSchedulerMetricsFormat_Value format, bool reset) {
+    CEventSchedulerMetricsSnapshot *metricsSnapshot = new CEventSchedulerMetricsSnapshot;   // About 16 kB, not for the stack
+    snapshot(*metricsSnapshot, reset);
+
+    std::string text = (format == CEventSchedulerMetricsFormat_JSON) ? metricsSnapshot->toJSON() : metricsSnapshot->toPrometheus();
+
+    delete metricsSnapshot;
+    return text;
+}
+
+// Values below subBucketCount each have a bucket of their own. Above that, the bucket is given by the position of the
+// highest bit (the power of two), and the subBucketBits bits below it.
+int CEventSchedulerLatencySnapshot::bucketForValue(uint64_t nanoseconds) {
+    if (nanoseconds < (uint64_t)subBucketCount) {
+        return (int)nanoseconds;
+    }
+
+#if defined(__GNUC__)
+    int highestBit = 63 - __builtin_clzll(nanoseconds);
+#else
+    int highestBit = 63;
+    while ((nanoseconds >> highestBit) == 0) {
+        highestBit--;
+    }
+#endif
+    int shift = highestBit - subBucketBits;
+    int subBucket = (int)((nanoseconds >> shift) & (subBucketCount - 1));
+
+    return (shift + 1) * subBucketCount + subBucket;
+}
+
+uint64_t CEventSchedulerLatencySnapshot::bucketLowerBound(int bucket) {
+    if (bucket < subBucketCount) {
+        return (uint64_t)bucket;
+    }
+
+    int shift = bucket / subBucketCount - 1;
+    return (uint64_t)(subBucketCount + bucket % subBucketCount) << shift;
+}
+
+uint64_t CEventSchedulerLatencySnapshot::bucketUpperBound(int bucket) {
+    if (bucket < subBucketCount) {
+        return (uint64_t)bucket;
+    }
+
+    int shift = bucket / subBucketCount - 1;
+    return bucketLowerBound(bucket) + (((uint64_t)1 << shift) - 1);
+}
+
+uint64_t CEventSchedulerLatencySnapshot::percentile(double fraction) const {
+    if (count == 0) {
+        return 0;
+    }
+
+    uint64_t rank = (uint64_t)(fraction * (double)count + 0.5);
+    if (rank < 1) {
+        rank = 1;
+    }
+
+    uint64_t seen = 0;
+    for (int bucket = 0; bucket < numberOfBuckets; bucket++) {
+        seen += buckets[bucket];
+        if (seen >= rank) {
+            uint64_t upperBound = bucketUpperBound(bucket);
+            return (upperBound < maximumNanoseconds) ? upperBound : maximumNanoseconds;
+        }
+    }
+
+    return maximumNanoseconds;
+}
+
+// Counters become <prefix>_<name>_total, the latencies one histogram <prefix>_latency_seconds with an 'operation'
+// label. Only the buckets that have latencies in them are written, Prometheus does not need the empty ones.
+std::string CEventSchedulerMetricsSnapshot::toPrometheus(const char *prefix) const {
+    std::string text;
+    char line[256];
+
+    for (int counter = 0; counter < CEventSchedulerCounter_Count; counter++) {
+        const char *name = CEventSchedulerMetrics::counterName(static_cast<CEventSchedulerCounter_Value>(counter));
+        snprintf(line, sizeof(line), "# TYPE %s_%s_total counter\n%s_%s_total %" PRIu64 "\n", prefix, name, prefix, name, counters[counter]);
+        text += line;
+    }
+
+    snprintf(line, sizeof(line), "# TYPE %s_latency_seconds histogram\n", prefix);
+    text += line;
+
+    for (int latency = 0; latency < CEventSchedulerLatency_Count; latency++) {
+        const CEventSchedulerLatencySnapshot &latencySnapshot = latencies[latency];
+        const char *name = CEventSchedulerMetrics::latencyName(static_cast<CEventSchedulerLatency_Value>(latency));
+
+        uint64_t cumulativeCount = 0;
+        for (int bucket = 0; bucket < CEventSchedulerLatencySnapshot::numberOfBuckets; bucket++) {
+            if (latencySnapshot.buckets[bucket] == 0) {
+                continue;
+            }
+            cumulativeCount += latencySnapshot.buckets[bucket];
+            snprintf(line, sizeof(line), "%s_latency_seconds_bucket{operation=\"%s\",le=\"%.9g\"} %" PRIu64 "\n",
+                     prefix, name, (double)CEventSchedulerLatencySnapshot::bucketUpperBound(bucket) / 1e9, cumulativeCount);
+            text += line;
+        }
+
+        snprintf(line, sizeof(line), "%s_latency_seconds_bucket{operation=\"%s\",le=\"+Inf\"} %" PRIu64 "\n", prefix, name, latencySnapshot.count);
+        text += line;
+        snprintf(line, sizeof(line), "%s_latency_seconds_sum{operation=\"%s\"} %.9g\n", prefix, name, (double)latencySnapshot.sumNanoseconds / 1e9);
+        text += line;
+        snprintf(line, sizeof(line), "%s_latency_seconds_count{operation=\"%s\"} %" PRIu64 "\n", prefix, name, latencySnapshot.count);
+        text += line;
+    }
+
+    return text;
+}
+
+// The latencies are summarized with their percentiles, in nanoseconds.
+std::string CEventSchedulerMetricsSnapshot::toJSON(void) const {
+    std::string text = "{\"counters\":{";
+    char field[256];
+
+    for (int counter = 0; counter < CEventSchedulerCounter_Count; counter++) {
+        snprintf(field, sizeof(field), "%s\"%s\":%" PRIu64, (counter > 0) ? "," : "",
+                 CEventSchedulerMetrics::counterName(static_cast<CEventSchedulerCounter_Value>(counter)), counters[counter]);
+        text += field;
+    }
+
+    text += "},\"latencies\":{";
+
+    for (int latency = 0; latency < CEventSchedulerLatency_Count; latency++) {
+        const CEventSchedulerLatencySnapshot &latencySnapshot = latencies[latency];
+
+        snprintf(field, sizeof(field), "%s\"%s\":{\"count\":%" PRIu64 ",\"sum_ns\":%" PRIu64 ",\"max_ns\":%" PRIu64
+                 ",\"p50_ns\":%" PRIu64 ",\"p90_ns\":%" PRIu64 ",\"p99_ns\":%" PRIu64 ",\"p999_ns\":%" PRIu64 "}",
+                 (latency > 0) ? "," : "", CEventSchedulerMetrics::latencyName(static_cast<CEventSchedulerLatency_Value>(latency)),
+                 latencySnapshot.count, latencySnapshot.sumNanoseconds, latencySnapshot.maximumNanoseconds,
+                 latencySnapshot.percentile(0.5), latencySnapshot.percentile(0.9), latencySnapshot.percentile(0.99), latencySnapshot.percentile(0.999));
+        text += field;
+    }
+
+    text += "}}\n";
+
+    return text;
+}
@@ -0,0 +1,542 @@
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <algorithm>
+#include <thread>
+
+#include "EventSchedulerPool.hpp"
+#include "SunriseCalculator.hpp"
+
+// Resize an array of one of the pool's tables. The array is left as it was if there is no memory left.
+template <typename T>
+static bool resizeArray(T *&array, int newCapacity) {
+    T *newArray = static_cast<T *>(realloc(array, (size_t)newCapacity * sizeof(T)));
+    if (newArray == nullptr) {
+        return false;
+    }
+    array = newArray;
+    return true;
+}
+
+CEventSchedulerPool::CEventSchedulerPool(time_t (*timeProvider)(void), int initialNumberOfTenants, int initialNumberOfEntries) :
+timeProvider(timeProvider) {
+    tenantCapacity = (initialNumberOfTenants < 1) ? 1 : initialNumberOfTenants;
+    if (!resizeArray(tenantFirstEntries, tenantCapacity) || !resizeArray(tenantNumberOfEntries, tenantCapacity) ||
+        !resizeArray(tenantEntryCapacities, tenantCapacity) || !resizeArray(tenantLocations, tenantCapacity)) {
+        tenantCapacity = 0;
+    }
+
+    if (initialNumberOfEntries > 0) {
+        growEntries(initialNumberOfEntries);
+    }
+
+    rebuildLocationIndex(32);
+
+    randomGenerator.seed(5138008 + timeProvider());
+}
+
+CEventSchedulerPool::~CEventSchedulerPool() {
+    free(tenantFirstEntries);
+    free(tenantNumberOfEntries);
+    free(tenantEntryCapacities);
+    free(tenantLocations);
+    free(minutesOfWeek);
+    free(items);
+    free(locations);
+    free(locationIndex);
+    free(locationMinutesOfWeek);
+}
+
+int CEventSchedulerPool::addTenant(double latitude, double longitude, time_t secondsFromGMT) {
+    if (numberOfTenants == tenantCapacity) {
+        int newCapacity = (tenantCapacity < 16) ? 16 : tenantCapacity * 2;
+        if (!resizeArray(tenantFirstEntries, newCapacity) || !resizeArray(tenantNumberOfEntries, newCapacity) ||
+            !resizeArray(tenantEntryCapacities, newCapacity) || !resizeArray(tenantLocations, newCapacity)) {
+            return -1; // No memory left
+        }
+        tenantCapacity = newCapacity;
+    }
+
+    int location = findOrAddLocation(latitude, longitude, secondsFromGMT);
+    if (location < 0) {
+        return -1; // No memory left
+    }
+
+    int tenant = numberOfTenants++;
+    tenantFirstEntries[tenant] = numberOfEntries;
+    tenantNumberOfEntries[tenant] = 0;
+    tenantEntryCapacities[tenant] = 0;
+    tenantLocations[tenant] = location;
+
+    return tenant;
+}
+
+int CEventSchedulerPool::getNumberOfTenants(void) {
+    return numberOfTenants;
+}
+
+int CEventSchedulerPool::addItem(int tenant, const CEventSchedulerItem &item) {
+    if (tenant < 0 || tenant >= numberOfTenants || !item.isValid() || item.eventType == CEventSchedulerItemType_OneShot) {
+        return -1;
+    }
+    if (!reserveEntries(tenant, tenantNumberOfEntries[tenant] + 1)) {
+        return -1; // No space left
+    }
+
+    Location &location = locations[tenantLocations[tenant]];
+    if (calculateBeginningOfWeek(timeProvider(), location.secondsFromGMT) != location.beginningOfWeekGMT) {
+        calculateSolarDays(tenantLocations[tenant], tenantLocations[tenant] + 1, timeProvider());
+    }
+
+    CEventSchedulerItem newItem = item;
+    recalculateActivationTime(newItem, location);
+    uint16_t minuteOfWeek = calculateMinuteOfWeek(newItem);
+
+    // Keep the entries in order of activation, after the entries with the same activation time.
+    int first = tenantFirstEntries[tenant];
+    int count = tenantNumberOfEntries[tenant];
+    int position = (int)(std::upper_bound(minutesOfWeek + first, minutesOfWeek + first + count, minuteOfWeek) - minutesOfWeek);
+
+    memmove(minutesOfWeek + position + 1, minutesOfWeek + position, (first + count - position) * sizeof(uint16_t));
+    memmove(items + position + 1, items + position, (first + count - position) * sizeof(CEventSchedulerItem));
+    minutesOfWeek[position] = minuteOfWeek;
+    items[position] = newItem;
+    tenantNumberOfEntries[tenant]++;
+
+    return 0;
+}
+
+// NOTE: It is undefined which item is removed when the tenant has duplicate items (e.g. 2 or more 'sunset' items).
+int CEventSchedulerPool::removeItem(int tenant, const CEventSchedulerItem &item) {
+    if (tenant < 0 || tenant >= numberOfTenants) {
+        return -1;
+    }
+
+    int first = tenantFirstEntries[tenant];
+    int count = tenantNumberOfEntries[tenant];
+    for (int position = first; position < first + count; position++) {
+        if (items[position] == item) {
+            memmove(minutesOfWeek + position, minutesOfWeek + position + 1, (first + count - position - 1) * sizeof(uint16_t));
+            memmove(items + position, items + position + 1, (first + count - position - 1) * sizeof(CEventSchedulerItem));
+            tenantNumberOfEntries[tenant]--;
+            return 0;
+        }
+    }
+
+    return -1; // Item not found
+}
+
+// Replace all items of the tenant in one go. Fails without changing anything if an item is not valid, or the items do
+// not fit.
+int CEventSchedulerPool::replaceAllItems(int tenant, const CEventSchedulerItem *newItems, int numberOfNewItems) {
+    if (tenant < 0 || tenant >= numberOfTenants || numberOfNewItems < 0) {
+        return -1;
+    }
+    for (int index = 0; index < numberOfNewItems; index++) {
+        if (!newItems[index].isValid() || newItems[index].eventType == CEventSchedulerItemType_OneShot) {
+            return -1;
+        }
+    }
+    if (!reserveEntries(tenant, numberOfNewItems)) {
+        return -1; // No space left
+    }
+
+    Location &location = locations[tenantLocations[tenant]];
+    if (calculateBeginningOfWeek(timeProvider(), location.secondsFromGMT) != location.beginningOfWeekGMT) {
+        calculateSolarDays(tenantLocations[tenant], tenantLocations[tenant] + 1, timeProvider());
+    }
+
+    int first = tenantFirstEntries[tenant];
+    for (int index = 0; index < numberOfNewItems; index++) {
+        items[first + index] = newItems[index];
+        recalculateActivationTime(items[first + index], location);
+    }
+    tenantNumberOfEntries[tenant] = numberOfNewItems;
+
+    sortTenant(tenant);
+
+    return 0;
+}
+
+void CEventSchedulerPool::resetItems(int tenant) {
+    if (tenant >= 0 && tenant < numberOfTenants) {
+        tenantNumberOfEntries[tenant] = 0;
+    }
+}
+
+int CEventSchedulerPool::getNumberOfItems(int tenant) {
+    if (tenant < 0 || tenant >= numberOfTenants) {
+        return 0;
+    }
+    return tenantNumberOfEntries[tenant];
+}
+
+// Get the items of a tenant in order of activation.
+CEventSchedulerItem CEventSchedulerPool::getItem(int tenant, int index) {
+    if (tenant < 0 || tenant >= numberOfTenants || index < 0 || index >= tenantNumberOfEntries[tenant]) {
+        return CEventSchedulerItem();
+    }
+    return items[tenantFirstEntries[tenant] + index];
+}
+
+CEventSchedulerItem CEventSchedulerPool::getActiveItem(int tenant, time_t timestampGMT) {
+    if (tenant < 0 || tenant >= numberOfTenants) {
+        return CEventSchedulerItem();
+    }
+
+    time_t secondsFromGMT = locations[tenantLocations[tenant]].secondsFromGMT;
+    uint16_t minuteOfWeek = (uint16_t)((timestampGMT - calculateBeginningOfWeek(timestampGMT, secondsFromGMT)) / 60);
+
+    int entry = findActiveEntry(tenant, minuteOfWeek);
+    return (entry < 0) ? CEventSchedulerItem() : items[entry];
+}
+
+void CEventSchedulerPool::evaluateAll(time_t timestampGMT, CEventSchedulerItem *activeItems, int numberOfThreads) {
+    // The minute of the week only depends on the time zone, so calculate it once per location.
+    for (int location = 0; location < numberOfLocations; location++) {
+        time_t secondsFromGMT = locations[location].secondsFromGMT;
+        locationMinutesOfWeek[location] = (uint16_t)((timestampGMT - calculateBeginningOfWeek(timestampGMT, secondsFromGMT)) / 60);
+    }
+
+    // Give each thread an equal range of tenants. The calling thread takes the last range.
+    const int minimumTenantsPerThread = 1024;
+    if (numberOfThreads > numberOfTenants / minimumTenantsPerThread) {
+        numberOfThreads = numberOfTenants / minimumTenantsPerThread;
+    }
+    if (numberOfThreads <= 1) {
+        evaluateTenants(0, numberOfTenants, activeItems);
+        return;
+    }
+
+    std::thread *threads = new std::thread[numberOfThreads - 1];
+    int tenantsPerThread = (numberOfTenants + numberOfThreads - 1) / numberOfThreads;
+    for (int index = 0; index < numberOfThreads - 1; index++) {
+        int firstTenant = index * tenantsPerThread;
+        threads[index] = std::thread([this, firstTenant, tenantsPerThread, activeItems]() {
+            evaluateTenants(firstTenant, firstTenant + tenantsPerThread, activeItems);
+        });
+    }
+    evaluateTenants((numberOfThreads - 1) * tenantsPerThread, numberOfTenants, activeItems);
+
+    for (int index = 0; index < numberOfThreads - 1; index++) {
+        threads[index].join();
+    }
+    delete[] threads;
+}
+
+void CEventSchedulerPool::recalculateAllActivationTimes(void) {
+    calculateSolarDays(0, numberOfLocations, timeProvider());
+
+    for (int tenant = 0; tenant < numberOfTenants; tenant++) {
+        const Location &location = locations[tenantLocations[tenant]];
+        int first = tenantFirstEntries[tenant];
+        for (int entry = first; entry < first + tenantNumberOfEntries[tenant]; entry++) {
+            recalculateActivationTime(items[entry], location);
+        }
+        sortTenant(tenant);
+    }
+}
+
+// Copy the entries into new arrays, without gaps, and in order of tenant. Nothing changes if there is no memory left.
+void CEventSchedulerPool::compact(void) {
+    int numberOfUsedEntries = 0;
+    for (int tenant = 0; tenant < numberOfTenants; tenant++) {
+        numberOfUsedEntries += tenantNumberOfEntries[tenant];
+    }
+
+    int newCapacity = (numberOfUsedEntries < 16) ? 16 : numberOfUsedEntries;
+    uint16_t *newMinutesOfWeek = static_cast<uint16_t *>(malloc(newCapacity * sizeof(uint16_t)));
+    CEventSchedulerItem *newItems = static_cast<CEventSchedulerItem *>(malloc(newCapacity * sizeof(CEventSchedulerItem)));
+    if (newMinutesOfWeek == nullptr || newItems == nullptr) {
+        free(newMinutesOfWeek);
+        free(newItems);
+        return;
+    }
+
+    int newEntry = 0;
+    for (int tenant = 0; tenant < numberOfTenants; tenant++) {
+        int count = tenantNumberOfEntries[tenant];
+        memcpy(newMinutesOfWeek + newEntry, minutesOfWeek + tenantFirstEntries[tenant], count * sizeof(uint16_t));
+        memcpy(newItems + newEntry, items + tenantFirstEntries[tenant], count * sizeof(CEventSchedulerItem));
+        tenantFirstEntries[tenant] = newEntry;
+        tenantEntryCapacities[tenant] = count;
+        newEntry += count;
+    }
+
+    free(minutesOfWeek);
+    free(items);
+    minutesOfWeek = newMinutesOfWeek;
+    items = newItems;
+    numberOfEntries = numberOfUsedEntries;
+    entryCapacity = newCapacity;
+}
+
+int CEventSchedulerPool::getNumberOfLocations(void) {
+    return numberOfLocations;
+}
+
+size_t CEventSchedulerPool::getMemoryUsage(void) {
+    return sizeof(*this) +
+           (size_t)tenantCapacity * (sizeof(int32_t) + 2 * sizeof(uint16_t) + sizeof(uint32_t)) +
+           (size_t)entryCapacity * (sizeof(uint16_t) + sizeof(CEventSchedulerItem)) +
+           (size_t)locationCapacity * (sizeof(Location) + sizeof(uint16_t)) +
+           (size_t)locationIndexSize * sizeof(uint32_t);
+}
+
+int CEventSchedulerPool::findOrAddLocation(double latitude, double longitude, time_t secondsFromGMT) {
+    int32_t latitudeKey = quantize(latitude);
+    int32_t longitudeKey = quantize(longitude);
+    uint32_t mask = locationIndexSize - 1;
+
+    uint32_t position = hashLocation(latitudeKey, longitudeKey, secondsFromGMT) & mask;
+    for (; locationIndex[position] != 0; position = (position + 1) & mask) {
+        const Location &location = locations[locationIndex[position] - 1];
+        if (quantize(location.latitude) == latitudeKey && quantize(location.longitude) == longitudeKey && location.secondsFromGMT == secondsFromGMT) {
+            return locationIndex[position] - 1;
+        }
+    }
+
+    if (numberOfLocations == locationCapacity) {
+        int newCapacity = (locationCapacity < 16) ? 16 : locationCapacity * 2;
+        if (!resizeArray(locations, newCapacity) || !resizeArray(locationMinutesOfWeek, newCapacity)) {
+            return -1; // No memory left
+        }
+        locationCapacity = newCapacity;
+    }
+
+    // Keep the index at most 2/3 full.
+    if ((numberOfLocations + 1) * 3 > locationIndexSize * 2) {
+        if (!rebuildLocationIndex(locationIndexSize * 2)) {
+            return -1; // No memory left
+        }
+        mask = locationIndexSize - 1;
+        position = hashLocation(latitudeKey, longitudeKey, secondsFromGMT) & mask;
+        while (locationIndex[position] != 0) {
+            position = (position + 1) & mask;
+        }
+    }
+
+    int newLocation = numberOfLocations++;
+    locations[newLocation].latitude = latitude;
+    locations[newLocation].longitude = longitude;
+    locations[newLocation].secondsFromGMT = secondsFromGMT;
+    locationIndex[position] = newLocation + 1;
+
+    calculateSolarDays(newLocation, newLocation + 1, timeProvider());
+
+    return newLocation;
+}
+
+bool CEventSchedulerPool::rebuildLocationIndex(int newSize) {
+    uint32_t *newLocationIndex = static_cast<uint32_t *>(calloc(newSize, sizeof(uint32_t)));
+    if (newLocationIndex == nullptr) {
+        return false;
+    }
+
+    uint32_t mask = newSize - 1;
+    for (int location = 0; location < numberOfLocations; location++) {
+        uint32_t position = hashLocation(quantize(locations[location].latitude), quantize(locations[location].longitude), locations[location].secondsFromGMT) & mask;
+        while (newLocationIndex[position] != 0) {
+            position = (position + 1) & mask;
+        }
+        newLocationIndex[position] = location + 1;
+    }
+
+    free(locationIndex);
+    locationIndex = newLocationIndex;
+    locationIndexSize = newSize;
+
+    return true;
+}
+
+uint32_t CEventSchedulerPool::hashLocation(int32_t latitudeKey, int32_t longitudeKey, time_t secondsFromGMT) {
+    uint32_t hash = (uint32_t)latitudeKey;
+    hash = hash * 31 + (uint32_t)longitudeKey;
+    hash = hash * 31 + (uint32_t)secondsFromGMT;
+    hash *= 2654435761u;    // Knuth's multiplicative hash, to spread the bits
+    return hash ^ (hash >> 16);
+}
+
+// The same grid as CSolarTableCache, 0.01 degrees is about 1 km, and moves sunrise by less than 2 seconds.
+int32_t CEventSchedulerPool::quantize(double degrees) {
+    return (int32_t)lround(degrees * 100.0);
+}
+
+// Make sure the tenant has room for the given number of entries. A tenant that is at the end of the arrays grows in
+// place, other tenants move to the end.
+bool CEventSchedulerPool::reserveEntries(int tenant, int numberOfEntriesNeeded) {
+    int capacity = tenantEntryCapacities[tenant];
+    if (numberOfEntriesNeeded <= capacity) {
+        return true;
+    }
+    if (numberOfEntriesNeeded > maximumEntriesPerTenant) {
+        return false;
+    }
+
+    int newCapacity = (capacity < 4) ? 4 : capacity * 2;
+    if (newCapacity < numberOfEntriesNeeded) {
+        newCapacity = numberOfEntriesNeeded;
+    }
+    if (newCapacity > maximumEntriesPerTenant) {
+        newCapacity = maximumEntriesPerTenant;
+    }
+
+    int first = tenantFirstEntries[tenant];
+    if (first + capacity == numberOfEntries) {
+        if (!growEntries(first + newCapacity)) {
+            return false;
+        }
+    } else {
+        if (!growEntries(numberOfEntries + newCapacity)) {
+            return false;
+        }
+        memcpy(minutesOfWeek + numberOfEntries, minutesOfWeek + first, tenantNumberOfEntries[tenant] * sizeof(uint16_t));
+        memcpy(items + numberOfEntries, items + first, tenantNumberOfEntries[tenant] * sizeof(CEventSchedulerItem));
+        first = numberOfEntries;
+        tenantFirstEntries[tenant] = first;
+    }
+
+    numberOfEntries = first + newCapacity;
+    tenantEntryCapacities[tenant] = newCapacity;
+
+    return true;
+}
+
+bool CEventSchedulerPool::growEntries(int minimumCapacity) {
+    if (minimumCapacity <= entryCapacity) {
+        return true;
+    }
+
+    int newCapacity = (entryCapacity < 16) ? 16 : entryCapacity * 2;
+    if (newCapacity < minimumCapacity) {
+        newCapacity = minimumCapacity;
+    }
+    if (!resizeArray(minutesOfWeek, newCapacity) || !resizeArray(items, newCapacity)) {
+        return false;
+    }
+    entryCapacity = newCapacity;
+
+    return true;
+}
+
+// Calculate the sunrise and sunset of every day of the week of the given time, for a range of locations. The days of
+// a number of locations go through the batch calculation together.
+void CEventSchedulerPool::calculateSolarDays(int firstLocation, int lastLocation, time_t timestampGMT) {
+    const int locationsPerBlock = 8;
+    const int daysPerBlock = locationsPerBlock * daysInWeek;
+
+    time_t days[daysPerBlock];
+    double latitudes[daysPerBlock];
+    double longitudes[daysPerBlock];
+    time_t sunRises[daysPerBlock];
+    time_t sunSets[daysPerBlock];
+
+    for (int blockStart = firstLocation; blockStart < lastLocation; blockStart += locationsPerBlock) {
+        int blockEnd = std::min(blockStart + locationsPerBlock, lastLocation);
+        int numberOfDays = 0;
+
+        for (int location = blockStart; location < blockEnd; location++) {
+            locations[location].beginningOfWeekGMT = calculateBeginningOfWeek(timestampGMT, locations[location].secondsFromGMT);
+            for (int day = 0; day < daysInWeek; day++) {
+                days[numberOfDays] = locations[location].beginningOfWeekGMT + (time_t)day * secondsInDay;
+                latitudes[numberOfDays] = locations[location].latitude;
+                longitudes[numberOfDays] = locations[location].longitude;
+                numberOfDays++;
+            }
+        }
+
+        CSunriseCalculator::sunRiseAndSetBatch(days, latitudes, longitudes, numberOfDays, sunRises, sunSets);
+
+        numberOfDays = 0;
+        for (int location = blockStart; location < blockEnd; location++) {
+            for (int day = 0; day < daysInWeek; day++) {
+                locations[location].sunRises[day] = sunRises[numberOfDays];
+                locations[location].sunSets[day] = sunSets[numberOfDays];
+                numberOfDays++;
+            }
+        }
+    }
+}
+
+// The same calculation as CEventSchedulerBase::recalculateActivationTime(), with the sunrise and sunset of the
+// location.
+void CEventSchedulerPool::recalculateActivationTime(CEventSchedulerItem &item, const Location &location) {
+    if (item.eventType == CEventSchedulerItemType_Sunrise || item.eventType == CEventSchedulerItemType_Sunset) {
+        time_t sunTime = (item.eventType == CEventSchedulerItemType_Sunrise) ? location.sunRises[item.weekDay - 1] : location.sunSets[item.weekDay - 1];
+        time_t secondsIntoDay = (sunTime + location.secondsFromGMT) % secondsInDay;
+        if (secondsIntoDay < 0) { secondsIntoDay += secondsInDay; }
+        item.timeOffset = secondsIntoDay / 60;
+    }
+
+    std::uniform_int_distribution<int> int_dist(-item.randomOffsetMinus, item.randomOffsetPlus);
+    int randomOffset = int_dist(randomGenerator);
+
+    int newActiveWeekDay = item.weekDay;
+    int newActiveTimeOffset = item.timeOffset + randomOffset;
+
+    if (newActiveTimeOffset < 0) {
+        item.activeTimeOffset = newActiveTimeOffset + minutesInDay;
+        item.activeWeekDay = static_cast<CEventSchedulerWeekDay>((((newActiveWeekDay - 1) - 1 + 7) % 7) + 1); // Move to previous day
+    } else if (newActiveTimeOffset >= minutesInDay) {
+        item.activeTimeOffset = newActiveTimeOffset - minutesInDay;
+        item.activeWeekDay = static_cast<CEventSchedulerWeekDay>((((newActiveWeekDay - 1) + 1) % 7) + 1); // Move to next day
+    } else {
+        item.activeTimeOffset = newActiveTimeOffset;
+        item.activeWeekDay = static_cast<CEventSchedulerWeekDay>(newActiveWeekDay);
+    }
+}
+
+// Put the entries of the tenant in order of activation, after their activation times have changed.
+void CEventSchedulerPool::sortTenant(int tenant) {
+    int first = tenantFirstEntries[tenant];
+    int count = tenantNumberOfEntries[tenant];
+
+    std::stable_sort(items + first, items + first + count, [this](const CEventSchedulerItem &itemA, const CEventSchedulerItem &itemB) {
+        return calculateMinuteOfWeek(itemA) < calculateMinuteOfWeek(itemB);
+    });
+    for (int entry = first; entry < first + count; entry++) {
+        minutesOfWeek[entry] = calculateMinuteOfWeek(items[entry]);
+    }
+}
+
+// The week starts on Sunday 00:00 local time, and the epoch was on a Thursday.
+time_t CEventSchedulerPool::calculateBeginningOfWeek(time_t timestampGMT, time_t secondsFromGMT) {
+    time_t localTime = timestampGMT + secondsFromGMT;
+    time_t daysSinceEpoch = localTime / secondsInDay;
+    if ((localTime < 0) && ((localTime % secondsInDay) != 0)) { daysSinceEpoch--; }
+    time_t daysIntoWeek = ((daysSinceEpoch + 4) % daysInWeek + daysInWeek) % daysInWeek;
+
+    return (daysSinceEpoch - daysIntoWeek) * secondsInDay - secondsFromGMT;
+}
+
+uint16_t CEventSchedulerPool::calculateMinuteOfWeek(const CEventSchedulerItem &item) {
+    return (item.activeWeekDay - 1) * minutesInDay + item.activeTimeOffset;
+}
+
+// The active entry is the last one at or before the minute of the week. If there is none, it is the last entry of the
+// week before.
+int CEventSchedulerPool::findActiveEntry(int tenant, uint16_t minuteOfWeek) {
+    int count = tenantNumberOfEntries[tenant];
+    if (count == 0) {
+        return -1;
+    }
+
+    const uint16_t *first = minutesOfWeek + tenantFirstEntries[tenant];
+    const uint16_t *found = std::upper_bound(first, first + count, minuteOfWeek);
+    if (found == first) {
+        found = first + count;
+    }
+
+    return (int)(found - minutesOfWeek) - 1;
+}
+
+void CEventSchedulerPool::evaluateTenants(int firstTenant, int lastTenant, CEventSchedulerItem *activeItems) {
+    if (lastTenant > numberOfTenants) {
+        lastTenant = numberOfTenants;
+    }
+
+    for (int tenant = firstTenant; tenant < lastTenant; tenant++) {
+        int entry = findActiveEntry(tenant, locationMinutesOfWeek[tenantLocations[tenant]]);
+        activeItems[tenant] = (entry < 0) ? CEventSchedulerItem() : items[entry];
+    }
+}
@@ -0,0 +1,109 @@
+#include "EventSchedulerRunner.hpp"
+
+CEventSchedulerRunner::CEventSchedulerRunner(CEventSchedulerBase &scheduler, CEventSchedulerTransitionCallback callback, void *context) :
+scheduler(scheduler),
+callback(callback),
+context(context),
+running(false),
+numberOfWakeUps(0) {
+    scheduler.setChangeListener(schedulerChanged, this);
+}
+
+CEventSchedulerRunner::~CEventSchedulerRunner() {
+    stop();
+    scheduler.setChangeListener(nullptr, nullptr);
+}
+
+int CEventSchedulerRunner::run(void) {
+    if (!waiter.isValid()) {
+        return -1;
+    }
+    if (running.exchange(true)) {
+        return -1; // Already running
+    }
+
+    runLoop();
+
+    return 0;
+}
+
+void CEventSchedulerRunner::runLoop(void) {
+    bool isFirstRun = true;
+    bool timerExpired = false;
+    time_t nextActivationTime = -1;
+    CEventSchedulerItem previousActiveItem;
+
+    while (running) {
+        {
+            std::lock_guard<std::mutex> lock(schedulerMutex);
+
+            time_t timestampGMT = scheduler.getCurrentTime();
+
+            // time() is only updated on the kernel tick, so it can still be a second behind when the timer expires.
+            // The timer expiring means that the activation time has been reached, so use that.
+            if (timerExpired && timestampGMT < nextActivationTime) {
+                timestampGMT = nextActivationTime;
+            }
+
+            CEventSchedulerItem activeItem;
+            CEventSchedulerItem nextActiveItem;
+            scheduler.getActiveAndNextItem(timestampGMT, activeItem, nextActiveItem);
+
+            // Also fire when the same item activates again, e.g. the only item in the schedule, a week later.
+            bool activationReached = (nextActivationTime >= 0) && (timestampGMT >= nextActivationTime);
+
+            if (isFirstRun || activationReached || !(activeItem == previousActiveItem)) {
+                callback(scheduler, activeItem, nextActiveItem, timestampGMT, context);
+                previousActiveItem = activeItem;
+                isFirstRun = false;
+            }
+
+            nextActivationTime = scheduler.getNextActivationTime(timestampGMT);
+        }
+
+        if (running) {
+            timerExpired = waiter.waitUntil(nextActivationTime);
+            numberOfWakeUps++;
+        }
+    }
+}
+
+int CEventSchedulerRunner::start(void) {
+    if (!waiter.isValid()) {
+        return -1;
+    }
+    if (running || thread.joinable()) {
+        return -1; // Already running
+    }
+
+    // Running before the thread exists, so that a stop() right after this always ends it.
+    running = true;
+    thread = std::thread([this]() { runLoop(); });
+
+    return 0;
+}
+
+void CEventSchedulerRunner::stop(void) {
+    running = false;
+    wakeUp();
+
+    if (thread.joinable() && thread.get_id() != std::this_thread::get_id()) {
+        thread.join();
+    }
+}
+
+void CEventSchedulerRunner::wakeUp(void) {
+    waiter.wakeUp();
+}
+
+std::mutex &CEventSchedulerRunner::getSchedulerMutex(void) {
+    return schedulerMutex;
+}
+
+uint32_t CEventSchedulerRunner::getNumberOfWakeUps(void) {
+    return numberOfWakeUps;
+}
+
+void CEventSchedulerRunner::schedulerChanged(CEventSchedulerBase & /* scheduler */, void *context) {
+    static_cast<CEventSchedulerRunner *>(context)->wakeUp();
+}
@@ -0,0 +1,313 @@
+#include <stdlib.h>
+#include <new>
+#include <vector>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+#include "EventSchedulerService.hpp"
+
+CEventSchedulerService::CEventSchedulerService(int numberOfShards, CEventSchedulerServiceCallback callback, void *context, bool pinThreads) :
+numberOfShards(numberOfShards < 1 ? 1 : numberOfShards),
+nextShard(0),
+pinThreads(pinThreads),
+callback(callback),
+context(context) {
+    shards = new Shard *[this->numberOfShards];
+    for (int index = 0; index < this->numberOfShards; index++) {
+        shards[index] = new Shard(*this, index);
+    }
+}
+
+// Stops the shards, and handles the commands that are still queued on this thread, now that the shards are gone.
+CEventSchedulerService::~CEventSchedulerService() {
+    stop();
+
+    for (int index = 0; index < numberOfShards; index++) {
+        shards[index]->executeCommands();
+        delete shards[index];
+    }
+    delete[] shards;
+}
+
+int CEventSchedulerService::start(void) {
+    for (int index = 0; index < numberOfShards; index++) {
+        Shard *shard = shards[index];
+        if (shard->running || shard->thread.joinable()) {
+            return -1; // Already running
+        }
+
+        shard->running = true;
+        shard->thread = std::thread([shard]() { shard->run(); });
+
+#ifdef __linux__
+        if (pinThreads) {
+            unsigned int numberOfCores = std::thread::hardware_concurrency();
+            cpu_set_t cpuSet;
+            CPU_ZERO(&cpuSet);
+            CPU_SET(index % (numberOfCores > 0 ? numberOfCores : 1), &cpuSet);
+            pthread_setaffinity_np(shard->thread.native_handle(), sizeof(cpuSet), &cpuSet);
+        }
+#endif
+    }
+
+    return 0;
+}
+
+void CEventSchedulerService::stop(void) {
+    for (int index = 0; index < numberOfShards; index++) {
+        shards[index]->running = false;
+        shards[index]->waiter.wakeUp();
+    }
+    for (int index = 0; index < numberOfShards; index++) {
+        if (shards[index]->thread.joinable()) {
+            shards[index]->thread.join();
+        }
+    }
+}
+
+int CEventSchedulerService::getNumberOfShards(void) {
+    return numberOfShards;
+}
+
+std::future<int> CEventSchedulerService::createScheduler(double latitude, double longitude, time_t secondsFromGMT) {
+    std::promise<int> promise;
+    std::future<int> future = promise.get_future();
+
+    post(nextShard++ % numberOfShards, [promise = std::move(promise), latitude, longitude, secondsFromGMT](Shard &owner) mutable {
+        promise.set_value(owner.createScheduler(latitude, longitude, secondsFromGMT));
+    });
+
+    return future;
+}
+
+std::future<int> CEventSchedulerService::destroyScheduler(int schedulerId) {
+    std::promise<int> promise;
+    std::future<int> future = promise.get_future();
+
+    int shard = shardForScheduler(schedulerId);
+    if (shard < 0) {
+        promise.set_value(-1);
+        return future;
+    }
+
+    post(shard, [promise = std::move(promise), schedulerId](Shard &owner) mutable {
+        promise.set_value(owner.destroyScheduler(schedulerId));
+    });
+
+    return future;
+}
+
+std::future<CEventSchedulerItemHandle> CEventSchedulerService::addItem(int schedulerId, const CEventSchedulerItem &item) {
+    return call(schedulerId, [item](CEventSchedulerBase *scheduler) -> CEventSchedulerItemHandle {
+        return (scheduler != nullptr) ? scheduler->addItem(item) : -1;
+    });
+}
+
+std::future<int> CEventSchedulerService::removeItem(int schedulerId, CEventSchedulerItemHandle handle) {
+    return call(schedulerId, [handle](CEventSchedulerBase *scheduler) -> int {
+        return (scheduler != nullptr) ? scheduler->removeItem(handle) : -1;
+    });
+}
+
+// The items are copied, so they do not have to outlive the call.
+std::future<int> CEventSchedulerService::replaceAllItems(int schedulerId, const CEventSchedulerItem *newItems, int numberOfNewItems) {
+    std::vector<CEventSchedulerItem> items(newItems, newItems + (numberOfNewItems > 0 ? numberOfNewItems : 0));
+
+    return call(schedulerId, [items](CEventSchedulerBase *scheduler) -> int {
+        return (scheduler != nullptr) ? scheduler->replaceAllItems(items.data(), (int)items.size()) : -1;
+    });
+}
+
+std::future<CEventSchedulerItem> CEventSchedulerService::getActiveItem(int schedulerId) {
+    return call(schedulerId, [](CEventSchedulerBase *scheduler) -> CEventSchedulerItem {
+        return (scheduler != nullptr) ? scheduler->getActiveItem() : CEventSchedulerItem();
+    });
+}
+
+// Queue the command, and wake up the shard if it is (about to go) asleep. The shard says it is going to sleep before
+// it looks at the queue for the last time, and the command is in the queue before the producer looks at that, so
+// either the shard sees the command, or the producer sees that the shard sleeps.
+void CEventSchedulerService::pushCommand(int shard, Command *command) {
+    shards[shard]->commands.push(command);
+    if (shards[shard]->sleeping.load()) {
+        shards[shard]->waiter.wakeUp();
+    }
+}
+
+int CEventSchedulerService::shardForScheduler(int schedulerId) {
+    return (schedulerId < 0) ? -1 : schedulerId % numberOfShards;
+}
+
+void CEventSchedulerService::schedulerTransition(CEventSchedulerBase &scheduler, const CEventSchedulerItem &activeItem, const CEventSchedulerItem &nextActiveItem, time_t timestampGMT, void *context) {
+    CEventSchedulerService *service = static_cast<CEventSchedulerService *>(context);
+
+    if (service->callback != nullptr) {
+        service->callback(static_cast<ServiceScheduler &>(scheduler).schedulerId, activeItem, nextActiveItem, timestampGMT, service->context);
+    }
+}
+
+CEventSchedulerService::CommandQueue::CommandQueue() :
+head(&stub),
+tail(&stub) {
+    stub.next.store(nullptr);
+}
+
+void CEventSchedulerService::CommandQueue::push(Command *command) {
+    command->next.store(nullptr, std::memory_order_relaxed);
+    Command *previous = head.exchange(command);
+    previous->next.store(command, std::memory_order_release);
+}
+
+// Returns nullptr when the queue is empty, or when the only command in it is still being linked in by its producer.
+// The stub is put back at the end when the last command is taken, so that there is always a node to link to.
+CEventSchedulerService::Command *CEventSchedulerService::CommandQueue::pop(void) {
+    Command *first = tail;
+    Command *next = first->next.load(std::memory_order_acquire);
+
+    if (first == &stub) {
+        if (next == nullptr) {
+            return nullptr; // Empty
+        }
+        tail = next;
+        first = next;
+        next = next->next.load(std::memory_order_acquire);
+    }
+
+    if (next != nullptr) {
+        tail = next;
+        return first;
+    }
+
+    if (first != head.load()) {
+        return nullptr; // A producer has not linked its command yet
+    }
+
+    push(&stub);
+
+    next = first->next.load(std::memory_order_acquire);
+    if (next != nullptr) {
+        tail = next;
+        return first;
+    }
+
+    return nullptr;
+}
+
+bool CEventSchedulerService::CommandQueue::isEmpty(void) {
+    return head.load() == tail;
+}
+
+CEventSchedulerService::ServiceScheduler::ServiceScheduler(double latitude, double longitude, time_t secondsFromGMT) :
+CEventSchedulerServiceSchedulerBase(latitude, longitude, secondsFromGMT, [](){ return time(nullptr); }),
+schedulerId(-1) {
+}
+
+CEventSchedulerService::Shard::Shard(CEventSchedulerService &service, int index) :
+service(service),
+index(index),
+running(false),
+sleeping(false),
+coordinator(CEventSchedulerService::schedulerTransition, &service) {
+}
+
+CEventSchedulerService::Shard::~Shard() {
+    for (int localId = 0; localId < schedulerCapacity; localId++) {
+        if (schedulers[localId] != nullptr) {
+            coordinator.removeScheduler(localId);
+            delete schedulers[localId];
+        }
+    }
+    free(schedulers);
+}
+
+// The event loop of the shard: handle the commands, then the activations that are due, then sleep until the next
+// activation or command.
+void CEventSchedulerService::Shard::run(void) {
+    bool timerExpired = false;
+    time_t nextActivationTime = -1;
+
+    while (running) {
+        executeCommands();
+
+        time_t timestampGMT = time(nullptr);
+
+        // time() can still be a second behind when the timer expires, see CEventSchedulerRunner::run().
+        if (timerExpired && timestampGMT < nextActivationTime) {
+            timestampGMT = nextActivationTime;
+        }
+
+        nextActivationTime = coordinator.processDue(timestampGMT);
+
+        timerExpired = false;
+        sleeping.store(true);
+        if (commands.isEmpty() && running) {
+            timerExpired = waiter.waitUntil(nextActivationTime);
+        }
+        sleeping.store(false);
+    }
+}
+
+void CEventSchedulerService::Shard::executeCommands(void) {
+    Command *command;
+    while ((command = commands.pop()) != nullptr) {
+        command->execute(*this);
+        delete command;
+    }
+}
+
+CEventSchedulerBase *CEventSchedulerService::Shard::findScheduler(int schedulerId) {
+    int localId = schedulerId / service.numberOfShards;
+    return (localId < schedulerCapacity) ? schedulers[localId] : nullptr;
+}
+
+// The scheduler gets the id of the coordinator, combined with the number of the shard.
+int CEventSchedulerService::Shard::createScheduler(double latitude, double longitude, time_t secondsFromGMT) {
+    ServiceScheduler *scheduler = new (std::nothrow) ServiceScheduler(latitude, longitude, secondsFromGMT);
+    if (scheduler == nullptr) {
+        return -1; // No memory left
+    }
+
+    int localId = coordinator.addScheduler(*scheduler);
+    if (localId >= schedulerCapacity) {
+        int newCapacity = (schedulerCapacity < 64) ? 64 : schedulerCapacity * 2;
+        while (newCapacity <= localId) {
+            newCapacity *= 2;
+        }
+        ServiceScheduler **newSchedulers = static_cast<ServiceScheduler **>(realloc(schedulers, newCapacity * sizeof(ServiceScheduler *)));
+        if (newSchedulers == nullptr) {
+            coordinator.removeScheduler(localId);
+            localId = -1;
+        } else {
+            for (int index = schedulerCapacity; index < newCapacity; index++) {
+                newSchedulers[index] = nullptr;
+            }
+            schedulers = newSchedulers;
+            schedulerCapacity = newCapacity;
+        }
+    }
+    if (localId < 0) {
+        delete scheduler;
+        return -1; // No memory left
+    }
+
+    schedulers[localId] = scheduler;
+    scheduler->schedulerId = localId * service.numberOfShards + index;
+
+    return scheduler->schedulerId;
+}
+
+int CEventSchedulerService::Shard::destroyScheduler(int schedulerId) {
+    int localId = schedulerId / service.numberOfShards;
+    if (localId >= schedulerCapacity || schedulers[localId] == nullptr) {
+        return -1; // No such scheduler
+    }
+
+    coordinator.removeScheduler(localId);
+    delete schedulers[localId];
+    schedulers[localId] = nullptr;
+
+    return 0;
+}
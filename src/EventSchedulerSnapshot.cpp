@@ -0,0 +1,433 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <string>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "EventSchedulerSnapshot.hpp"
+
+CEventSchedulerSnapshotFile::CEventSchedulerSnapshotFile() {
+}
+
+CEventSchedulerSnapshotFile::~CEventSchedulerSnapshotFile() {
+    close();
+}
+
+int CEventSchedulerSnapshotFile::write(const char *path, CEventSchedulerBase *const *schedulers, int numberOfSchedulers) {
+    uint8_t *buffer;
+    size_t bufferSize;
+    uint32_t checksum;
+    if (encode(schedulers, numberOfSchedulers, buffer, bufferSize, checksum) != 0) {
+        return -1;
+    }
+
+    int result = writeEncoded(path, buffer, bufferSize);
+    free(buffer);
+
+    return result;
+}
+
+int CEventSchedulerSnapshotFile::encode(CEventSchedulerBase *const *schedulers, int numberOfSchedulers, uint8_t *&buffer, size_t &size, uint32_t &checksum) {
+    if (numberOfSchedulers < 0 || (numberOfSchedulers > 0 && schedulers == nullptr)) {
+        return -1;
+    }
+
+    // Lay out the file first, to know its size.
+    size_t fileSize = sizeof(FileHeader) + (size_t)numberOfSchedulers * sizeof(SchedulerRecord);
+    for (int index = 0; index < numberOfSchedulers; index++) {
+        if (schedulers[index] == nullptr || schedulers[index]->updateInProgress) {
+            return -1;
+        }
+        fileSize += itemBlockSize((uint32_t)schedulers[index]->numberOfStoredItems);
+    }
+
+    buffer = static_cast<uint8_t *>(calloc(1, fileSize));
+    if (buffer == nullptr) {
+        return -1;
+    }
+
+    SchedulerRecord *fileRecords = reinterpret_cast<SchedulerRecord *>(buffer + sizeof(FileHeader));
+    size_t offset = sizeof(FileHeader) + (size_t)numberOfSchedulers * sizeof(SchedulerRecord);
+
+    for (int index = 0; index < numberOfSchedulers; index++) {
+        CEventSchedulerBase &scheduler = *schedulers[index];
+        SchedulerRecord &schedulerRecord = fileRecords[index];
+        int numberOfItems = scheduler.numberOfStoredItems;
+
+        schedulerRecord.latitude = scheduler.sunriseCalculator.getLatitude();
+        schedulerRecord.longitude = scheduler.sunriseCalculator.getLongitude();
+        schedulerRecord.secondsFromGMT = (int64_t)scheduler.getSecondsFromGMT();
+        schedulerRecord.itemsOffset = offset;
+        schedulerRecord.numberOfItems = (uint32_t)numberOfItems;
+        schedulerRecord.randomSeed = scheduler.randomGenerator.getSeed();
+        schedulerRecord.localBeginningOfWeek = (int64_t)scheduler.scheduleLocalBeginningOfWeek;
+
+        uint16_t *fileMinutesOfWeek = reinterpret_cast<uint16_t *>(buffer + offset);
+        uint16_t *fileSlots = fileMinutesOfWeek + numberOfItems;
+        uint8_t *filePackedItems = reinterpret_cast<uint8_t *>(fileSlots + numberOfItems);
+        for (int entry = 0; entry < numberOfItems; entry++) {
+            fileMinutesOfWeek[entry] = scheduler.schedule[entry].minuteOfWeek;
+            fileSlots[entry] = (uint16_t)scheduler.schedule[entry].itemIndex;
+            packItem(scheduler.items[scheduler.schedule[entry].itemIndex], filePackedItems + (size_t)entry * packedItemSize);
+        }
+
+        offset += itemBlockSize((uint32_t)numberOfItems);
+    }
+
+    FileHeader *fileHeader = reinterpret_cast<FileHeader *>(buffer);
+    memcpy(fileHeader->magic, "EVSS", 4);
+    fileHeader->version = currentVersion;
+    fileHeader->headerSize = sizeof(FileHeader);
+    fileHeader->byteOrderMark = byteOrderMark;
+    fileHeader->numberOfSchedulers = (uint32_t)numberOfSchedulers;
+    fileHeader->fileSize = fileSize;
+    fileHeader->checksum = crc32(buffer + sizeof(FileHeader), fileSize - sizeof(FileHeader));
+
+    size = fileSize;
+    checksum = fileHeader->checksum;
+
+    return 0;
+}
+
+// Write next to the file, make sure it is on disk, and rename it. The rename is only on disk after the directory
+// has been synced too.
+int CEventSchedulerSnapshotFile::writeEncoded(const char *path, const uint8_t *buffer, size_t size) {
+    std::string temporaryPath = std::string(path) + ".tmp";
+
+    FILE *file = fopen(temporaryPath.c_str(), "wb");
+    if (file == nullptr) {
+        return -1;
+    }
+
+    bool isWritten = fwrite(buffer, 1, size, file) == size && fflush(file) == 0 && fsync(fileno(file)) == 0;
+    if (fclose(file) != 0 || !isWritten || rename(temporaryPath.c_str(), path) != 0) {
+        remove(temporaryPath.c_str());
+        return -1;
+    }
+
+    return syncDirectory(path);
+}
+
+// Sync the directory that the file is in, so that a rename or a new file in it survives a crash.
+int CEventSchedulerSnapshotFile::syncDirectory(const char *path) {
+    std::string directory = path;
+    size_t separator = directory.find_last_of('/');
+    directory = (separator == std::string::npos) ? "." : (separator == 0) ? "/" : directory.substr(0, separator);
+
+    int directoryDescriptor = ::open(directory.c_str(), O_RDONLY);
+    if (directoryDescriptor < 0) {
+        return -1;
+    }
+
+    int result = fsync(directoryDescriptor);
+    ::close(directoryDescriptor);
+
+    return (result == 0) ? 0 : -1;
+}
+
+int CEventSchedulerSnapshotFile::open(const char *path) {
+    close();
+
+    int fileDescriptor = ::open(path, O_RDONLY);
+    if (fileDescriptor < 0) {
+        return -1;
+    }
+
+    struct stat fileStatus;
+    if (fstat(fileDescriptor, &fileStatus) != 0 || (size_t)fileStatus.st_size < sizeof(FileHeader)) {
+        ::close(fileDescriptor);
+        return -1;
+    }
+
+    void *mapped = mmap(nullptr, (size_t)fileStatus.st_size, PROT_READ, MAP_SHARED, fileDescriptor, 0);
+    ::close(fileDescriptor); // The mapping keeps the file open
+    if (mapped == MAP_FAILED) {
+        return -1;
+    }
+
+    data = static_cast<const uint8_t *>(mapped);
+    size = (size_t)fileStatus.st_size;
+    header = reinterpret_cast<const FileHeader *>(data);
+    records = reinterpret_cast<const SchedulerRecord *>(data + sizeof(FileHeader));
+
+    if (!isValid()) {
+        close();
+        return -1;
+    }
+
+    return 0;
+}
+
+void CEventSchedulerSnapshotFile::close(void) {
+    if (data != nullptr) {
+        munmap(const_cast<uint8_t *>(data), size);
+    }
+
+    data = nullptr;
+    size = 0;
+    header = nullptr;
+    records = nullptr;
+}
+
+bool CEventSchedulerSnapshotFile::isOpen(void) {
+    return data != nullptr;
+}
+
+int CEventSchedulerSnapshotFile::getNumberOfSchedulers(void) {
+    return (header != nullptr) ? (int)header->numberOfSchedulers : 0;
+}
+
+uint32_t CEventSchedulerSnapshotFile::getChecksum(void) {
+    return (header != nullptr) ? header->checksum : 0;
+}
+
+int CEventSchedulerSnapshotFile::getNumberOfItems(int schedulerIndex) {
+    const SchedulerRecord *schedulerRecord = record(schedulerIndex);
+    return (schedulerRecord != nullptr) ? (int)schedulerRecord->numberOfItems : -1;
+}
+
+double CEventSchedulerSnapshotFile::getLatitude(int schedulerIndex) {
+    const SchedulerRecord *schedulerRecord = record(schedulerIndex);
+    return (schedulerRecord != nullptr) ? schedulerRecord->latitude : 0.0;
+}
+
+double CEventSchedulerSnapshotFile::getLongitude(int schedulerIndex) {
+    const SchedulerRecord *schedulerRecord = record(schedulerIndex);
+    return (schedulerRecord != nullptr) ? schedulerRecord->longitude : 0.0;
+}
+
+time_t CEventSchedulerSnapshotFile::getSecondsFromGMT(int schedulerIndex) {
+    const SchedulerRecord *schedulerRecord = record(schedulerIndex);
+    return (schedulerRecord != nullptr) ? (time_t)schedulerRecord->secondsFromGMT : 0;
+}
+
+CEventSchedulerItem CEventSchedulerSnapshotFile::getActiveItem(int schedulerIndex, time_t timestampGMT) {
+    CEventSchedulerItem activeItem;
+    CEventSchedulerItem nextActiveItem;
+    getActiveAndNextItem(schedulerIndex, timestampGMT, activeItem, nextActiveItem);
+
+    return activeItem;
+}
+
+// Like CEventSchedulerConcurrentReader::getActiveAndNextItem(), without the one-shot items.
+int CEventSchedulerSnapshotFile::getActiveAndNextItem(int schedulerIndex, time_t timestampGMT, CEventSchedulerItem &activeItem, CEventSchedulerItem &nextActiveItem) {
+    activeItem = CEventSchedulerItem{};
+    nextActiveItem = CEventSchedulerItem{};
+
+    const SchedulerRecord *schedulerRecord = record(schedulerIndex);
+    if (schedulerRecord == nullptr || schedulerRecord->numberOfItems == 0) {
+        return -1;
+    }
+
+    const int numberOfEntries = (int)schedulerRecord->numberOfItems;
+    const uint8_t *filePackedItems = packedItems(*schedulerRecord);
+
+    time_t beginningOfWeek;
+    int found = findEntry(*schedulerRecord, timestampGMT, beginningOfWeek);
+    int index = (found == 0) ? numberOfEntries - 1 : found - 1;
+
+    activeItem = unpackItem(filePackedItems + (size_t)index * packedItemSize);
+    nextActiveItem = unpackItem(filePackedItems + (size_t)((index + 1) % numberOfEntries) * packedItemSize);
+
+    return 0;
+}
+
+time_t CEventSchedulerSnapshotFile::getNextActivationTime(int schedulerIndex, time_t timestampGMT) {
+    const SchedulerRecord *schedulerRecord = record(schedulerIndex);
+    if (schedulerRecord == nullptr || schedulerRecord->numberOfItems == 0) {
+        return -1;
+    }
+
+    const time_t secondsInWeek = 7 * 24 * 60 * 60;
+    const int numberOfEntries = (int)schedulerRecord->numberOfItems;
+    const uint16_t *fileMinutesOfWeek = minutesOfWeek(*schedulerRecord);
+
+    time_t beginningOfWeek;
+    int found = findEntry(*schedulerRecord, timestampGMT, beginningOfWeek);
+    if (found == numberOfEntries) {
+        return beginningOfWeek + secondsInWeek + (time_t)fileMinutesOfWeek[0] * 60;
+    }
+
+    return beginningOfWeek + (time_t)fileMinutesOfWeek[found] * 60;
+}
+
+int CEventSchedulerSnapshotFile::restore(int schedulerIndex, CEventSchedulerBase &scheduler) {
+    const SchedulerRecord *schedulerRecord = record(schedulerIndex);
+    if (schedulerRecord == nullptr) {
+        return -1;
+    }
+
+    const int numberOfItems = (int)schedulerRecord->numberOfItems;
+    const uint8_t *filePackedItems = packedItems(*schedulerRecord);
+
+    CEventSchedulerItem *unpackedItems = nullptr;
+    if (numberOfItems > 0) {
+        unpackedItems = static_cast<CEventSchedulerItem *>(malloc(numberOfItems * sizeof(CEventSchedulerItem)));
+        if (unpackedItems == nullptr) {
+            return -1;
+        }
+    }
+
+    for (int index = 0; index < numberOfItems; index++) {
+        unpackedItems[index] = unpackItem(filePackedItems + (size_t)index * packedItemSize);
+    }
+
+    int result = scheduler.restoreSchedule(unpackedItems, slots(*schedulerRecord), numberOfItems, (time_t)schedulerRecord->secondsFromGMT, schedulerRecord->randomSeed, (time_t)schedulerRecord->localBeginningOfWeek);
+
+    free(unpackedItems);
+
+    return result;
+}
+
+// The bit fields are copied one by one, the layout of bit fields in memory is up to the compiler.
+void CEventSchedulerSnapshotFile::packItem(const CEventSchedulerItem &item, uint8_t *packed) {
+    uint64_t bits = (uint64_t)item.weekDay
+                  | ((uint64_t)item.timeOffset << 3)
+                  | ((uint64_t)item.randomOffsetMinus << 14)
+                  | ((uint64_t)item.randomOffsetPlus << 21)
+                  | ((uint64_t)item.eventType << 28)
+                  | ((uint64_t)item.activeWeekDay << 30)
+                  | ((uint64_t)item.activeTimeOffset << 33)
+                  | ((uint64_t)item.userDefined << 44);
+
+    for (size_t index = 0; index < packedItemSize; index++) {
+        packed[index] = (uint8_t)(bits >> (8 * index));
+    }
+}
+
+CEventSchedulerItem CEventSchedulerSnapshotFile::unpackItem(const uint8_t *packed) {
+    uint64_t bits = 0;
+    for (size_t index = 0; index < packedItemSize; index++) {
+        bits |= (uint64_t)packed[index] << (8 * index);
+    }
+
+    CEventSchedulerItem item;
+    item.weekDay = (CEventSchedulerWeekDay)(bits & 0x7);
+    item.timeOffset = (uint16_t)((bits >> 3) & 0x7ff);
+    item.randomOffsetMinus = (uint8_t)((bits >> 14) & 0x7f);
+    item.randomOffsetPlus = (uint8_t)((bits >> 21) & 0x7f);
+    item.eventType = (CEventSchedulerItemType)((bits >> 28) & 0x3);
+    item.activeWeekDay = (CEventSchedulerWeekDay)((bits >> 30) & 0x7);
+    item.activeTimeOffset = (uint16_t)((bits >> 33) & 0x7ff);
+    item.userDefined = (uint8_t)((bits >> 44) & 0xf);
+
+    return item;
+}
+
+// CRC-32 (IEEE 802.3, as used by zlib and PNG).
+uint32_t CEventSchedulerSnapshotFile::crc32(const void *data, size_t size, uint32_t crc) {
+    // Filled on first use, which is thread safe for a static.
+    struct Table {
+        uint32_t values[256];
+        Table() {
+            for (uint32_t index = 0; index < 256; index++) {
+                uint32_t value = index;
+                for (int bit = 0; bit < 8; bit++) {
+                    value = (value & 1) ? (0xedb88320 ^ (value >> 1)) : (value >> 1);
+                }
+                values[index] = value;
+            }
+        }
+    };
+    static const Table table;
+
+    const uint8_t *bytes = static_cast<const uint8_t *>(data);
+    crc = ~crc;
+    for (size_t index = 0; index < size; index++) {
+        crc = table.values[(crc ^ bytes[index]) & 0xff] ^ (crc >> 8);
+    }
+
+    return ~crc;
+}
+
+const CEventSchedulerSnapshotFile::SchedulerRecord *CEventSchedulerSnapshotFile::record(int schedulerIndex) {
+    if (header == nullptr || schedulerIndex < 0 || schedulerIndex >= (int)header->numberOfSchedulers) {
+        return nullptr;
+    }
+
+    return &records[schedulerIndex];
+}
+
+const uint16_t *CEventSchedulerSnapshotFile::minutesOfWeek(const SchedulerRecord &schedulerRecord) {
+    return reinterpret_cast<const uint16_t *>(data + schedulerRecord.itemsOffset);
+}
+
+const uint16_t *CEventSchedulerSnapshotFile::slots(const SchedulerRecord &schedulerRecord) {
+    return minutesOfWeek(schedulerRecord) + schedulerRecord.numberOfItems;
+}
+
+const uint8_t *CEventSchedulerSnapshotFile::packedItems(const SchedulerRecord &schedulerRecord) {
+    return data + schedulerRecord.itemsOffset + (size_t)schedulerRecord.numberOfItems * 2 * sizeof(uint16_t);
+}
+
+// The index of the first entry after the given time in its week, like the search in
+// CEventSchedulerConcurrentReader::lookup(), and the beginning of that week.
+int CEventSchedulerSnapshotFile::findEntry(const SchedulerRecord &schedulerRecord, time_t timestampGMT, time_t &beginningOfWeek) {
+    const time_t secondsInDay = 24 * 60 * 60;
+    const int numberOfEntries = (int)schedulerRecord.numberOfItems;
+    const uint16_t *fileMinutesOfWeek = minutesOfWeek(schedulerRecord);
+
+    // The week starts on Sunday 00:00 local time, and the epoch was on a Thursday.
+    time_t secondsFromGMT = (time_t)schedulerRecord.secondsFromGMT;
+    time_t localTime = timestampGMT + secondsFromGMT;
+    time_t daysSinceEpoch = localTime / secondsInDay;
+    if ((localTime < 0) && ((localTime % secondsInDay) != 0)) { daysSinceEpoch--; }
+    int daysIntoWeek = (int)(((daysSinceEpoch + 4) % 7 + 7) % 7);
+    beginningOfWeek = (daysSinceEpoch - daysIntoWeek) * secondsInDay - secondsFromGMT;
+    uint16_t minuteOfWeek = (uint16_t)((timestampGMT - beginningOfWeek) / 60);
+
+    return (int)(std::upper_bound(fileMinutesOfWeek, fileMinutesOfWeek + numberOfEntries, minuteOfWeek) - fileMinutesOfWeek);
+}
+
+// Everything that the lookups rely on is checked here once, so that they do not have to check anything anymore.
+bool CEventSchedulerSnapshotFile::isValid(void) {
+    if (memcmp(header->magic, "EVSS", 4) != 0 ||
+        header->version != currentVersion ||
+        header->headerSize != sizeof(FileHeader) ||
+        header->byteOrderMark != byteOrderMark ||
+        header->fileSize != size) {
+        return false;
+    }
+
+    size_t itemsStart = sizeof(FileHeader) + (size_t)header->numberOfSchedulers * sizeof(SchedulerRecord);
+    if (header->numberOfSchedulers > (size - sizeof(FileHeader)) / sizeof(SchedulerRecord)) {
+        return false;
+    }
+
+    if (crc32(data + sizeof(FileHeader), size - sizeof(FileHeader)) != header->checksum) {
+        return false;
+    }
+
+    for (uint32_t index = 0; index < header->numberOfSchedulers; index++) {
+        const SchedulerRecord &schedulerRecord = records[index];
+
+        if (schedulerRecord.numberOfItems > (uint32_t)CEventSchedulerStorage::maximumCapacity ||
+            schedulerRecord.itemsOffset < itemsStart ||
+            (schedulerRecord.itemsOffset % 8) != 0 ||
+            schedulerRecord.itemsOffset > size ||
+            itemBlockSize(schedulerRecord.numberOfItems) > size - schedulerRecord.itemsOffset) {
+            return false;
+        }
+
+        const uint16_t *fileMinutesOfWeek = minutesOfWeek(schedulerRecord);
+        for (uint32_t entry = 0; entry < schedulerRecord.numberOfItems; entry++) {
+            if (fileMinutesOfWeek[entry] >= 7 * 24 * 60 ||
+                (entry > 0 && fileMinutesOfWeek[entry] < fileMinutesOfWeek[entry - 1])) {
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
+
+// The minutes of the week, slots and packed items of one scheduler, rounded up to keep the next block aligned.
+size_t CEventSchedulerSnapshotFile::itemBlockSize(uint32_t numberOfItems) {
+    size_t blockSize = (size_t)numberOfItems * (2 * sizeof(uint16_t) + packedItemSize);
+    return (blockSize + 7) & ~(size_t)7;
+}
@@ -0,0 +1,124 @@
+#include <string.h>
+#include <assert.h>
+
+#include "EventSchedulerStorage.hpp"
+
+// The arrays are laid out in order of decreasing alignment, so no padding is needed between them.
+size_t CEventSchedulerStorage::requiredBufferSize(int capacity) {
+    return capacity * (sizeof(CEventSchedulerItem) +
+                       sizeof(CEventSchedulerScheduleEntry) +
+                       sizeof(uint16_t) +                       // slotGenerations
+                       sizeof(uint16_t) +                       // freeSlots
+                       sizeof(CEventSchedulerSlotState)) +
+           contentIndexSizeForCapacity(capacity) * sizeof(uint16_t);
+}
+
+int CEventSchedulerStorage::capacityForBufferSize(size_t bufferSize) {
+    // The content index takes at least 1.5 entries per slot, so start from the capacity that would fit with exactly
+    // that, and go down until it really fits.
+    size_t bytesPerSlot = requiredBufferSize(2) / 2;
+    size_t capacity = bufferSize / bytesPerSlot;
+    if (capacity > (size_t)maximumCapacity) {
+        capacity = maximumCapacity;
+    }
+    while (capacity > 0 && requiredBufferSize((int)capacity) > bufferSize) {
+        capacity--;
+    }
+    return (int)capacity;
+}
+
+void CEventSchedulerStorage::layoutInBuffer(void *buffer, int capacity) {
+    uint8_t *position = static_cast<uint8_t *>(buffer);
+
+    items = reinterpret_cast<CEventSchedulerItem *>(position);
+    position += capacity * sizeof(CEventSchedulerItem);
+    schedule = reinterpret_cast<CEventSchedulerScheduleEntry *>(position);
+    position += capacity * sizeof(CEventSchedulerScheduleEntry);
+    slotGenerations = reinterpret_cast<uint16_t *>(position);
+    position += capacity * sizeof(uint16_t);
+    freeSlots = reinterpret_cast<uint16_t *>(position);
+    position += capacity * sizeof(uint16_t);
+    contentIndex = reinterpret_cast<uint16_t *>(position);
+    position += contentIndexSizeForCapacity(capacity) * sizeof(uint16_t);
+    slotStates = reinterpret_cast<CEventSchedulerSlotState *>(position);
+
+    this->capacity = capacity;
+    this->contentIndexSize = contentIndexSizeForCapacity(capacity);
+
+    for (int slot = 0; slot < capacity; slot++) {
+        items[slot] = CEventSchedulerItem();
+    }
+}
+
+// Copy the item slots and the schedule from a smaller storage. The free slots and the content index are not copied,
+// as they depend on the capacity, the scheduler rebuilds them.
+void CEventSchedulerStorage::copyItemsFrom(const CEventSchedulerStorage &other) {
+    assert(other.capacity <= capacity);
+
+    memcpy(items, other.items, other.capacity * sizeof(CEventSchedulerItem));
+    memcpy(schedule, other.schedule, other.capacity * sizeof(CEventSchedulerScheduleEntry));
+    memcpy(slotGenerations, other.slotGenerations, other.capacity * sizeof(uint16_t));
+    memcpy(slotStates, other.slotStates, other.capacity * sizeof(CEventSchedulerSlotState));
+}
+
+CEventSchedulerGrowableStorage::CEventSchedulerGrowableStorage(int initialCapacity, void *(*allocate)(size_t), void (*release)(void *)) :
+buffer(nullptr),
+allocate(allocate),
+release(release) {
+    if (initialCapacity < 1) {
+        initialCapacity = 1;
+    }
+    if (initialCapacity > CEventSchedulerStorage::maximumCapacity) {
+        initialCapacity = CEventSchedulerStorage::maximumCapacity;
+    }
+
+    buffer = allocate(CEventSchedulerStorage::requiredBufferSize(initialCapacity));
+    assert(buffer != nullptr);
+    storage.layoutInBuffer(buffer, initialCapacity);
+}
+
+CEventSchedulerGrowableStorage::~CEventSchedulerGrowableStorage() {
+    release(buffer);
+}
+
+CEventSchedulerStorage CEventSchedulerGrowableStorage::storageView(void) {
+    return storage;
+}
+
+bool CEventSchedulerGrowableStorage::resizeStorage(CEventSchedulerStorage &newStorage, int newCapacity) {
+    if (newCapacity > CEventSchedulerStorage::maximumCapacity) {
+        newCapacity = CEventSchedulerStorage::maximumCapacity;
+    }
+    if (newCapacity <= storage.capacity) {
+        return false;
+    }
+
+    void *newBuffer = allocate(CEventSchedulerStorage::requiredBufferSize(newCapacity));
+    if (newBuffer == nullptr) {
+        return false;
+    }
+
+    newStorage.layoutInBuffer(newBuffer, newCapacity);
+    newStorage.copyItemsFrom(storage);
+
+    release(buffer);
+    buffer = newBuffer;
+    storage = newStorage;
+
+    return true;
+}
+
+CEventSchedulerExternalStorage::CEventSchedulerExternalStorage(void *buffer, size_t bufferSize) :
+buffer(buffer),
+bufferSize(bufferSize) {
+}
+
+CEventSchedulerStorage CEventSchedulerExternalStorage::storageView(void) {
+    CEventSchedulerStorage storage;
+    storage.layoutInBuffer(buffer, CEventSchedulerStorage::capacityForBufferSize(bufferSize));
+    return storage;
+}
+
+bool CEventSchedulerExternalStorage::resizeStorage(CEventSchedulerStorage & /* storage */, int /* newCapacity */) {
+    return false;   // The caller owns the buffer
+}
@@ -0,0 +1,365 @@
+#include <string.h>
+
+#include "EventSchedulerTimeZone.hpp"
+
+// Far enough from the times in the table that nothing overflows when an offset is added.
+static const time_t minimumTime = -((time_t)1 << 62);
+static const time_t maximumTime = (time_t)1 << 62;
+
+static const time_t secondsInDay = 24 * 60 * 60;
+
+// Only the current rules of each zone.
+static const struct {
+    const char  *name;
+    const char  *rules;
+} bundledZones[] = {
+    { "UTC",                    "UTC0" },
+    { "Europe/London",          "GMT0BST,M3.5.0/1,M10.5.0" },
+    { "Europe/Dublin",          "GMT0IST,M3.5.0/1,M10.5.0" },
+    { "Europe/Lisbon",          "WET0WEST,M3.5.0/1,M10.5.0" },
+    { "Europe/Amsterdam",       "CET-1CEST,M3.5.0,M10.5.0/3" },
+    { "Europe/Berlin",          "CET-1CEST,M3.5.0,M10.5.0/3" },
+    { "Europe/Brussels",        "CET-1CEST,M3.5.0,M10.5.0/3" },
+    { "Europe/Madrid",          "CET-1CEST,M3.5.0,M10.5.0/3" },
+    { "Europe/Paris",           "CET-1CEST,M3.5.0,M10.5.0/3" },
+    { "Europe/Rome",            "CET-1CEST,M3.5.0,M10.5.0/3" },
+    { "Europe/Stockholm",       "CET-1CEST,M3.5.0,M10.5.0/3" },
+    { "Europe/Athens",          "EET-2EEST,M3.5.0/3,M10.5.0/4" },
+    { "Europe/Helsinki",        "EET-2EEST,M3.5.0/3,M10.5.0/4" },
+    { "Europe/Moscow",          "MSK-3" },
+    { "America/New_York",       "EST5EDT,M3.2.0,M11.1.0" },
+    { "America/Chicago",        "CST6CDT,M3.2.0,M11.1.0" },
+    { "America/Denver",         "MST7MDT,M3.2.0,M11.1.0" },
+    { "America/Phoenix",        "MST7" },
+    { "America/Los_Angeles",    "PST8PDT,M3.2.0,M11.1.0" },
+    { "America/Sao_Paulo",      "<-03>3" },
+    { "Asia/Kolkata",           "IST-5:30" },
+    { "Asia/Shanghai",          "CST-8" },
+    { "Asia/Tokyo",             "JST-9" },
+    { "Australia/Sydney",       "AEST-10AEDT,M10.1.0,M4.1.0/3" },
+    { "Pacific/Auckland",       "NZST-12NZDT,M9.5.0,M4.1.0/3" },
+};
+
+CEventSchedulerTimeZone::CEventSchedulerTimeZone(time_t secondsFromGMT) {
+    spans[0].fromGMT = minimumTime;
+    spans[0].untilGMT = maximumTime;
+    spans[0].secondsFromGMT = secondsFromGMT;
+    spans[0].minimumLocalTime = minimumTime;
+    numberOfSpans = 1;
+}
+
+int CEventSchedulerTimeZone::setRules(const char *rules) {
+    if (rules == nullptr) {
+        return -1;
+    }
+
+    const char *zoneRules = rulesForZone(rules);
+    const char *position = (zoneRules != nullptr) ? zoneRules : rules;
+
+    // std offset [dst [offset] [,start[/time],end[/time]]]. The offsets of POSIX are west of GMT, so negated.
+    int32_t standardOffset;
+    if (!parseName(position) || !parseTime(position, 24, standardOffset)) {
+        return -1;
+    }
+    if (*position == '\0') {
+        *this = CEventSchedulerTimeZone(-(time_t)standardOffset);
+        return 0;
+    }
+
+    if (!parseName(position)) {
+        return -1;
+    }
+    int32_t daylightOffset = standardOffset - 3600;
+    if (*position != '\0' && *position != ',' && !parseTime(position, 24, daylightOffset)) {
+        return -1;
+    }
+
+    Rule start = { Rule::MonthWeekDay, 0, 2, 3, 2 * 3600 };    // Second Sunday of March
+    Rule end = { Rule::MonthWeekDay, 0, 1, 11, 2 * 3600 };     // First Sunday of November
+    if (*position == ',') {
+        position++;
+        if (!parseRule(position, start) || *position != ',') {
+            return -1;
+        }
+        position++;
+        if (!parseRule(position, end)) {
+            return -1;
+        }
+    }
+    if (*position != '\0') {
+        return -1;
+    }
+
+    compile(-(time_t)standardOffset, -(time_t)daylightOffset, start, end);
+
+    return 0;
+}
+
+bool CEventSchedulerTimeZone::hasDaylightSavingTime(void) const {
+    return numberOfSpans > 1;
+}
+
+int CEventSchedulerTimeZone::getNumberOfTransitions(void) const {
+    return numberOfSpans - 1;
+}
+
+time_t CEventSchedulerTimeZone::getSecondsFromGMT(time_t timestampGMT) const {
+    return spans[findSpan(timestampGMT)].secondsFromGMT;
+}
+
+time_t CEventSchedulerTimeZone::localTimeForGMT(time_t timestampGMT) const {
+    const CEventSchedulerTimeZoneSpan &span = spans[findSpan(timestampGMT)];
+    time_t localTime = timestampGMT + span.secondsFromGMT;
+
+    return (localTime > span.minimumLocalTime) ? localTime : span.minimumLocalTime;
+}
+
+// Returns the first moment at which the local time is at least localTime. That is the moment of the transition for a
+// local time that is skipped, and the first one for a local time that is repeated.
+time_t CEventSchedulerTimeZone::gmtForLocalTime(time_t localTime) const {
+    // The first span that reaches localTime before it ends. Local time never goes back, so the spans are in order.
+    int first = 0;
+    int last = numberOfSpans - 1;
+    while (first < last) {
+        int middle = (first + last) / 2;
+        const CEventSchedulerTimeZoneSpan &span = spans[middle];
+        time_t localTimeAtEnd = span.untilGMT - 1 + span.secondsFromGMT;
+        if (localTimeAtEnd < span.minimumLocalTime) {
+            localTimeAtEnd = span.minimumLocalTime;
+        }
+        if (localTimeAtEnd >= localTime) {
+            last = middle;
+        } else {
+            first = middle + 1;
+        }
+    }
+
+    const CEventSchedulerTimeZoneSpan &span = spans[first];
+    if (span.minimumLocalTime >= localTime) {
+        return span.fromGMT;
+    }
+
+    time_t timestampGMT = localTime - span.secondsFromGMT;
+    return (timestampGMT > span.fromGMT) ? timestampGMT : span.fromGMT;
+}
+
+void CEventSchedulerTimeZone::getSpan(time_t timestampGMT, CEventSchedulerTimeZoneSpan &span) const {
+    span = spans[findSpan(timestampGMT)];
+}
+
+const char *CEventSchedulerTimeZone::rulesForZone(const char *name) {
+    for (const auto &zone : bundledZones) {
+        if (strcmp(zone.name, name) == 0) {
+            return zone.rules;
+        }
+    }
+
+    return nullptr;
+}
+
+// The last span that starts at or before the timestamp. The first one starts before any timestamp.
+int CEventSchedulerTimeZone::findSpan(time_t timestampGMT) const {
+    int first = 0;
+    int last = numberOfSpans - 1;
+    while (first < last) {
+        int middle = (first + last + 1) / 2;
+        if (spans[middle].fromGMT <= timestampGMT) {
+            first = middle;
+        } else {
+            last = middle - 1;
+        }
+    }
+
+    return first;
+}
+
+// Calculate the two transitions of every year, and make a span for each. When the clock moves back, the local time
+// is held at the last second before the transition, until it has caught up.
+void CEventSchedulerTimeZone::compile(time_t standardSecondsFromGMT, time_t daylightSecondsFromGMT, const Rule &start, const Rule &end) {
+    if (standardSecondsFromGMT == daylightSecondsFromGMT) {
+        *this = CEventSchedulerTimeZone(standardSecondsFromGMT);
+        return;
+    }
+
+    numberOfSpans = 0;
+
+    for (int year = firstYear; year <= lastYear; year++) {
+        // The start is in standard time, the end in daylight saving time.
+        time_t startGMT = daysSinceEpochForRule(year, start) * secondsInDay + start.time - standardSecondsFromGMT;
+        time_t endGMT = daysSinceEpochForRule(year, end) * secondsInDay + end.time - daylightSecondsFromGMT;
+
+        struct {
+            time_t  timestampGMT;
+            time_t  secondsFromGMT;
+        } transitions[2] = {
+            { startGMT, daylightSecondsFromGMT },
+            { endGMT, standardSecondsFromGMT }
+        };
+        if (endGMT < startGMT) {
+            // Southern hemisphere, daylight saving time at the beginning of the year
+            transitions[0] = { endGMT, standardSecondsFromGMT };
+            transitions[1] = { startGMT, daylightSecondsFromGMT };
+        }
+
+        if (numberOfSpans == 0) {
+            spans[0].fromGMT = minimumTime;
+            spans[0].secondsFromGMT = (transitions[0].secondsFromGMT == daylightSecondsFromGMT) ? standardSecondsFromGMT : daylightSecondsFromGMT;
+            spans[0].minimumLocalTime = minimumTime;
+            numberOfSpans = 1;
+        }
+
+        for (const auto &transition : transitions) {
+            CEventSchedulerTimeZoneSpan &previous = spans[numberOfSpans - 1];
+            if (transition.timestampGMT <= previous.fromGMT || transition.secondsFromGMT == previous.secondsFromGMT) {
+                continue; // Rules that overlap
+            }
+
+            CEventSchedulerTimeZoneSpan &span = spans[numberOfSpans++];
+            previous.untilGMT = transition.timestampGMT;
+            span.fromGMT = transition.timestampGMT;
+            span.secondsFromGMT = transition.secondsFromGMT;
+            span.minimumLocalTime = (transition.secondsFromGMT < previous.secondsFromGMT) ? transition.timestampGMT + previous.secondsFromGMT - 1 : minimumTime;
+        }
+    }
+
+    spans[numberOfSpans - 1].untilGMT = maximumTime;
+}
+
+// A name of at least three letters, or anything between '<' and '>', e.g. "<-03>".
+bool CEventSchedulerTimeZone::parseName(const char *&position) {
+    const char *start = position;
+
+    if (*position == '<') {
+        position++;
+        start = position;
+        while (*position != '\0' && *position != '>') {
+            position++;
+        }
+        if (*position != '>' || position - start < 3) {
+            return false;
+        }
+        position++;
+        return true;
+    }
+
+    while ((*position >= 'A' && *position <= 'Z') || (*position >= 'a' && *position <= 'z')) {
+        position++;
+    }
+
+    return position - start >= 3;
+}
+
+// [+|-]hh[:mm[:ss]]
+bool CEventSchedulerTimeZone::parseTime(const char *&position, int maximumHours, int32_t &seconds) {
+    int sign = 1;
+    if (*position == '+' || *position == '-') {
+        sign = (*position == '-') ? -1 : 1;
+        position++;
+    }
+
+    int32_t parts[3] = { 0, 0, 0 };
+    for (int part = 0; part < 3; part++) {
+        if (part > 0) {
+            if (*position != ':') {
+                break;
+            }
+            position++;
+        }
+        if (*position < '0' || *position > '9') {
+            return false;
+        }
+        for (int digits = 0; *position >= '0' && *position <= '9'; digits++, position++) {
+            if (digits == 3) {
+                return false;
+            }
+            parts[part] = parts[part] * 10 + (*position - '0');
+        }
+    }
+
+    if (parts[0] > maximumHours || parts[1] > 59 || parts[2] > 59) {
+        return false;
+    }
+
+    seconds = sign * (parts[0] * 3600 + parts[1] * 60 + parts[2]);
+
+    return true;
+}
+
+// Jn, n or Mm.w.d, and an optional /time.
+bool CEventSchedulerTimeZone::parseRule(const char *&position, Rule &rule) {
+    auto parseNumber = [&position](int minimum, int maximum, int &value) {
+        if (*position < '0' || *position > '9') {
+            return false;
+        }
+        value = 0;
+        while (*position >= '0' && *position <= '9' && value <= maximum) {
+            value = value * 10 + (*position++ - '0');
+        }
+        return value >= minimum && value <= maximum;
+    };
+
+    if (*position == 'J') {
+        position++;
+        rule.form = Rule::Julian;
+        if (!parseNumber(1, 365, rule.day)) {
+            return false;
+        }
+    } else if (*position == 'M') {
+        position++;
+        rule.form = Rule::MonthWeekDay;
+        if (!parseNumber(1, 12, rule.month) || *position++ != '.' ||
+            !parseNumber(1, 5, rule.week) || *position++ != '.' ||
+            !parseNumber(0, 6, rule.day)) {
+            return false;
+        }
+    } else {
+        rule.form = Rule::ZeroBasedJulian;
+        if (!parseNumber(0, 365, rule.day)) {
+            return false;
+        }
+    }
+
+    rule.time = 2 * 3600;
+    if (*position == '/') {
+        position++;
+        return parseTime(position, 167, rule.time);
+    }
+
+    return true;
+}
+
+time_t CEventSchedulerTimeZone::daysSinceEpochForRule(int year, const Rule &rule) {
+    bool isLeapYear = (year % 4 == 0 && year % 100 != 0) || year % 400 == 0;
+
+    switch (rule.form) {
+        case Rule::Julian:
+            // February 29 is never counted
+            return daysFromCivil(year, 1, 1) + rule.day - 1 + ((isLeapYear && rule.day >= 60) ? 1 : 0);
+        case Rule::ZeroBasedJulian:
+            return daysFromCivil(year, 1, 1) + rule.day;
+        default: {
+            static const int daysInMonth[] = { 31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31 };
+            int daysInThisMonth = daysInMonth[rule.month - 1] + ((rule.month == 2 && isLeapYear) ? 1 : 0);
+
+            // The epoch was on a Thursday.
+            time_t firstDayOfMonth = daysFromCivil(year, rule.month, 1);
+            int weekDayOfFirstDay = (int)(((firstDayOfMonth + 4) % 7 + 7) % 7);
+            int day = (rule.day - weekDayOfFirstDay + 7) % 7 + (rule.week - 1) * 7;
+            while (day >= daysInThisMonth) {
+                day -= 7;   // Week 5 is the last one
+            }
+            return firstDayOfMonth + day;
+        }
+    }
+}
+
+// Days since 1970-01-01 of a date in the proleptic Gregorian calendar.
+time_t CEventSchedulerTimeZone::daysFromCivil(int year, int month, int day) {
+    year -= (month <= 2) ? 1 : 0;
+    time_t era = (year >= 0 ? year : year - 399) / 400;
+    time_t yearOfEra = year - era * 400;
+    time_t dayOfYear = (153 * (month > 2 ? month - 3 : month + 9) + 2) / 5 + day - 1;
+    time_t dayOfEra = yearOfEra * 365 + yearOfEra / 4 - yearOfEra / 100 + dayOfYear;
+
+    return era * 146097 + dayOfEra - 719468;
+}
@@ -0,0 +1,309 @@
+#include <stdlib.h>
+
+#include "EventSchedulerTimingWheel.hpp"
+
+CEventSchedulerTimingWheel::CEventSchedulerTimingWheel(time_t currentTimeGMT, int initialCapacity) :
+nodes(nullptr),
+capacity(0),
+firstFreeNode(noNode),
+expiredTail(noNode),
+currentTime(currentTimeGMT) {
+    for (int list = 0; list < numberOfLists; list++) {
+        listHeads[list] = noNode;
+    }
+    for (int level = 0; level < numberOfLevels; level++) {
+        occupiedBuckets[level] = 0;
+    }
+
+    // Start with the given capacity, grow() doubles it.
+    capacity = (initialCapacity < 1) ? 1 : initialCapacity / 2;
+    if (!grow()) {
+        capacity = 0;
+    }
+}
+
+CEventSchedulerTimingWheel::~CEventSchedulerTimingWheel() {
+    free(nodes);
+}
+
+CEventSchedulerTimerHandle CEventSchedulerTimingWheel::add(time_t expiryTimeGMT, const CEventSchedulerItem &item) {
+    if (firstFreeNode == noNode && !grow()) {
+        return -1; // No memory left
+    }
+
+    uint32_t index = firstFreeNode;
+    firstFreeNode = nodes[index].next;
+
+    nodes[index].expiryTimeGMT = expiryTimeGMT;
+    nodes[index].item = item;
+    insert(index);
+
+    numberOfTimers++;
+
+    return ((CEventSchedulerTimerHandle)nodes[index].generation << 24) | (CEventSchedulerTimerHandle)index;
+}
+
+int CEventSchedulerTimingWheel::cancel(CEventSchedulerTimerHandle handle) {
+    int index = indexForHandle(handle);
+    if (index < 0) {
+        return -1; // Expired, cancelled, or never existed
+    }
+
+    unlink(index);
+    releaseNode(index);
+
+    return 0;
+}
+
+void CEventSchedulerTimingWheel::advance(time_t timestampGMT, CEventSchedulerTimerCallback callback, void *context) {
+    while (true) {
+        // Expire everything that is due. The callback may add or cancel timers.
+        while (listHeads[expiredList] != noNode) {
+            uint32_t index = listHeads[expiredList];
+            CEventSchedulerTimerHandle handle = ((CEventSchedulerTimerHandle)nodes[index].generation << 24) | (CEventSchedulerTimerHandle)index;
+            time_t expiryTimeGMT = nodes[index].expiryTimeGMT;
+            CEventSchedulerItem item = nodes[index].item;
+
+            unlink(index);
+            releaseNode(index);
+
+            if (callback != nullptr) {
+                callback(handle, expiryTimeGMT, item, context);
+            }
+        }
+
+        if (currentTime >= timestampGMT) {
+            return;
+        }
+
+        // Jump to the first bucket that has timers, or to the start of the next overflow period.
+        time_t nextTime;
+        int level, bucket;
+        if (findFirstBucket(level, bucket)) {
+            nextTime = bucketStartTime(level, bucket);
+        } else if (listHeads[overflowList] != noNode) {
+            nextTime = ((currentTime >> (numberOfLevels * bitsPerLevel)) + 1) << (numberOfLevels * bitsPerLevel);
+        } else {
+            nextTime = timestampGMT;
+        }
+
+        moveTo(nextTime < timestampGMT ? nextTime : timestampGMT);
+    }
+}
+
+// Without timers in the levels, the first timer is in the overflow list, which is not sorted.
+time_t CEventSchedulerTimingWheel::getNextExpiryTime(CEventSchedulerItem *item) {
+    int list;
+    int level, bucket;
+
+    if (listHeads[expiredList] != noNode) {
+        list = expiredList;
+    } else if (findFirstBucket(level, bucket)) {
+        list = level * bucketsPerLevel + bucket;
+    } else if (listHeads[overflowList] != noNode) {
+        list = overflowList;
+    } else {
+        return -1;
+    }
+
+    // All timers in a level 0 bucket expire at the same second, in other lists they have to be compared.
+    uint32_t first = listHeads[list];
+    for (uint32_t index = nodes[first].next; index != noNode; index = nodes[index].next) {
+        if (nodes[index].expiryTimeGMT < nodes[first].expiryTimeGMT) {
+            first = index;
+        }
+    }
+
+    if (item != nullptr) {
+        *item = nodes[first].item;
+    }
+    return nodes[first].expiryTimeGMT;
+}
+
+time_t CEventSchedulerTimingWheel::getCurrentTime(void) {
+    return currentTime;
+}
+
+int CEventSchedulerTimingWheel::getNumberOfTimers(void) {
+    return numberOfTimers;
+}
+
+bool CEventSchedulerTimingWheel::grow(void) {
+    int newCapacity = capacity * 2;
+    if (newCapacity > maximumCapacity) {
+        newCapacity = maximumCapacity;
+    }
+    if (newCapacity <= capacity) {
+        return false;
+    }
+
+    Node *newNodes = static_cast<Node *>(realloc(nodes, newCapacity * sizeof(Node)));
+    if (newNodes == nullptr) {
+        return false;
+    }
+    nodes = newNodes;
+
+    // Chain the new nodes in front of the free list, lowest index first.
+    for (int index = newCapacity - 1; index >= capacity; index--) {
+        nodes[index].list = numberOfLists;
+        nodes[index].generation = 1;
+        nodes[index].next = firstFreeNode;
+        firstFreeNode = index;
+    }
+    capacity = newCapacity;
+
+    return true;
+}
+
+// Put the node in the list that belongs to its expiry time, relative to the current time.
+void CEventSchedulerTimingWheel::insert(uint32_t index) {
+    time_t expiryTimeGMT = nodes[index].expiryTimeGMT;
+
+    if (expiryTimeGMT <= currentTime) {
+        linkExpired(index);
+        return;
+    }
+
+    uint64_t differentBits = (uint64_t)(expiryTimeGMT ^ currentTime);
+    if ((differentBits >> (numberOfLevels * bitsPerLevel)) != 0) {
+        link(index, overflowList);
+        return;
+    }
+
+    int level = (63 - __builtin_clzll(differentBits)) / bitsPerLevel;
+    int bucket = (int)((expiryTimeGMT >> (level * bitsPerLevel)) & (bucketsPerLevel - 1));
+    link(index, level * bucketsPerLevel + bucket);
+}
+
+void CEventSchedulerTimingWheel::link(uint32_t index, int list) {
+    nodes[index].list = list;
+    nodes[index].previous = noNode;
+    nodes[index].next = listHeads[list];
+    if (listHeads[list] != noNode) {
+        nodes[listHeads[list]].previous = index;
+    }
+    listHeads[list] = index;
+
+    if (list < overflowList) {
+        occupiedBuckets[list / bucketsPerLevel] |= (uint64_t)1 << (list % bucketsPerLevel);
+    }
+}
+
+// The expired list is kept in order of expiry time, so that advance() can expire in order. Timers normally come in
+// that order already (a whole bucket at the same second, or timers that were added for 'now'), so searching from the
+// tail is cheap.
+void CEventSchedulerTimingWheel::linkExpired(uint32_t index) {
+    uint32_t previous = expiredTail;
+    while (previous != noNode && nodes[previous].expiryTimeGMT > nodes[index].expiryTimeGMT) {
+        previous = nodes[previous].previous;
+    }
+
+    nodes[index].list = expiredList;
+    nodes[index].previous = previous;
+    if (previous == noNode) {
+        nodes[index].next = listHeads[expiredList];
+        listHeads[expiredList] = index;
+    } else {
+        nodes[index].next = nodes[previous].next;
+        nodes[previous].next = index;
+    }
+    if (nodes[index].next != noNode) {
+        nodes[nodes[index].next].previous = index;
+    } else {
+        expiredTail = index;
+    }
+}
+
+void CEventSchedulerTimingWheel::unlink(uint32_t index) {
+    int list = nodes[index].list;
+
+    if (index == expiredTail) {
+        expiredTail = nodes[index].previous;
+    }
+
+    if (nodes[index].previous != noNode) {
+        nodes[nodes[index].previous].next = nodes[index].next;
+    } else {
+        listHeads[list] = nodes[index].next;
+    }
+    if (nodes[index].next != noNode) {
+        nodes[nodes[index].next].previous = nodes[index].previous;
+    }
+
+    if (list < overflowList && listHeads[list] == noNode) {
+        occupiedBuckets[list / bucketsPerLevel] &= ~((uint64_t)1 << (list % bucketsPerLevel));
+    }
+}
+
+void CEventSchedulerTimingWheel::releaseNode(uint32_t index) {
+    nodes[index].list = numberOfLists;
+    nodes[index].generation = (nodes[index].generation % maximumGeneration) + 1;
+    nodes[index].next = firstFreeNode;
+    firstFreeNode = index;
+
+    numberOfTimers--;
+}
+
+// Move the current time forward, to a time that is not after the first timer. The buckets that the new time falls
+// in are emptied into the lower levels, from high to low, and what is due at the new time goes to the expired list.
+void CEventSchedulerTimingWheel::moveTo(time_t timestampGMT) {
+    bool newOverflowPeriod = ((timestampGMT ^ currentTime) >> (numberOfLevels * bitsPerLevel)) != 0;
+
+    currentTime = timestampGMT;
+
+    if (newOverflowPeriod) {
+        cascade(overflowList);
+    }
+    for (int level = numberOfLevels - 1; level >= 0; level--) {
+        int bucket = (int)((currentTime >> (level * bitsPerLevel)) & (bucketsPerLevel - 1));
+        cascade(level * bucketsPerLevel + bucket);
+    }
+}
+
+// Take all nodes out of the list, and insert them again relative to the current time.
+void CEventSchedulerTimingWheel::cascade(int list) {
+    uint32_t index = listHeads[list];
+
+    listHeads[list] = noNode;
+    if (list < overflowList) {
+        occupiedBuckets[list / bucketsPerLevel] &= ~((uint64_t)1 << (list % bucketsPerLevel));
+    }
+
+    while (index != noNode) {
+        uint32_t next = nodes[index].next;
+        insert(index);
+        index = next;
+    }
+}
+
+// The first timer is in the lowest level that has timers, in its first bucket after the current time. All buckets of
+// a level are after the current time, as the timers in a level differ from the current time in that level's group.
+bool CEventSchedulerTimingWheel::findFirstBucket(int &level, int &bucket) {
+    for (level = 0; level < numberOfLevels; level++) {
+        if (occupiedBuckets[level] != 0) {
+            bucket = __builtin_ctzll(occupiedBuckets[level]);
+            return true;
+        }
+    }
+    return false;
+}
+
+// The first second that falls in the bucket, for the current time.
+time_t CEventSchedulerTimingWheel::bucketStartTime(int level, int bucket) {
+    int shift = (level + 1) * bitsPerLevel;
+    return ((currentTime >> shift) << shift) | ((time_t)bucket << (level * bitsPerLevel));
+}
+
+int CEventSchedulerTimingWheel::indexForHandle(CEventSchedulerTimerHandle handle) {
+    if (handle < 0) {
+        return -1;
+    }
+
+    int index = handle & (maximumCapacity - 1);
+    int generation = handle >> 24;
+    if (index >= capacity || nodes[index].list == numberOfLists || nodes[index].generation != generation) {
+        return -1;
+    }
+
+    return index;
+}
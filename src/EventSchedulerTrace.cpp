@@ -0,0 +1,43 @@
+#include <stdio.h>
+
+#include "EventSchedulerTrace.hpp"
+
+CEventSchedulerTraceSink CEventSchedulerTrace::sink = CEventSchedulerTrace::writeToStandardError;
+void *CEventSchedulerTrace::sinkContext = nullptr;
+
+void CEventSchedulerTrace::setSink(CEventSchedulerTraceSink newSink, void *context) {
+    sink = newSink;
+    sinkContext = context;
+}
+
+// Messages longer than the buffer are cut off.
+void CEventSchedulerTrace::write(CEventSchedulerTraceLevel_Value level, const char *file, int line, const char *format, ...) {
+    if (sink == nullptr) {
+        return;
+    }
+
+    char message[256];
+
+    va_list arguments;
+    va_start(arguments, format);
+    vsnprintf(message, sizeof(message), format, arguments);
+    va_end(arguments);
+
+    sink(level, file, line, message, sinkContext);
+}
+
+const char *CEventSchedulerTrace::levelAsString(CEventSchedulerTraceLevel_Value level) {
+    switch (level) {
+        case CEventSchedulerTraceLevel_Off: return "Off";
+        case CEventSchedulerTraceLevel_Error: return "Error";
+        case CEventSchedulerTraceLevel_Warning: return "Warning";
+        case CEventSchedulerTraceLevel_Info: return "Info";
+        case CEventSchedulerTraceLevel_Debug: return "Debug";
+        case CEventSchedulerTraceLevel_Verbose: return "Verbose";
+        default: return "Invalid";
+    }
+}
+
+void CEventSchedulerTrace::writeToStandardError(CEventSchedulerTraceLevel_Value level, const char *file, int line, const char *message, void * /* context */) {
+    fprintf(stderr, "[%s] %s:%d: %s\n", levelAsString(level), file, line, message);
+}
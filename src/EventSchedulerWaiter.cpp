@@ -0,0 +1,95 @@
+#include <errno.h>
+#include <stdint.h>
+#include <chrono>
+
+#ifdef __linux__
+#include <unistd.h>
+#include <poll.h>
+#include <sys/timerfd.h>
+#include <sys/eventfd.h>
+#endif
+
+#include "EventSchedulerWaiter.hpp"
+
+CEventSchedulerWaiter::CEventSchedulerWaiter() {
+#ifdef __linux__
+    timerFd = timerfd_create(CLOCK_REALTIME, TFD_CLOEXEC);
+    eventFd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+#endif
+}
+
+CEventSchedulerWaiter::~CEventSchedulerWaiter() {
+#ifdef __linux__
+    if (timerFd >= 0) { close(timerFd); }
+    if (eventFd >= 0) { close(eventFd); }
+#endif
+}
+
+bool CEventSchedulerWaiter::isValid(void) {
+#ifdef __linux__
+    return timerFd >= 0 && eventFd >= 0;
+#else
+    return true;
+#endif
+}
+
+bool CEventSchedulerWaiter::waitUntil(time_t timestampGMT) {
+#ifdef __linux__
+    struct itimerspec timerSpec = {};
+    if (timestampGMT > 0) {
+        timerSpec.it_value.tv_sec = timestampGMT;
+    }
+    timerfd_settime(timerFd, TFD_TIMER_ABSTIME | TFD_TIMER_CANCEL_ON_SET, &timerSpec, nullptr);
+
+    struct pollfd pollFds[2] = {
+        { timerFd, POLLIN, 0 },
+        { eventFd, POLLIN, 0 }
+    };
+
+    while (poll(pollFds, 2, -1) < 0) {
+        if (errno != EINTR) {
+            return false;
+        }
+    }
+
+    bool timerExpired = false;
+    uint64_t counter;
+    if (pollFds[0].revents & POLLIN) {
+        // Fails with ECANCELED when the clock was set, which is just another reason to wake up.
+        timerExpired = (read(timerFd, &counter, sizeof(counter)) == sizeof(counter));
+    }
+    if (pollFds[1].revents & POLLIN) {
+        if (read(eventFd, &counter, sizeof(counter)) < 0) {
+            // Nothing to do, the eventfd is only used to wake up
+        }
+    }
+
+    return timerExpired;
+#else
+    std::unique_lock<std::mutex> lock(waitMutex);
+    bool timerExpired = false;
+    if (timestampGMT > 0) {
+        timerExpired = !waitCondition.wait_until(lock, std::chrono::system_clock::from_time_t(timestampGMT), [this]() { return wakeUpRequested; });
+    } else {
+        waitCondition.wait(lock, [this]() { return wakeUpRequested; });
+    }
+    wakeUpRequested = false;
+
+    return timerExpired;
+#endif
+}
+
+void CEventSchedulerWaiter::wakeUp(void) {
+#ifdef __linux__
+    uint64_t one = 1;
+    if (write(eventFd, &one, sizeof(one)) < 0) {
+        // The counter can only overflow when nobody reads it, the waiter is awake already then.
+    }
+#else
+    {
+        std::lock_guard<std::mutex> lock(waitMutex);
+        wakeUpRequested = true;
+    }
+    waitCondition.notify_one();
+#endif
+}
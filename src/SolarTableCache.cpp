@@ -0,0 +1,158 @@
+#include <math.h>
+#include <string.h>
+
+#include "SolarTableCache.hpp"
+
+CSolarTableCache::CSolarTableCache(int numberOfEntries, double quantizationDegrees) :
+quantizationDegrees(quantizationDegrees) {
+    // Round the number of sets up to a power of two, so that a set can be selected with a mask.
+    numberOfSets = 1;
+    while (numberOfSets * waysPerSet < numberOfEntries) {
+        numberOfSets *= 2;
+    }
+
+    entries = new Entry[numberOfSets * waysPerSet];
+    clear();
+}
+
+CSolarTableCache::~CSolarTableCache() {
+    delete[] entries;
+}
+
+bool CSolarTableCache::lookup(double latitude, double longitude, time_t beginningOfDayGMT, time_t &sunRise, time_t &sunSet, CSunriseCalculatorMode mode) {
+    int32_t latitudeKey = quantize(latitude);
+    int32_t longitudeKey = quantize(longitude);
+
+    std::lock_guard<std::mutex> lock(mutex);
+
+    Entry *set = setForKey(latitudeKey, longitudeKey, beginningOfDayGMT, mode);
+    for (int way = 0; way < waysPerSet; way++) {
+        Entry &entry = set[way];
+        if (isKey(entry, latitudeKey, longitudeKey, beginningOfDayGMT, mode)) {
+            sunRise = entry.sunRise;
+            sunSet = entry.sunSet;
+
+            // Move to the front, the entries of a set are kept in order of last use.
+            Entry found = entry;
+            memmove(&set[1], &set[0], way * sizeof(Entry));
+            set[0] = found;
+
+            hits++;
+            return true;
+        }
+    }
+
+    misses++;
+    return false;
+}
+
+void CSolarTableCache::store(double latitude, double longitude, time_t beginningOfDayGMT, time_t sunRise, time_t sunSet, CSunriseCalculatorMode mode) {
+    int32_t latitudeKey = quantize(latitude);
+    int32_t longitudeKey = quantize(longitude);
+
+    std::lock_guard<std::mutex> lock(mutex);
+
+    // An entry that is already there (e.g. two schedulers missed the same day at once) moves to the front. Otherwise,
+    // the least recently used entry is at the end of the set, it makes room for the new one at the front.
+    Entry *set = setForKey(latitudeKey, longitudeKey, beginningOfDayGMT, mode);
+    int way = 0;
+    while (way < waysPerSet - 1 && !isKey(set[way], latitudeKey, longitudeKey, beginningOfDayGMT, mode)) {
+        way++;
+    }
+    memmove(&set[1], &set[0], way * sizeof(Entry));
+
+    set[0].latitudeKey = latitudeKey;
+    set[0].longitudeKey = longitudeKey;
+    set[0].mode = mode;
+    set[0].beginningOfDayGMT = beginningOfDayGMT;
+    set[0].sunRise = sunRise;
+    set[0].sunSet = sunSet;
+}
+
+void CSolarTableCache::sunRiseAndSetForDay(CSunriseCalculator &calculator, time_t beginningOfDayGMT, time_t &sunRise, time_t &sunSet) {
+    if (lookup(calculator.getLatitude(), calculator.getLongitude(), beginningOfDayGMT, sunRise, sunSet, calculator.getMode())) {
+        return;
+    }
+
+    calculator.sunRiseAndSetForTimestamp(beginningOfDayGMT, 0, sunRise, sunSet);
+    store(calculator.getLatitude(), calculator.getLongitude(), beginningOfDayGMT, sunRise, sunSet, calculator.getMode());
+}
+
+int CSolarTableCache::prefill(double latitude, double longitude, time_t secondsFromGMT, time_t firstBeginningOfDayGMT, int numberOfDays, CSunriseCalculatorMode mode) {
+    CSunriseCalculator calculator(latitude, longitude, mode);
+
+    // Line up with the beginning of the local day, like the scheduler does.
+    time_t localTime = firstBeginningOfDayGMT + secondsFromGMT;
+    time_t daysSinceEpoch = localTime / 86400;
+    if ((localTime < 0) && (localTime % 86400 != 0)) { daysSinceEpoch--; }
+    time_t beginningOfDayGMT = daysSinceEpoch * 86400 - secondsFromGMT;
+
+    // More days than there are entries would only push out the first days again.
+    if (numberOfDays > numberOfSets * waysPerSet) {
+        numberOfDays = numberOfSets * waysPerSet;
+    }
+
+    // Calculate in blocks with the batch calculation, which is much faster than day by day.
+    const int blockSize = 64;
+    time_t days[blockSize], sunRises[blockSize], sunSets[blockSize];
+
+    for (int firstDay = 0; firstDay < numberOfDays; firstDay += blockSize) {
+        int blockCount = (numberOfDays - firstDay < blockSize) ? numberOfDays - firstDay : blockSize;
+        for (int day = 0; day < blockCount; day++) {
+            days[day] = beginningOfDayGMT + (time_t)(firstDay + day) * 86400;
+        }
+        calculator.sunRiseAndSetForDays(days, blockCount, sunRises, sunSets);
+        for (int day = 0; day < blockCount; day++) {
+            store(latitude, longitude, days[day], sunRises[day], sunSets[day], mode);
+        }
+    }
+
+    return numberOfDays;
+}
+
+void CSolarTableCache::clear(void) {
+    std::lock_guard<std::mutex> lock(mutex);
+
+    for (int index = 0; index < numberOfSets * waysPerSet; index++) {
+        entries[index].latitudeKey = unusedKey;
+        entries[index].longitudeKey = unusedKey;
+        entries[index].mode = CSunriseCalculatorMode_Exact;
+        entries[index].beginningOfDayGMT = 0;
+    }
+    hits = 0;
+    misses = 0;
+}
+
+int CSolarTableCache::getNumberOfEntries(void) {
+    return numberOfSets * waysPerSet;
+}
+
+uint32_t CSolarTableCache::getHits(void) {
+    std::lock_guard<std::mutex> lock(mutex);
+    return hits;
+}
+
+uint32_t CSolarTableCache::getMisses(void) {
+    std::lock_guard<std::mutex> lock(mutex);
+    return misses;
+}
+
+int32_t CSolarTableCache::quantize(double degrees) {
+    return (int32_t)lround(degrees / quantizationDegrees);
+}
+
+CSolarTableCache::Entry *CSolarTableCache::setForKey(int32_t latitudeKey, int32_t longitudeKey, time_t beginningOfDayGMT, CSunriseCalculatorMode mode) {
+    uint64_t hash = (uint64_t)(uint32_t)latitudeKey;
+    hash = hash * 0x9e3779b97f4a7c15ull + (uint32_t)longitudeKey;
+    hash = hash * 0x9e3779b97f4a7c15ull + (uint64_t)(beginningOfDayGMT / 3600);
+    hash = hash * 0x9e3779b97f4a7c15ull + (uint64_t)mode;
+    hash ^= hash >> 29;
+    hash *= 0xbf58476d1ce4e5b9ull;
+    hash ^= hash >> 32;
+
+    return &entries[(hash & (numberOfSets - 1)) * waysPerSet];
+}
+
+bool CSolarTableCache::isKey(const Entry &entry, int32_t latitudeKey, int32_t longitudeKey, time_t beginningOfDayGMT, CSunriseCalculatorMode mode) {
+    return entry.latitudeKey == latitudeKey && entry.longitudeKey == longitudeKey && entry.beginningOfDayGMT == beginningOfDayGMT && entry.mode == mode;
+}
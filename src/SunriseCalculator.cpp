@@ -1,9 +1,13 @@
 #include <ctime>
 #include <cmath>
-#include <iostream>
 
 #include "SunriseCalculator.hpp"
 
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#include <immintrin.h>
+#define SUNRISE_CALCULATOR_HAS_AVX2_KERNEL
+#endif
+
 // https://en.wikipedia.org/wiki/Sunrise_equation
 
 #define UNIX_TO_JULIAN(unixTime) (((double)(unixTime) / 86400.0) + 2440587.5)
@@ -12,9 +16,9 @@
 #define DEG_TO_RAD(x) (((double)x) * M_PI / 180.0)
 #define RAD_TO_DEG(x) (((double)x) * 180.0 / M_PI)
 
-void CSunriseCalculator::sunRiseAndSetForTimestamp(time_t timestampGMT, time_t secondsFromGMT, time_t &sunRise, time_t &sunSet) {
+static void sunRiseAndSetScalar(time_t timestampGMT, double latitude, double longitude, time_t &sunRise, time_t &sunSet) {
     // Calculate Julian day of year
-    double julianDayOfYear = ceil(UNIX_TO_JULIAN(timestampGMT + secondsFromGMT) - (2451545.0 + 0.0009) + (69.184 / 86400.0));
+    double julianDayOfYear = ceil(UNIX_TO_JULIAN(timestampGMT) - (2451545.0 + 0.0009) + (69.184 / 86400.0));
     // Mean solar time
     double meanSolarTime = julianDayOfYear + 0.0009 - (longitude / 360.0);
     // Solar mean anomaly
@@ -32,7 +36,6 @@ void CSunriseCalculator::sunRiseAndSetForTimestamp(time_t timestampGMT, time_t s
                          meanSolarTime +
                          0.0053 * std::sin(DEG_TO_RAD(solarMeanAnomaly)) - 
                          0.0069 * std::sin(2 * DEG_TO_RAD(eclipticLongitude));
-    time_t solarTransitTime = static_cast<std::time_t>(JULIAN_TO_UNIX(solarTransit));
     // Declination of the sun
     double sunDecline = RAD_TO_DEG(std::asin(std::sin(DEG_TO_RAD(eclipticLongitude)) * 
                                   std::sin(DEG_TO_RAD(23.4393))));
@@ -47,3 +50,344 @@ void CSunriseCalculator::sunRiseAndSetForTimestamp(time_t timestampGMT, time_t s
     sunRise = static_cast<std::time_t>(JULIAN_TO_UNIX(sunriseJulianDay));
     sunSet = static_cast<std::time_t>(JULIAN_TO_UNIX(sunsetJulianDay));
 }
+
+// NOTES
+//
+// The fast mode does the same calculation, but without any calls to libm sin/cos/asin/acos, for controllers without
+// an FPU. Everything that only depends on the solar mean anomaly (the solar transit correction, and the sine and
+// cosine of the declination of the sun) is looked up in tables with SUNRISE_CALCULATOR_FAST_STEPS_PER_DEGREE entries
+// per degree, and interpolated linearly. The tables are built once, the first time the fast mode is used. The sine and
+// cosine of the latitude are calculated when the calculator is constructed. What is left is one acos, which is done
+// with a polynomial (Abramowitz & Stegun 4.4.46, error below 2e-8 radians).
+//
+// The error against the exact mode, measured with doSunriseAccuracyTests() in main.cpp over the years 2000-2100 for
+// every day and every whole degree of latitude from -66 to +66. Near the polar circles, on days with less than 2 or
+// more than 22 hours of daylight, the sunrise moves quickly with the declination, so the error is larger there:
+//
+//     Steps per degree    Tables      Worst case      Worst case near polar day/night     Days with/without sunrise differ
+//     1                   4 KB        3 s             60 s                                6 of 4.8 million
+//     2                   9 KB        1 s             23 s                                2
+//     4 (default)         17 KB       1 s             7 s                                 0
+//
+// For comparison, the sunrise equation itself is only accurate to about a minute.
+
+#ifndef SUNRISE_CALCULATOR_FAST_STEPS_PER_DEGREE
+#define SUNRISE_CALCULATOR_FAST_STEPS_PER_DEGREE 4
+#endif
+
+// sin(x) with a Taylor series, for building the tables without libm.
+static double approximateSin(double radians) {
+    double turns = radians / (2.0 * M_PI);
+    radians -= 2.0 * M_PI * (double)(long long)(turns + (turns < 0 ? -0.5 : 0.5));     // -pi..pi
+    if (radians > M_PI / 2.0) radians = M_PI - radians;                                 // -pi/2..pi/2
+    if (radians < -M_PI / 2.0) radians = -M_PI - radians;
+
+    double radians2 = radians * radians;
+    double term = radians;
+    double sum = radians;
+    for (int power = 3; power <= 21; power += 2) {
+        term *= -radians2 / (double)((power - 1) * power);
+        sum += term;
+    }
+    return sum;
+}
+
+static double approximateAcos(double x) {
+    if (x < -1.0 || x > 1.0) {
+        return NAN;     // Like std::acos, no sunrise or no sunset on this day
+    }
+
+    double absX = (x < 0) ? -x : x;
+    double result = std::sqrt(1.0 - absX) *
+                    (1.5707963050 + absX * (-0.2145988016 + absX * (0.0889789874 + absX * (-0.0501743046 +
+                     absX * (0.0308918810 + absX * (-0.0170881256 + absX * (0.0066700901 + absX * -0.0012624911)))))));
+    return (x < 0) ? M_PI - result : result;
+}
+
+struct CSunriseCalculatorFastTables {
+    static const int numberOfEntries = 360 * SUNRISE_CALCULATOR_FAST_STEPS_PER_DEGREE + 1;
+
+    float solarTransitCorrection[numberOfEntries];      // In days
+    float sinSunDecline[numberOfEntries];
+    float cosSunDecline[numberOfEntries];
+
+    CSunriseCalculatorFastTables() {
+        for (int index = 0; index < numberOfEntries; index++) {
+            double solarMeanAnomaly = (double)index / SUNRISE_CALCULATOR_FAST_STEPS_PER_DEGREE;
+            double equationOfTheCenter = (1.9148 * approximateSin(DEG_TO_RAD(solarMeanAnomaly)) +
+                                         0.02 * approximateSin(2 * DEG_TO_RAD(solarMeanAnomaly)) +
+                                         0.0003 * approximateSin(3 * DEG_TO_RAD(solarMeanAnomaly)));
+            double eclipticLongitude = solarMeanAnomaly + equationOfTheCenter + 180.0 + 102.9372;
+
+            solarTransitCorrection[index] = (float)(0.0053 * approximateSin(DEG_TO_RAD(solarMeanAnomaly)) -
+                                                    0.0069 * approximateSin(2 * DEG_TO_RAD(eclipticLongitude)));
+            double sinDecline = approximateSin(DEG_TO_RAD(eclipticLongitude)) * approximateSin(DEG_TO_RAD(23.4393));
+            sinSunDecline[index] = (float)sinDecline;
+            cosSunDecline[index] = (float)std::sqrt(1.0 - sinDecline * sinDecline);     // The declination is within +/-23.5 degrees
+        }
+    }
+};
+
+static const CSunriseCalculatorFastTables &fastTables(void) {
+    static const CSunriseCalculatorFastTables tables;
+    return tables;
+}
+
+static void sunRiseAndSetFast(time_t timestampGMT, double longitude, double sinLatitude, double cosLatitude, time_t &sunRise, time_t &sunSet) {
+    const CSunriseCalculatorFastTables &tables = fastTables();
+
+    double julianDayOfYear = ceil(UNIX_TO_JULIAN(timestampGMT) - (2451545.0 + 0.0009) + (69.184 / 86400.0));
+    double meanSolarTime = julianDayOfYear + 0.0009 - (longitude / 360.0);
+    double solarMeanAnomaly = 357.5291 + 0.98560028 * meanSolarTime;
+    solarMeanAnomaly -= 360.0 * floor(solarMeanAnomaly / 360.0);
+
+    double position = solarMeanAnomaly * SUNRISE_CALCULATOR_FAST_STEPS_PER_DEGREE;
+    int index = (int)position;
+    if (index >= CSunriseCalculatorFastTables::numberOfEntries - 1) {
+        index = CSunriseCalculatorFastTables::numberOfEntries - 2;
+    }
+    double fraction = position - index;
+
+    double solarTransit = 2451545.0 + meanSolarTime +
+                          tables.solarTransitCorrection[index] + fraction * (tables.solarTransitCorrection[index + 1] - tables.solarTransitCorrection[index]);
+    double sinSunDecline = tables.sinSunDecline[index] + fraction * (tables.sinSunDecline[index + 1] - tables.sinSunDecline[index]);
+    double cosSunDecline = tables.cosSunDecline[index] + fraction * (tables.cosSunDecline[index + 1] - tables.cosSunDecline[index]);
+
+    // sin(-0.833 degrees), the sun just below the horizon
+    const double sinHorizon = -0.014538080502497;
+
+    double hourAngle = approximateAcos((sinHorizon - sinLatitude * sinSunDecline) / (cosLatitude * cosSunDecline));
+
+    double sunriseJulianDay = solarTransit - hourAngle / (2.0 * M_PI);
+    double sunsetJulianDay = solarTransit + hourAngle / (2.0 * M_PI);
+
+    sunRise = static_cast<std::time_t>(JULIAN_TO_UNIX(sunriseJulianDay));
+    sunSet = static_cast<std::time_t>(JULIAN_TO_UNIX(sunsetJulianDay));
+}
+
+CSunriseCalculator::CSunriseCalculator(float latitude, float longitude, CSunriseCalculatorMode mode) :
+latitude(latitude),
+longitude(longitude),
+mode(mode),
+sinLatitude(approximateSin(DEG_TO_RAD(this->latitude))),
+cosLatitude(approximateSin(DEG_TO_RAD(this->latitude + 90.0))) {
+}
+
+void CSunriseCalculator::sunRiseAndSetForTimestamp(time_t timestampGMT, time_t secondsFromGMT, time_t &sunRise, time_t &sunSet) {
+    if (mode == CSunriseCalculatorMode_Fast) {
+        sunRiseAndSetFast(timestampGMT + secondsFromGMT, longitude, sinLatitude, cosLatitude, sunRise, sunSet);
+    } else {
+        sunRiseAndSetScalar(timestampGMT + secondsFromGMT, latitude, longitude, sunRise, sunSet);
+    }
+}
+
+void CSunriseCalculator::setMode(CSunriseCalculatorMode mode) {
+    this->mode = mode;
+}
+
+CSunriseCalculatorMode CSunriseCalculator::getMode(void) const {
+    return mode;
+}
+
+#ifdef SUNRISE_CALCULATOR_HAS_AVX2_KERNEL
+
+// NOTES
+//
+// The AVX2 kernel does the same calculation as sunRiseAndSetScalar() for 4 days/locations at once. There are no
+// vectorized sin/asin/acos in libm, so they are approximated here with polynomials that are accurate to about 1e-10
+// radians, far below the 1 second (about 7e-5 radians of hour angle) that matters for the results.
+//
+// The kernel is compiled for AVX2 only, and only used if the CPU supports it, so the library itself can still be built
+// for (and run on) any x86-64 CPU.
+
+#define AVX2_KERNEL __attribute__((target("avx2")))
+
+// sin(x) for any x. Reduces x to r in [-pi/2, pi/2] with x = r + k * pi, and evaluates the Taylor series of sin(r) up
+// to r^19, which is exact to double precision in that range.
+AVX2_KERNEL static inline __m256d sin256(__m256d x) {
+    const __m256d pi = _mm256_set1_pd(M_PI);
+    const __m256d one = _mm256_set1_pd(1.0);
+    const __m256d two = _mm256_set1_pd(2.0);
+
+    __m256d k = _mm256_round_pd(_mm256_div_pd(x, pi), _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+    // pi split in two parts, so that k * pi is subtracted without losing precision
+    __m256d r = _mm256_sub_pd(x, _mm256_mul_pd(k, _mm256_set1_pd(3.141592653589793116)));
+    r = _mm256_sub_pd(r, _mm256_mul_pd(k, _mm256_set1_pd(1.2246467991473532e-16)));
+
+    __m256d r2 = _mm256_mul_pd(r, r);
+    __m256d polynomial = _mm256_set1_pd(1.0 / 121645100408832000.0);                      // 1/19!
+    polynomial = _mm256_sub_pd(_mm256_set1_pd(1.0 / 355687428096000.0), _mm256_mul_pd(r2, polynomial));
+    polynomial = _mm256_sub_pd(_mm256_set1_pd(1.0 / 1307674368000.0), _mm256_mul_pd(r2, polynomial));
+    polynomial = _mm256_sub_pd(_mm256_set1_pd(1.0 / 6227020800.0), _mm256_mul_pd(r2, polynomial));
+    polynomial = _mm256_sub_pd(_mm256_set1_pd(1.0 / 39916800.0), _mm256_mul_pd(r2, polynomial));
+    polynomial = _mm256_sub_pd(_mm256_set1_pd(1.0 / 362880.0), _mm256_mul_pd(r2, polynomial));
+    polynomial = _mm256_sub_pd(_mm256_set1_pd(1.0 / 5040.0), _mm256_mul_pd(r2, polynomial));
+    polynomial = _mm256_sub_pd(_mm256_set1_pd(1.0 / 120.0), _mm256_mul_pd(r2, polynomial));
+    polynomial = _mm256_sub_pd(_mm256_set1_pd(1.0 / 6.0), _mm256_mul_pd(r2, polynomial));
+    polynomial = _mm256_sub_pd(one, _mm256_mul_pd(r2, polynomial));
+    __m256d sinR = _mm256_mul_pd(r, polynomial);
+
+    // sin(r + k * pi) = -sin(r) for odd k
+    __m256d halfK = _mm256_mul_pd(k, _mm256_set1_pd(0.5));
+    __m256d isOdd = _mm256_cmp_pd(halfK, _mm256_floor_pd(halfK), _CMP_NEQ_OQ);
+    __m256d sign = _mm256_blendv_pd(one, _mm256_sub_pd(one, two), isOdd);
+
+    return _mm256_mul_pd(sinR, sign);
+}
+
+// cos(x) = sin(x + pi/2)
+AVX2_KERNEL static inline __m256d cos256(__m256d x) {
+    return sin256(_mm256_add_pd(x, _mm256_set1_pd(M_PI / 2.0)));
+}
+
+// asin(x) for x in [0, 0.5], Taylor series up to x^25.
+AVX2_KERNEL static inline __m256d asinSmall256(__m256d x) {
+    static const double coefficients[] = {
+        1.0, 1.0 / 6.0, 3.0 / 40.0, 5.0 / 112.0, 35.0 / 1152.0, 63.0 / 2816.0, 231.0 / 13312.0,
+        143.0 / 10240.0, 6435.0 / 557056.0, 12155.0 / 1245184.0, 46189.0 / 5505024.0,
+        88179.0 / 12058624.0, 676039.0 / 104857600.0
+    };
+    const int numberOfCoefficients = sizeof(coefficients) / sizeof(coefficients[0]);
+
+    __m256d x2 = _mm256_mul_pd(x, x);
+    __m256d polynomial = _mm256_set1_pd(coefficients[numberOfCoefficients - 1]);
+    for (int index = numberOfCoefficients - 2; index >= 0; index--) {
+        polynomial = _mm256_add_pd(_mm256_set1_pd(coefficients[index]), _mm256_mul_pd(x2, polynomial));
+    }
+    return _mm256_mul_pd(x, polynomial);
+}
+
+// asin(x) for x in [-1, 1], NaN outside, like std::asin. Above 0.5, uses asin(x) = pi/2 - 2 * asin(sqrt((1 - x) / 2)).
+AVX2_KERNEL static inline __m256d asin256(__m256d x) {
+    const __m256d half = _mm256_set1_pd(0.5);
+    const __m256d signMask = _mm256_set1_pd(-0.0);
+
+    __m256d absX = _mm256_andnot_pd(signMask, x);
+    __m256d small = asinSmall256(absX);
+    __m256d large = _mm256_sub_pd(_mm256_set1_pd(M_PI / 2.0),
+                                  _mm256_mul_pd(_mm256_set1_pd(2.0), asinSmall256(_mm256_sqrt_pd(_mm256_mul_pd(_mm256_sub_pd(_mm256_set1_pd(1.0), absX), half)))));
+    __m256d result = _mm256_blendv_pd(small, large, _mm256_cmp_pd(absX, half, _CMP_GT_OQ));
+
+    // NaN for |x| > 1 comes from the sqrt, put the sign back for the others.
+    return _mm256_or_pd(result, _mm256_and_pd(x, signMask));
+}
+
+AVX2_KERNEL static inline __m256d acos256(__m256d x) {
+    return _mm256_sub_pd(_mm256_set1_pd(M_PI / 2.0), asin256(x));
+}
+
+AVX2_KERNEL static inline __m256d fmod360(__m256d x) {
+    const __m256d fullCircle = _mm256_set1_pd(360.0);
+    return _mm256_sub_pd(x, _mm256_mul_pd(fullCircle, _mm256_floor_pd(_mm256_div_pd(x, fullCircle))));
+}
+
+AVX2_KERNEL static inline __m256d degreesToRadians(__m256d x) {
+    return _mm256_div_pd(_mm256_mul_pd(x, _mm256_set1_pd(M_PI)), _mm256_set1_pd(180.0));
+}
+
+AVX2_KERNEL static inline __m256d radiansToDegrees(__m256d x) {
+    return _mm256_div_pd(_mm256_mul_pd(x, _mm256_set1_pd(180.0)), _mm256_set1_pd(M_PI));
+}
+
+// Calculates groups of 4, returns the number of days calculated. The rest is left for the scalar code.
+AVX2_KERNEL static size_t sunRiseAndSetAVX2(const time_t *days, const double *latitudes, const double *longitudes, size_t count, time_t *sunRises, time_t *sunSets) {
+    const __m256d sinHorizon = _mm256_set1_pd(std::sin(DEG_TO_RAD(-0.833)));
+    const __m256d sinObliquity = _mm256_set1_pd(std::sin(DEG_TO_RAD(23.4393)));
+
+    size_t index;
+    for (index = 0; index + 4 <= count; index += 4) {
+        // There is no int64 to double conversion in AVX2, the compiler does this part with scalar instructions.
+        __m256d timestamp = _mm256_set_pd((double)days[index + 3], (double)days[index + 2], (double)days[index + 1], (double)days[index]);
+        __m256d latitude = _mm256_loadu_pd(latitudes + index);
+        __m256d longitude = _mm256_loadu_pd(longitudes + index);
+
+        __m256d julianDate = _mm256_add_pd(_mm256_div_pd(timestamp, _mm256_set1_pd(86400.0)), _mm256_set1_pd(2440587.5));
+        __m256d julianDayOfYear = _mm256_ceil_pd(_mm256_add_pd(_mm256_sub_pd(julianDate, _mm256_set1_pd(2451545.0 + 0.0009)), _mm256_set1_pd(69.184 / 86400.0)));
+        __m256d meanSolarTime = _mm256_sub_pd(_mm256_add_pd(julianDayOfYear, _mm256_set1_pd(0.0009)), _mm256_div_pd(longitude, _mm256_set1_pd(360.0)));
+        __m256d solarMeanAnomaly = fmod360(_mm256_add_pd(_mm256_set1_pd(357.5291), _mm256_mul_pd(_mm256_set1_pd(0.98560028), meanSolarTime)));
+
+        __m256d anomalyRadians = degreesToRadians(solarMeanAnomaly);
+        __m256d sinAnomaly = sin256(anomalyRadians);
+        __m256d equationOfTheCenter = _mm256_add_pd(_mm256_add_pd(
+            _mm256_mul_pd(_mm256_set1_pd(1.9148), sinAnomaly),
+            _mm256_mul_pd(_mm256_set1_pd(0.02), sin256(_mm256_mul_pd(_mm256_set1_pd(2.0), anomalyRadians)))),
+            _mm256_mul_pd(_mm256_set1_pd(0.0003), sin256(_mm256_mul_pd(_mm256_set1_pd(3.0), anomalyRadians))));
+
+        __m256d eclipticLongitude = fmod360(_mm256_add_pd(_mm256_add_pd(_mm256_add_pd(solarMeanAnomaly, equationOfTheCenter), _mm256_set1_pd(180.0)), _mm256_set1_pd(102.9372)));
+        __m256d eclipticRadians = degreesToRadians(eclipticLongitude);
+
+        __m256d solarTransit = _mm256_sub_pd(_mm256_add_pd(_mm256_add_pd(_mm256_set1_pd(2451545.0), meanSolarTime),
+                                                           _mm256_mul_pd(_mm256_set1_pd(0.0053), sinAnomaly)),
+                                             _mm256_mul_pd(_mm256_set1_pd(0.0069), sin256(_mm256_mul_pd(_mm256_set1_pd(2.0), eclipticRadians))));
+
+        __m256d sunDecline = radiansToDegrees(asin256(_mm256_mul_pd(sin256(eclipticRadians), sinObliquity)));
+        __m256d declineRadians = degreesToRadians(sunDecline);
+        __m256d latitudeRadians = degreesToRadians(latitude);
+
+        __m256d cosHourAngle = _mm256_div_pd(_mm256_sub_pd(sinHorizon, _mm256_mul_pd(sin256(latitudeRadians), sin256(declineRadians))),
+                                             _mm256_mul_pd(cos256(latitudeRadians), cos256(declineRadians)));
+        __m256d hourAngle = radiansToDegrees(acos256(cosHourAngle));
+
+        __m256d halfDay = _mm256_div_pd(hourAngle, _mm256_set1_pd(360.0));
+        __m256d sunrise = _mm256_mul_pd(_mm256_sub_pd(_mm256_sub_pd(solarTransit, halfDay), _mm256_set1_pd(2440587.5)), _mm256_set1_pd(86400.0));
+        __m256d sunset = _mm256_mul_pd(_mm256_sub_pd(_mm256_add_pd(solarTransit, halfDay), _mm256_set1_pd(2440587.5)), _mm256_set1_pd(86400.0));
+
+        double sunriseTimes[4], sunsetTimes[4];
+        _mm256_storeu_pd(sunriseTimes, sunrise);
+        _mm256_storeu_pd(sunsetTimes, sunset);
+        for (int lane = 0; lane < 4; lane++) {
+            sunRises[index + lane] = static_cast<std::time_t>(sunriseTimes[lane]);
+            sunSets[index + lane] = static_cast<std::time_t>(sunsetTimes[lane]);
+        }
+    }
+
+    return index;
+}
+
+static bool cpuHasAVX2(void) {
+    static const bool hasAVX2 = __builtin_cpu_supports("avx2");
+    return hasAVX2;
+}
+
+#endif // SUNRISE_CALCULATOR_HAS_AVX2_KERNEL
+
+// Calculate sunrise and sunset for many days and/or locations at once. days holds the GMT timestamps of the beginning
+// of the local days, like sunRiseAndSetForTimestamp() with a secondsFromGMT of 0. Uses the AVX2 kernel when the CPU
+// supports it, the results are then within 1 second of the scalar calculation.
+void CSunriseCalculator::sunRiseAndSetBatch(const time_t *days, const double *latitudes, const double *longitudes, size_t count, time_t *sunRises, time_t *sunSets) {
+    size_t index = 0;
+
+#ifdef SUNRISE_CALCULATOR_HAS_AVX2_KERNEL
+    if (cpuHasAVX2()) {
+        index = sunRiseAndSetAVX2(days, latitudes, longitudes, count, sunRises, sunSets);
+    }
+#endif
+
+    for (; index < count; index++) {
+        sunRiseAndSetScalar(days[index], latitudes[index], longitudes[index], sunRises[index], sunSets[index]);
+    }
+}
+
+// Calculate sunrise and sunset for many days at the location of this calculator, in the mode of this calculator.
+void CSunriseCalculator::sunRiseAndSetForDays(const time_t *days, size_t count, time_t *sunRises, time_t *sunSets) {
+    if (mode == CSunriseCalculatorMode_Fast) {
+        for (size_t index = 0; index < count; index++) {
+            sunRiseAndSetFast(days[index], longitude, sinLatitude, cosLatitude, sunRises[index], sunSets[index]);
+        }
+        return;
+    }
+
+    const size_t blockSize = 64;
+    double latitudes[blockSize];
+    double longitudes[blockSize];
+
+    for (size_t index = 0; index < blockSize; index++) {
+        latitudes[index] = latitude;
+        longitudes[index] = longitude;
+    }
+
+    for (size_t first = 0; first < count; first += blockSize) {
+        size_t blockCount = (count - first < blockSize) ? count - first : blockSize;
+        sunRiseAndSetBatch(days + first, latitudes, longitudes, blockCount, sunRises + first, sunSets + first);
+    }
+}
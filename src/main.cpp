@@ -1,12 +1,35 @@
 #include <iostream>
+#include <algorithm>
+#include <string>
+#include <stdlib.h>
+#include <string.h>
 #include <unistd.h>
 
 #include "EventScheduler.hpp"
+#include "EventSchedulerRunner.hpp"
+#include "EventSchedulerDispatcher.hpp"
+#include "EventSchedulerPool.hpp"
+#include "EventSchedulerCoordinator.hpp"
+#include "EventSchedulerService.hpp"
+#include "EventSchedulerSnapshot.hpp"
+#include "EventSchedulerJournal.hpp"
+#include "EventSchedulerImporter.hpp"
+#include "EventSchedulerTimeZone.hpp"
 #include "SunriseCalculator.hpp"
 #include "DebugStuff.hpp"
 
 void doSunriseCalculationTests();
+void doSunriseAccuracyTests();
 void doEventSchedulerTests();
+void doEventSchedulerPoolTests();
+void doEventSchedulerCoordinatorTests();
+void doEventSchedulerServiceTests();
+void doEventSchedulerMetricsTests();
+void doEventSchedulerSnapshotTests();
+void doEventSchedulerJournalTests();
+void doEventSchedulerImporterTests();
+void doEventSchedulerTimeZoneTests();
+void doEventSchedulerRandomOffsetTests();
 void scheduleLoopTester();
 
 CEventSchedulerItem testItems[] = {
@@ -40,8 +63,28 @@ int main() {
     
     doSunriseCalculationTests();
 
+    doSunriseAccuracyTests();
+
     doEventSchedulerTests();
 
+    doEventSchedulerPoolTests();
+
+    doEventSchedulerCoordinatorTests();
+
+    doEventSchedulerServiceTests();
+
+    doEventSchedulerMetricsTests();
+
+    doEventSchedulerSnapshotTests();
+
+    doEventSchedulerJournalTests();
+
+    doEventSchedulerImporterTests();
+
+    doEventSchedulerTimeZoneTests();
+
+    doEventSchedulerRandomOffsetTests();
+
     scheduleLoopTester();
 
     return 0;
@@ -118,6 +161,64 @@ void doSunriseCalculationTests() {
     std::cout << "---------------------------------------------------------------\n";
 }
 
+// Measure the worst case error of the fast mode of the sunrise calculator against the exact mode, for every day in
+// 2000-2100 and every whole degree of latitude between the polar circles. The results are documented in
+// SunriseCalculator.cpp.
+void doSunriseAccuracyTests() {
+    const time_t firstDay = 946684800;      // 2000-01-01
+    const int numberOfDays = 36525;         // 100 years
+    const time_t polarMargin = 2 * 3600;    // Less than 2 or more than 22 hours of daylight
+
+    time_t worstError = 0;
+    time_t worstErrorNearPolar = 0;
+    int numberOfDaysCompared = 0;
+    int numberOfBorderMismatches = 0;
+
+    std::cout << "Sunrise Calculator Accuracy Test\n\n";
+
+    for (int latitude = -66; latitude <= 66; latitude++) {
+        double longitude = ((latitude * 37) % 360 + 360) % 360 - 180.0;    // Some spread in longitude too
+        CSunriseCalculator exactCalculator(latitude, longitude, CSunriseCalculatorMode_Exact);
+        CSunriseCalculator fastCalculator(latitude, longitude, CSunriseCalculatorMode_Fast);
+
+        for (int day = 0; day < numberOfDays; day++) {
+            time_t timestamp = firstDay + (time_t)day * 86400;
+            time_t exactSunrise, exactSunset, fastSunrise, fastSunset;
+
+            exactCalculator.sunRiseAndSetForTimestamp(timestamp, 0, exactSunrise, exactSunset);
+            fastCalculator.sunRiseAndSetForTimestamp(timestamp, 0, fastSunrise, fastSunset);
+
+            // Without sunrise or sunset (polar day or night), the result is not a time on this day.
+            bool exactHasSunrise = labs(exactSunrise - timestamp) < 3 * 86400;
+            bool fastHasSunrise = labs(fastSunrise - timestamp) < 3 * 86400;
+            if (exactHasSunrise != fastHasSunrise) {
+                numberOfBorderMismatches++;
+                continue;
+            }
+            if (!exactHasSunrise) {
+                continue;
+            }
+
+            numberOfDaysCompared++;
+
+            time_t error = std::max(labs(exactSunrise - fastSunrise), labs(exactSunset - fastSunset));
+            time_t dayLength = exactSunset - exactSunrise;
+            if (dayLength < polarMargin || dayLength > 86400 - polarMargin) {
+                worstErrorNearPolar = std::max(worstErrorNearPolar, error);
+            } else {
+                worstError = std::max(worstError, error);
+            }
+        }
+    }
+
+    std::cout << "Days compared: " << numberOfDaysCompared << "\n";
+    std::cout << "Worst case error: " << worstError << " seconds\n";
+    std::cout << "Worst case error near polar day/night: " << worstErrorNearPolar << " seconds\n";
+    std::cout << "Days with/without sunrise that differ: " << numberOfBorderMismatches << "\n";
+
+    std::cout << "---------------------------------------------------------------\n";
+}
+
 void doEventSchedulerTests() {
     
     std::cout << "Event Scheduler Example\n";
@@ -127,9 +228,7 @@ void doEventSchedulerTests() {
     CEventScheduler scheduler(latitude, longitude, secondsFromGMT, [](){ return time(nullptr); });
 
     std::cout << "Adding test items...\n";
-    for (const auto& item : testItems) {
-        scheduler.addItem(item);
-    }
+    scheduler.replaceAllItems(testItems, sizeof(testItems) / sizeof(testItems[0]));
 
     bool isValid = false;
     CEventSchedulerItem foundItem;
@@ -176,6 +275,31 @@ void doEventSchedulerTests() {
 
     scheduler.debugPrint();
 
+    std::cout << "---------------------------------------------------------------\n";
+
+    time_t fromTime = time(nullptr);
+    std::cout << "Activations in the coming 7 days:\n";
+    for (const CEventSchedulerActivation &activation : scheduler.activations(fromTime, fromTime + 7 * 86400)) {
+        time_t localTime = activation.timestampGMT + secondsFromGMT;
+        std::cout << "  " << asctime(gmtime(&localTime)) << "    ";
+        activation.item.debugPrint();
+    }
+
+    std::cout << "---------------------------------------------------------------\n";
+
+    std::cout << "Adding a one-shot item in 45 minutes\n";
+    CEventSchedulerTimerHandle oneShotHandle = scheduler.addOneShotItem(fromTime + 45 * 60, 5);
+    std::cout << "  Next item to activate: "; scheduler.getNextActiveItem(fromTime).debugPrint();
+    scheduler.cancelOneShotItem(oneShotHandle);
+    std::cout << "Cancelled it\n";
+    std::cout << "  Next item to activate: "; scheduler.getNextActiveItem(fromTime).debugPrint();
+
+    std::cout << "---------------------------------------------------------------\n";
+
+    // Readers on other threads use the concurrent reader, without locking the scheduler.
+    CEventSchedulerConcurrentReader *reader = scheduler.enableConcurrentReads();
+    std::cout << "Active item according to the concurrent reader: "; reader->getActiveItem(fromTime).debugPrint();
+
     time_t testTime = 0; // In GMT
 
     CEventSchedulerItem activeItem;
@@ -241,6 +365,246 @@ void doEventSchedulerTests() {
     std::cout << "---------------------------------------------------------------\n";
 }
 
+void doEventSchedulerPoolTests() {
+    std::cout << "---------------------------------------------------------------\n";
+    std::cout << "Scheduler pool with 3 tenants, 2 of them at the same location\n";
+
+    CEventSchedulerPool pool([](){ return time(nullptr); });
+
+    int tenants[3];
+    tenants[0] = pool.addTenant(latitude, longitude, 3600);
+    tenants[1] = pool.addTenant(latitude, longitude, 3600);
+    tenants[2] = pool.addTenant(40.712776, -74.005974, -5 * 3600);     // New York
+
+    for (int tenant : tenants) {
+        pool.replaceAllItems(tenant, testItems, sizeof(testItems) / sizeof(testItems[0]));
+    }
+    pool.removeItem(tenants[1], testItems[0]);
+
+    std::cout << "Locations: " << pool.getNumberOfLocations() << ", memory: " << pool.getMemoryUsage() << " bytes\n";
+
+    CEventSchedulerItem activeItems[3];
+    pool.evaluateAll(time(nullptr), activeItems);
+    for (int tenant : tenants) {
+        std::cout << "  Tenant " << tenant << ": "; activeItems[tenant].debugPrint();
+    }
+}
+
+void doEventSchedulerCoordinatorTests() {
+    std::cout << "---------------------------------------------------------------\n";
+    std::cout << "Coordinator with 3 schedulers\n";
+
+    CEventScheduler schedulers[3] = {
+        {latitude, longitude, 3600, [](){ return time(nullptr); }},
+        {latitude, longitude, 3600, [](){ return time(nullptr); }},
+        {40.712776, -74.005974, -5 * 3600, [](){ return time(nullptr); }}
+    };
+
+    CEventSchedulerCoordinator coordinator([](CEventSchedulerBase & /* scheduler */, const CEventSchedulerItem &activeItem, const CEventSchedulerItem & /* nextActiveItem */, time_t /* timestampGMT */, void * /* context */) {
+        std::cout << "  Active: "; activeItem.debugPrint();
+    });
+
+    for (CEventScheduler &scheduler : schedulers) {
+        scheduler.replaceAllItems(testItems, sizeof(testItems) / sizeof(testItems[0]));
+        coordinator.addScheduler(scheduler);
+    }
+
+    time_t nextActivationTime = coordinator.processDue(time(nullptr));
+    std::cout << "First activation of all schedulers: " << asctime(gmtime(&nextActivationTime));
+}
+
+void doEventSchedulerServiceTests() {
+    std::cout << "---------------------------------------------------------------\n";
+    std::cout << "Service with 2 shards and 4 schedulers\n";
+
+    CEventSchedulerService service(2, [](int /* schedulerId */, const CEventSchedulerItem & /* activeItem */, const CEventSchedulerItem & /* nextActiveItem */, time_t /* timestampGMT */, void * /* context */) {
+        // Called on the threads of the shards.
+    });
+    service.start();
+
+    std::future<int> schedulerIds[4];
+    for (std::future<int> &schedulerId : schedulerIds) {
+        schedulerId = service.createScheduler(latitude, longitude, 3600);
+    }
+
+    for (std::future<int> &schedulerId : schedulerIds) {
+        int id = schedulerId.get();
+        service.replaceAllItems(id, testItems, sizeof(testItems) / sizeof(testItems[0])).wait();
+        std::cout << "  Scheduler " << id << ": "; service.getActiveItem(id).get().debugPrint();
+    }
+}
+
+void doEventSchedulerMetricsTests() {
+    std::cout << "---------------------------------------------------------------\n";
+    std::cout << "Metrics of 1000 lookups\n";
+
+    CEventSchedulerMetrics metrics;
+    CEventScheduler scheduler(latitude, longitude, 3600, [](){ return time(nullptr); });
+    scheduler.setMetrics(&metrics);
+    scheduler.replaceAllItems(testItems, sizeof(testItems) / sizeof(testItems[0]));
+
+    time_t timestampGMT = time(nullptr);
+    for (int lookup = 0; lookup < 1000; lookup++) {
+        scheduler.getActiveItem(timestampGMT + lookup * 600);
+    }
+
+#ifndef EVENT_SCHEDULER_METRICS
+    std::cout << "(Built without EVENT_SCHEDULER_METRICS, so nothing is recorded)\n";
+#endif
+    CEventSchedulerMetricsSnapshot *snapshot = new CEventSchedulerMetricsSnapshot;
+    metrics.snapshot(*snapshot);
+    std::cout << snapshot->toJSON();
+    delete snapshot;
+}
+
+void doEventSchedulerSnapshotTests() {
+    std::cout << "---------------------------------------------------------------\n";
+    std::cout << "Snapshot of 2 schedulers\n";
+
+    CEventScheduler schedulerA(latitude, longitude, 3600, [](){ return time(nullptr); });
+    CEventScheduler schedulerB(latitude, longitude, 7200, [](){ return time(nullptr); });
+    schedulerA.replaceAllItems(testItems, sizeof(testItems) / sizeof(testItems[0]));
+    schedulerB.replaceAllItems(testItems, 6);
+
+    CEventSchedulerBase *schedulers[] = { &schedulerA, &schedulerB };
+    if (CEventSchedulerSnapshotFile::write("event_scheduler.snapshot", schedulers, 2) != 0) {
+        std::cout << "  Could not write the snapshot\n";
+        return;
+    }
+
+    CEventSchedulerSnapshotFile snapshot;
+    if (snapshot.open("event_scheduler.snapshot") != 0) {
+        std::cout << "  Could not open the snapshot\n";
+        return;
+    }
+
+    time_t timestampGMT = time(nullptr);
+    std::cout << "  From the file:      "; snapshot.getActiveItem(0, timestampGMT).debugPrint();
+    std::cout << "  From the scheduler: "; schedulerA.getActiveItem(timestampGMT).debugPrint();
+
+    CEventScheduler restored(snapshot.getLatitude(1), snapshot.getLongitude(1), 0, [](){ return time(nullptr); });
+    snapshot.restore(1, restored);
+    std::cout << "  Restored:           "; restored.getActiveItem(timestampGMT).debugPrint();
+    std::cout << "  Original:           "; schedulerB.getActiveItem(timestampGMT).debugPrint();
+
+    snapshot.close();
+    remove("event_scheduler.snapshot");
+}
+
+void doEventSchedulerJournalTests() {
+    std::cout << "---------------------------------------------------------------\n";
+    std::cout << "Journal of the edits of a scheduler\n";
+
+    {
+        CEventScheduler scheduler(latitude, longitude, 3600, [](){ return time(nullptr); });
+        CEventSchedulerJournal journal;
+        if (journal.open(scheduler, "event_scheduler") != 0) {
+            std::cout << "  Could not open the journal\n";
+            return;
+        }
+        for (const auto& item : testItems) {
+            journal.addItem(item);
+        }
+        journal.removeItem(testItems[0]);
+        journal.sync();
+        std::cout << "  Items before:    " << scheduler.getNumberOfItems() << ", journal of " << journal.getJournalSize() << " bytes\n";
+    }
+
+    CEventScheduler recovered(latitude, longitude, 3600, [](){ return time(nullptr); });
+    CEventSchedulerJournal journal;
+    journal.open(recovered, "event_scheduler");
+    std::cout << "  Items recovered: " << recovered.getNumberOfItems() << "\n";
+    journal.close();
+
+    remove("event_scheduler.snapshot");
+    remove("event_scheduler.journal");
+}
+
+void doEventSchedulerImporterTests() {
+    std::cout << "---------------------------------------------------------------\n";
+    std::cout << "Import of the items of 2 tenants\n";
+
+    static const char input[] =
+        "tenant,weekDay,eventType,timeOffset,randomOffsetMinus,randomOffsetPlus,userDefined\n"
+        "living-room,Monday,Time,07:00,0,30,1\n"
+        "living-room,Mon,Sunset,,30,30,1\n"
+        "living-room,2,Time,23:00,30,90,0\n"
+        "garden,Sat,Sunrise,,0,0,1\n"
+        "garden,Saturday,Time,25:00,0,0,0\n"
+        "garden,Saturday,Time,22:00,0,200,0\n"
+        "attic,Sunday,Time,12:00,0,0,0\n";
+
+    CEventScheduler livingRoom(latitude, longitude, 3600, [](){ return time(nullptr); });
+    CEventScheduler garden(latitude, longitude, 3600, [](){ return time(nullptr); });
+    CEventSchedulerBase *schedulers[] = { &livingRoom, &garden };
+
+    CEventSchedulerImporter importer([](const char *tenant, size_t tenantLength, void *context) -> CEventSchedulerBase * {
+        CEventSchedulerBase **schedulers = static_cast<CEventSchedulerBase **>(context);
+        std::string name(tenant, tenantLength);
+        if (name == "living-room") {
+            return schedulers[0];
+        }
+        if (name == "garden") {
+            return schedulers[1];
+        }
+        return nullptr;
+    }, schedulers);
+    importer.importBuffer(input, sizeof(input) - 1);
+
+    std::cout << "  Rows: " << importer.getNumberOfRows() << ", imported: " << importer.getNumberOfImportedItems() << ", errors: " << importer.getNumberOfErrors() << "\n";
+    for (int index = 0; index < importer.getNumberOfReports(); index++) {
+        const CEventSchedulerImportReport &report = importer.getReport(index);
+        std::cout << "  " << report.tenant << ": " << report.numberOfImportedItems << " of " << report.numberOfRows << " rows imported";
+        for (int errorIndex = 0; errorIndex < report.getNumberOfStoredErrors(); errorIndex++) {
+            std::cout << ", line " << report.errors[errorIndex].lineNumber << ": " << CEventSchedulerImporter::errorAsString(report.errors[errorIndex].error);
+        }
+        std::cout << "\n";
+    }
+}
+
+void doEventSchedulerTimeZoneTests() {
+    std::cout << "---------------------------------------------------------------\n";
+    std::cout << "Items around the daylight saving time transitions of Europe/Amsterdam\n";
+
+    static CEventSchedulerTimeZone timeZone;
+    timeZone.setRules("Europe/Amsterdam");
+
+    // 02:30 is skipped on the last Sunday of March, and repeated on the last Sunday of October.
+    CEventScheduler scheduler(latitude, longitude, 3600, [](){ return (time_t)1743050000; });
+    scheduler.setTimeZone(&timeZone);
+    scheduler.addItem(CEventSchedulerItem(CEventSchedulerDayNumber_Sunday, CEventSchedulerItemType_Time, 2 * 60 + 30, 0, 0, 1));
+    scheduler.addItem(CEventSchedulerItem(CEventSchedulerDayNumber_Sunday, CEventSchedulerItemType_Time, 12 * 60, 0, 0, 0));
+
+    // From the Saturdays before the transitions, in 2025.
+    for (time_t fromGMT : { (time_t)1743206400, (time_t)1761350400 }) {
+        for (const CEventSchedulerActivation &activation : scheduler.activations(fromGMT, fromGMT + 2 * 24 * 60 * 60)) {
+            time_t localTime = timeZone.localTimeForGMT(activation.timestampGMT);
+            char text[32];
+            strftime(text, sizeof(text), "%a %Y-%m-%d %H:%M", gmtime(&localTime));
+            std::cout << "  " << text << " (GMT+" << timeZone.getSecondsFromGMT(activation.timestampGMT) / 3600 << "): item " << (int)activation.item.userDefined << "\n";
+        }
+    }
+}
+
+void doEventSchedulerRandomOffsetTests() {
+    std::cout << "---------------------------------------------------------------\n";
+    std::cout << "Random offsets of the coming 3 weeks, calculated twice\n";
+
+    // Monday 23:00, up to 30 minutes earlier or 90 minutes later. The same seed gives the same times.
+    CEventScheduler scheduler(latitude, longitude, 3600, [](){ return time(nullptr); });
+    scheduler.setRandomSeed(5138008);
+    scheduler.addItem(CEventSchedulerItem(CEventSchedulerDayNumber_Monday, CEventSchedulerItemType_Time, 23 * 60, 30, 90, 0));
+
+    time_t fromTime = time(nullptr);
+    for (int run = 1; run <= 2; run++) {
+        std::cout << "  Run " << run << ":\n";
+        for (const CEventSchedulerActivation &activation : scheduler.activations(fromTime, fromTime + 3 * 7 * 86400)) {
+            time_t localTime = activation.timestampGMT + 3600;
+            std::cout << "    " << asctime(gmtime(&localTime));
+        }
+    }
+}
+
 void scheduleLoopTester() {
 
     time_t secondsFromGMT = 3600;
@@ -262,9 +626,7 @@ void scheduleLoopTester() {
     // TODO: The scheduler basically does not work with the real time, but works with week days and
     // TODO: minutes from the start of a week day. The timezone is possibly necessary to calculate the
     // TODO: proper week day from the current time + timezone.
-    // TODO: The timezone does also matter for the scheduler. 30 minutes into the start of the GMT
-    // TODO: day is still 30 minutes before the start of the CET day, if daylight saving is off.
-    // TODO: Need to make some use cases for this.
+    // The timezone does also matter for the scheduler, for daylight saving time see doEventSchedulerTimeZoneTests().
 
     time_t sunrise = scheduler.sunrise(timestampGMT) + secondsFromGMT;
     std::cout << "Sunrise today (local): " << asctime(gmtime(&sunrise)) << " timestampGMT=" << sunrise << " secondsFromGMT=" << secondsFromGMT << "\n";
@@ -273,30 +635,28 @@ void scheduleLoopTester() {
 
     std::cout << "---------------------------------------------------------------\n";
 
-    CEventSchedulerItem prevActiveItem;
-    CEventSchedulerItem prevNextActiveItem;
-
-    while (true) {
-
-        time_t timestampGMT = time(nullptr);
-        time_t secondsFromGMT = scheduler.getSecondsFromGMT();
-
-        CEventSchedulerItem activeItem = scheduler.getActiveItem(timestampGMT);
-        CEventSchedulerItem nextActiveItem = scheduler.getNextActiveItem(timestampGMT);
-
-        if (!(activeItem == prevActiveItem)) {
-            std::cout << "[" << asctime(gmtime(&timestampGMT)) << "] " << "New item was activated: ";
-            activeItem.debugPrint();
-            std::cout << "[" << asctime(gmtime(&timestampGMT)) << "] " << "Next item to activate: ";
-            nextActiveItem.debugPrint();
-
-            prevActiveItem = activeItem;
-            prevNextActiveItem = nextActiveItem;
-        }
-        else {
-            std::cout << "[" << asctime(gmtime(&timestampGMT)) << "] " << ". still active\n";
-        }
-
-        sleep(10);
-    }
-}
\ No newline at end of file
+    // The actions of the items run on the threads of the dispatcher, by the userDefined value of the item that
+    // becomes active: 0 switches the lights off, 1 switches them on.
+    CEventSchedulerDispatcher dispatcher(2);
+    CEventSchedulerStrand *strand = dispatcher.createStrand();
+    strand->setAction(0, [](const CEventSchedulerTransition &transition, void * /* context */) {
+        std::cout << "[" << asctime(gmtime(&transition.timestampGMT)) << "] " << "Action: lights off\n";
+    });
+    strand->setAction(1, [](const CEventSchedulerTransition &transition, void * /* context */) {
+        std::cout << "[" << asctime(gmtime(&transition.timestampGMT)) << "] " << "Action: lights on\n";
+    });
+
+    // The runner sleeps until the next item activates, instead of polling every few seconds.
+    CEventSchedulerRunner runner(scheduler, [](CEventSchedulerBase &scheduler, const CEventSchedulerItem &activeItem, const CEventSchedulerItem &nextActiveItem, time_t timestampGMT, void *context) {
+        time_t nextActivationTime = scheduler.getNextActivationTime(timestampGMT);
+
+        std::cout << "[" << asctime(gmtime(&timestampGMT)) << "] " << "New item was activated: ";
+        activeItem.debugPrint();
+        std::cout << "[" << asctime(gmtime(&timestampGMT)) << "] " << "Next item to activate at " << asctime(gmtime(&nextActivationTime)) << ": ";
+        nextActiveItem.debugPrint();
+
+        CEventSchedulerDispatcher::runnerCallback(scheduler, activeItem, nextActiveItem, timestampGMT, context);
+    }, strand);
+
+    runner.run();
+}